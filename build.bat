@@ -3,14 +3,31 @@
 call "C:\Program Files (x86)\Microsoft Visual Studio\2019\Community\VC\Auxiliary\Build\vcvars64.bat"
 
 SET includeFlags=/Isrc /Isrc/renderer /I%VULKAN_SDK%/Include 
-SET linkerFlags=/link /LIBPATH:%VULKAN_SDK%/Lib vulkan-1.lib user32.lib opengl32.lib Gdi32.lib
-SET defines=/D DEBUG /D WINDOWS_BUILD
+SET linkerFlags=/link /LIBPATH:%VULKAN_SDK%/Lib vulkan-1.lib user32.lib opengl32.lib Gdi32.lib Advapi32.lib
+SET defines=/D DEBUG /D WINDOWS_BUILD /D MEASURE_PERF
 
 if not exist build\NUL mkdir build
 
 echo "Building main..."
 cl /EHsc /Z7 /std:c++17 /Fe"main" /Fobuild/ %defines% %includeFlags% src/platform/win32_platform.cpp %linkerFlags%
 
+@REM Optimized and without MEASURE_PERF, run it from here: editor_bench --baseline <results of an earlier run>
+echo "Building editor_bench..."
+cl /EHsc /Z7 /O2 /std:c++17 /Fe"editor_bench" /Fobuild/ /D WINDOWS_BUILD /Isrc /Isrc/renderer src/bench/editor_bench.cpp /link user32.lib Advapi32.lib
+
+@REM Fails if typing or the wheel_layout stand-in for scrolling allocate outside of the Arenas, malloc and new are only hooked with the debug runtime.
+@REM Add /D ALLOC_GUARD /MTd to the defines and Dbghelp.lib to the linkerFlags to check the frame loop of main too
+echo "Building editor_bench_guard..."
+cl /EHsc /Z7 /MTd /std:c++17 /Fe"editor_bench_guard" /Fobuild/ /D WINDOWS_BUILD /D ALLOC_GUARD /Isrc /Isrc/renderer src/bench/editor_bench.cpp /link user32.lib Advapi32.lib Dbghelp.lib
+
+@REM Compares scanning memory with regular and large pages: scan_bench [--size <MB>]
+echo "Building scan_bench..."
+cl /EHsc /Z7 /O2 /std:c++17 /Fe"scan_bench" /Fobuild/ /D WINDOWS_BUILD /Isrc src/bench/scan_bench.cpp /link user32.lib Advapi32.lib
+
+@REM Add /D LOG_MIN_LEVEL=1 to the defines to compile out all CAKEZ_TRACE calls
+echo "Building log_decoder..."
+cl /EHsc /Z7 /std:c++17 /Fe"log_decoder" /Fobuild/ /Isrc src/tools/log_decoder.cpp
+
 @REM Play sound to indicate Building is completed, fun
 powershell -c (New-Object Media.SoundPlayer "building-completed.wav").PlaySync()
 EXIT
\ No newline at end of file
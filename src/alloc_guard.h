@@ -0,0 +1,165 @@
+#pragma once
+
+#include "defines.h"
+#include "logger.h"
+#include "platform.h"
+
+#include <string.h>
+
+/*
+ * Allocation Guard, only compiled in with ALLOC_GUARD. While it is armed,
+ * any allocation of the thread that armed it that is not from an Arena counts
+ * as a violation. That covers:
+ * - the C runtime, which means malloc, realloc and new (this needs the debug runtime, /MTd)
+ * - a Heap
+ * - the Game Memory itself
+ * The Frame and Transient Memory and the other Arenas carved out of the Game
+ * Memory are what the frame loop is supposed to use, so they are not checked.
+ * Neither is reserved memory that grows with what the user does, like the text,
+ * see growsInFrameLoop. Workers are not checked, they build the indices while
+ * the main thread runs frames.
+ *
+ * A violation only records its call stack, because it can happen inside of
+ * malloc. alloc_guard_report logs the call sites once the guard is disarmed.
+ * Every call site is logged once, together with how often it allocated.
+ */
+
+u32 constexpr ALLOC_GUARD_MAX_CALL_SITES = 32;
+u32 constexpr ALLOC_GUARD_STACK_DEPTH = 12;
+u32 constexpr ALLOC_GUARD_MAX_SYMBOL_LENGTH = 512;
+
+struct AllocGuardCallSite
+{
+    char *kind;
+    u64 size;
+    u32 count;
+    u32 frameCount;
+    void *frames[ALLOC_GUARD_STACK_DEPTH];
+};
+
+struct AllocGuard
+{
+    u32 volatile lock;
+
+    u32 violationCount;
+    u32 reportedViolationCount;
+
+    // Call sites after the last one are only counted
+    u32 callSiteCount;
+    u32 reportedCallSiteCount;
+    AllocGuardCallSite callSites[ALLOC_GUARD_MAX_CALL_SITES];
+};
+
+global_variable AllocGuard allocGuard;
+
+// Only set on the thread that armed the guard
+global_variable thread_local bool isAllocGuardArmed;
+
+/**
+ * Called by every allocation that is checked, it must not allocate itself.
+ * @param kind What was allocated from, like "Heap"
+ */
+void alloc_guard_on_allocation(char *kind, u64 size)
+{
+    if (!isAllocGuardArmed)
+    {
+        return;
+    }
+
+    // Skip this function, the frames above it are the call site
+    void *frames[ALLOC_GUARD_STACK_DEPTH];
+    u32 frameCount = platform_capture_call_stack(frames, ALLOC_GUARD_STACK_DEPTH, 1);
+
+    begin_spin_lock(&allocGuard.lock);
+    allocGuard.violationCount++;
+
+    bool isKnown = false;
+    for (u32 siteIdx = 0; siteIdx < allocGuard.callSiteCount && !isKnown; siteIdx++)
+    {
+        AllocGuardCallSite *site = &allocGuard.callSites[siteIdx];
+        if (site->frameCount == frameCount && !memcmp(site->frames, frames, frameCount * sizeof(void *)))
+        {
+            site->count++;
+            isKnown = true;
+        }
+    }
+
+    if (!isKnown && allocGuard.callSiteCount < ALLOC_GUARD_MAX_CALL_SITES)
+    {
+        AllocGuardCallSite *site = &allocGuard.callSites[allocGuard.callSiteCount++];
+        site->kind = kind;
+        site->size = size;
+        site->count = 1;
+        site->frameCount = frameCount;
+        memcpy(site->frames, frames, frameCount * sizeof(void *));
+    }
+
+    end_spin_lock(&allocGuard.lock);
+}
+
+internal void alloc_guard_on_runtime_allocation(u64 size)
+{
+    alloc_guard_on_allocation("malloc", size);
+}
+
+/**
+ * Hooks the allocations of the C runtime, the guard starts disarmed.
+ * Without the debug runtime only the Heap and the Game Memory are checked.
+ */
+void alloc_guard_init()
+{
+    allocGuard = {};
+    if (!platform_hook_allocations(alloc_guard_on_runtime_allocation))
+    {
+        CAKEZ_WARN("The C Runtime can't be hooked, malloc and new are not checked. Build with /MTd");
+    }
+}
+
+// Checks the allocations of the calling thread from now on
+void alloc_guard_arm()
+{
+    isAllocGuardArmed = true;
+}
+
+void alloc_guard_disarm()
+{
+    isAllocGuardArmed = false;
+}
+
+/**
+ * Logs the call sites that allocated since the last report. The guard has to be
+ * disarmed, looking up the symbols allocates.
+ * @return Violations since the last report
+ */
+u32 alloc_guard_report()
+{
+    CAKEZ_ASSERT(!isAllocGuardArmed, "Disarm the Allocation Guard before the report");
+
+    begin_spin_lock(&allocGuard.lock);
+    u32 violationCount = allocGuard.violationCount - allocGuard.reportedViolationCount;
+    u32 firstCallSite = allocGuard.reportedCallSiteCount;
+    u32 callSiteCount = allocGuard.callSiteCount;
+    allocGuard.reportedViolationCount = allocGuard.violationCount;
+    allocGuard.reportedCallSiteCount = allocGuard.callSiteCount;
+    end_spin_lock(&allocGuard.lock);
+
+    char symbol[ALLOC_GUARD_MAX_SYMBOL_LENGTH];
+    for (u32 siteIdx = firstCallSite; siteIdx < callSiteCount; siteIdx++)
+    {
+        AllocGuardCallSite *site = &allocGuard.callSites[siteIdx];
+        CAKEZ_WARN("Allocation from %s of %llu bytes in the frame loop, %u times so far:",
+                   site->kind, site->size, site->count);
+        for (u32 frameIdx = 0; frameIdx < site->frameCount; frameIdx++)
+        {
+            platform_describe_address(site->frames[frameIdx], symbol, ALLOC_GUARD_MAX_SYMBOL_LENGTH);
+            CAKEZ_WARN("    %s", symbol);
+        }
+    }
+
+    if (violationCount && callSiteCount == ALLOC_GUARD_MAX_CALL_SITES)
+    {
+        CAKEZ_WARN("More than %u call sites allocated, only the first ones are shown", ALLOC_GUARD_MAX_CALL_SITES);
+    }
+
+    return violationCount;
+}
@@ -1,32 +1,841 @@
 #include "defines.h"
 #include "input.h"
+#include "memory.h"
+#include "platform.h"
+#include "profiler.h"
 
-u32 constexpr MAX_BUFFER_LENGTH = MB(1);
+#include "encoding.cpp"
+#include "line_ops.cpp"
+#include "word_index.cpp"
+#include "file_finder.cpp"
+#include "symbol_index.cpp"
+#include "keybindings.cpp"
+#include "latency.cpp"
+#include "input_recording.cpp"
+
+// Address space reserved for the text, charCount has to fit into a u32
+u64 constexpr MAX_TEXT_LENGTH = GB(2);
+// The text commits memory in steps of this size as it grows
+u32 constexpr TEXT_GROW_SIZE = MB(1);
+// With --large-pages files from this size on are loaded into Large Pages
+u64 constexpr LARGE_PAGE_TEXT_MIN_SIZE = MB(64);
+// Room for a sorted copy of the largest text and the Slices of 64M lines,
+// only what the sort of the current text needs gets committed
+u64 constexpr MAX_SORT_MEMORY = MAX_TEXT_LENGTH + GB(1);
+// Address space for the Word Index, a Trie of the largest text fits into it
+u32 constexpr MAX_WORD_INDEX_NODES = 64 * 1024 * 1024;
+u64 constexpr MAX_WORD_INDEX_LABEL_BYTES = GB(1);
+// Address space for the File Finder, enough for a tree of 1M files
+u32 constexpr MAX_FINDER_PATHS = 1024 * 1024;
+u64 constexpr MAX_FINDER_PATH_BYTES = MB(256);
+u32 constexpr MAX_COMPLETIONS = 8;
+u32 constexpr MAX_MEMORY_REPORT_LENGTH = KB(4);
+u32 constexpr MAX_OUTPUT_FILES = 4;
+
+// Written by the editor itself, see COMMAND_DUMP_MEMORY_REPORT and COMMAND_TOGGLE_TRACE_CAPTURE
+global_variable char *editorOutputNames[] = {"memory_report.txt", "trace.json"};
+
+// Version control and build output, see build.bat
+global_variable char *ignoredFolderNames[] = {".git", ".svn", ".hg", ".vs", "build"};
+global_variable char *ignoredExtensions[] = {"exe", "pdb", "ilk", "obj", "lib", "exp"};
 
 struct AppState
 {
+    // Grows with the text inside of textMemory, the bytes after charCount are zero
     uint32_t charCount;
-    //TODO: Replace with MAX_BUFFER_LENGTH
-    unsigned char buffer[1000];
+    u32 bufferCapacity;
+    unsigned char *buffer;
+    GameMemory textMemory;
+
+    // Set by --large-pages, scans over a large text miss the TLB a lot less with them
+    bool useLargePages;
+
+    // Used to save the file the way it was loaded
+    char filePath[MAX_PATH_LENGTH];
+    TextEncoding encoding;
+    LineEnding lineEnding;
+    bool hasBom;
+
+    // Used by long running commands, reset after every command
+    GameMemory transientMemory;
+
+    // Reserved, sorting lines commits what the text needs and gives it back afterwards
+    GameMemory sortMemory;
+
+    // Reset at the start of every frame, for data that only lives for one frame
+    GameMemory frameMemory;
+
+    // Everything else is carved out of this, only used for the Memory Report
+    GameMemory *gameMemory;
+    bool memoryOverlayOpen;
+    bool perfHudOpen;
+    WorkQueue *workQueue;
+
+    WordIndex wordIndex;
+    u32 completionCount;
+    WordCompletion completions[MAX_COMPLETIONS];
+
+    // Ctrl+P, fuzzy search over every file below the working directory
+    FileFinder fileFinder;
+    bool filePaletteOpen;
+    u32 filePaletteQueryLength;
+    char filePaletteQuery[MAX_FINDER_QUERY_LENGTH + 1];
+
+    // Refreshed once the File Finder is ready and after saving
+    SymbolIndex symbolIndex;
+
+    // Work that waits for a background job, checked when the platform wakes us up
+    bool folderChanged;
+
+    // Files from the command line the editor writes to, like the binary log.
+    // Changes to them don't count as changes to the watched folder
+    u32 outputFileCount;
+    char outputFileNames[MAX_OUTPUT_FILES][MAX_PATH_LENGTH];
+    bool filePaletteStale;
+    bool completionsStale;
+
+    KeyBindings keyBindings;
+
+    // The text input of a key that ran a Command is not typed
+    bool suppressNextChar;
+
+    // Filled by update_app and vk_render
+    LatencyTracker latency;
 };
 
-internal void update_app(AppState* app, InputState* input)
+internal void app_sort_lines(AppState *app, bool unique = false)
 {
-    for(u8 keyIdx = 0; keyIdx < 255; keyIdx++)
+    u32 oldCharCount = app->charCount;
+    app->charCount = line_ops_sort((char *)app->buffer, app->charCount, unique,
+                                   &app->sortMemory, app->workQueue);
+    decommit_unused_memory(&app->sortMemory);
+
+    // The buffer is rendered as a null terminated string
+    memset(app->buffer + app->charCount, 0, oldCharCount - app->charCount);
+}
+
+internal void app_unique_lines(AppState *app)
+{
+    app_sort_lines(app, true);
+
+    // Dropping lines changes the word counts
+    word_index_queue_text(&app->wordIndex, app->workQueue, (char *)app->buffer, app->charCount);
+}
+
+internal void app_reverse_lines(AppState *app)
+{
+    line_ops_reverse((char *)app->buffer, app->charCount);
+}
+
+/**
+ * Makes sure the buffer can hold length bytes of text and the null
+ * terminator, the memory it grows by is zeroed.
+ * @return false if the text would not fit into MAX_TEXT_LENGTH
+ */
+internal bool app_reserve_text(AppState *app, u64 length)
+{
+    if (length < app->bufferCapacity)
     {
-        if(key_pressed_this_frame(input, keyIdx))
+        return true;
+    }
+
+    u64 capacity = (length + TEXT_GROW_SIZE) / TEXT_GROW_SIZE * TEXT_GROW_SIZE;
+
+    // Large Pages are committed at once and can't grow, the text moves to regular pages
+    if (app->textMemory.hasLargePages && capacity >= app->textMemory.memorySizeInBytes)
+    {
+        GameMemory textMemory;
+        if (!init_reserved_memory(&textMemory, MAX_TEXT_LENGTH, true))
+        {
+            return false;
+        }
+
+        if (!allocate_memory(&textMemory, app->bufferCapacity, MEMORY_TAG_TEXT))
         {
-            if(keyIdx == 8)
+            release_memory(&textMemory);
+            return false;
+        }
+
+        memcpy(textMemory.memory, app->buffer, app->bufferCapacity);
+        release_memory(&app->textMemory);
+        app->textMemory = textMemory;
+        app->buffer = app->textMemory.memory;
+    }
+
+    if (capacity >= app->textMemory.memorySizeInBytes ||
+        !allocate_memory(&app->textMemory, capacity - app->bufferCapacity, MEMORY_TAG_TEXT))
+    {
+        return false;
+    }
+
+    app->bufferCapacity = (u32)capacity;
+    return true;
+}
+
+/**
+ * Reserves the address space for the text, nothing is committed until it grows.
+ * The old text is gone afterwards, unless this fails.
+ * @param largePageBytes Uses Large Pages of this size instead if the system allows it,
+ * they are committed at once
+ */
+internal bool app_init_text(AppState *app, u64 largePageBytes = 0)
+{
+    GameMemory textMemory = {};
+    if (largePageBytes && init_large_page_memory(&textMemory, largePageBytes) && !textMemory.hasLargePages)
+    {
+        // The fallback only reserves largePageBytes, the text gets all of its address space instead
+        release_memory(&textMemory);
+    }
+
+    if (!textMemory.memory && !init_reserved_memory(&textMemory, MAX_TEXT_LENGTH))
+    {
+        return false;
+    }
+    textMemory.growsInFrameLoop = true;
+
+    if (app->textMemory.memory)
+    {
+        release_memory(&app->textMemory);
+    }
+    app->textMemory = textMemory;
+    app->buffer = app->textMemory.memory;
+    app->bufferCapacity = 0;
+    app->charCount = 0;
+    return app_reserve_text(app, 0);
+}
+
+/**
+ * Streams the file into the buffer, converting it to UTF-8 with LF
+ * line endings one chunk at a time. The buffer grows to the size of the file.
+ */
+internal bool app_open_file(AppState *app, char *path)
+{
+    u64 fileSize = platform_get_file_size(path);
+    if (!fileSize && !platform_file_exists(path))
+    {
+        CAKEZ_WARN("Failed to open file %s", path);
+        return false;
+    }
+
+    // The old text is replaced anyway, Large Pages hold the file and room for some growth
+    bool wantsLargePages = app->useLargePages && fileSize >= LARGE_PAGE_TEXT_MIN_SIZE &&
+                           fileSize + fileSize / 8 + TEXT_GROW_SIZE < MAX_TEXT_LENGTH;
+    if ((wantsLargePages || app->textMemory.hasLargePages) &&
+        !app_init_text(app, wantsLargePages ? fileSize + fileSize / 8 + TEXT_GROW_SIZE : 0))
+    {
+        CAKEZ_WARN("Failed to reserve memory for file %s", path);
+        return false;
+    }
+
+    // Most files decode to about their own size, so this is usually the only time the buffer grows
+    if (!app_reserve_text(app, fileSize))
+    {
+        CAKEZ_WARN("File %s is too large to open, the limit is %llu MB", path, MAX_TEXT_LENGTH / MB(1));
+        return false;
+    }
+
+    // One handle for the whole stream
+    void *file = platform_open_file_for_reading(path);
+    if (!file)
+    {
+        CAKEZ_WARN("Failed to open file %s", path);
+        return false;
+    }
+
+    TempMemory tempMemory = begin_temp_memory(&app->transientMemory);
+    u8 *in = allocate_memory(&app->transientMemory, TEXT_CHUNK_SIZE);
+    u8 *out = allocate_memory(&app->transientMemory, TEXT_DECODE_OUT_SIZE(TEXT_CHUNK_SIZE));
+
+    TextDecoder decoder = {};
+    u32 oldCharCount = app->charCount;
+    u32 charCount = 0;
+    bool tooLarge = false;
+    bool readFailed = false;
+
+    u64 offset = 0;
+    while (offset < fileSize)
+    {
+        u64 remaining = fileSize - offset;
+        u32 bytesRead = platform_read_from_file(file, (char *)in, remaining < TEXT_CHUNK_SIZE ? (u32)remaining : TEXT_CHUNK_SIZE);
+        if (!bytesRead)
+        {
+            // The file got shorter or can't be read, the end of it would be missing
+            readFailed = true;
+            break;
+        }
+
+        if (offset == 0)
+        {
+            text_decoder_begin(&decoder, in, bytesRead);
+        }
+        offset += bytesRead;
+
+        u32 length = text_decoder_decode(&decoder, in, bytesRead, out);
+        if (offset >= fileSize)
+        {
+            length += text_decoder_finish(&decoder, out + length);
+        }
+
+        // Latin-1 can decode to up to twice the bytes the file has
+        if (!app_reserve_text(app, (u64)charCount + length))
+        {
+            tooLarge = true;
+            break;
+        }
+
+        memcpy(app->buffer + charCount, out, length);
+        charCount += length;
+    }
+
+    platform_close_file(file);
+    end_temp_memory(tempMemory);
+
+    if (tooLarge)
+    {
+        CAKEZ_WARN("File %s is too large to open once it is decoded, the limit is %llu MB",
+                   path, MAX_TEXT_LENGTH / MB(1));
+    }
+    else if (readFailed)
+    {
+        CAKEZ_WARN("Failed reading file %s after %llu of %llu bytes", path, offset, fileSize);
+    }
+
+    u32 writtenCount = charCount > oldCharCount ? charCount : oldCharCount;
+    if (tooLarge || readFailed)
+    {
+        // The old text is overwritten already, forget the path so it isn't saved over the file
+        charCount = 0;
+        app->filePath[0] = 0;
+    }
+    memset(app->buffer + charCount, 0, writtenCount - charCount);
+    app->charCount = charCount;
+    app->encoding = decoder.encoding;
+    app->lineEnding = decoder.lineEnding;
+    app->hasBom = decoder.hasBom;
+    word_index_queue_text(&app->wordIndex, app->workQueue, (char *)app->buffer, app->charCount);
+    if (tooLarge || readFailed)
+    {
+        return false;
+    }
+
+    snprintf(app->filePath, MAX_PATH_LENGTH, "%s", path);
+    return true;
+}
+
+/**
+ * Writes the buffer back in the encoding and with the line endings
+ * the file had when it was opened.
+ */
+internal bool app_save_file(AppState *app, char *path)
+{
+    TempMemory tempMemory = begin_temp_memory(&app->transientMemory);
+    u8 *scratch = allocate_memory(&app->transientMemory, TEXT_ENCODE_SCRATCH_SIZE(TEXT_CHUNK_SIZE));
+    u8 *out = allocate_memory(&app->transientMemory, TEXT_ENCODE_OUT_SIZE(TEXT_CHUNK_SIZE));
+
+    TextEncoder encoder;
+    text_encoder_begin(&encoder, app->encoding, app->lineEnding, app->hasBom);
+
+    bool success = true;
+    bool overwrite = true;
+    for (u32 offset = 0; offset < app->charCount || overwrite;)
+    {
+        u32 size = app->charCount - offset;
+        size = size > TEXT_CHUNK_SIZE ? TEXT_CHUNK_SIZE : size;
+
+        u32 length = text_encoder_encode(&encoder, app->buffer + offset, size, scratch, out);
+        offset += size;
+        if (offset == app->charCount)
+        {
+            length += text_encoder_finish(&encoder, out + length);
+        }
+
+        if (platform_write_file(path, (char *)out, length, overwrite) != length)
+        {
+            success = false;
+            break;
+        }
+        overwrite = false;
+    }
+
+    end_temp_memory(tempMemory);
+
+    // Only the saved file gets parsed again
+    app->symbolIndex.isRefreshed = false;
+    return success;
+}
+
+/**
+ * Opens the file that defines the word in front of the cursor.
+ */
+internal bool app_goto_definition(AppState *app)
+{
+    char *text = (char *)app->buffer;
+    u32 wordStart = word_index_word_start(text, app->charCount);
+
+    char path[MAX_PATH_LENGTH];
+    u32 line = 0;
+    if (!symbol_index_find(&app->symbolIndex, text + wordStart, app->charCount - wordStart, path, &line))
+    {
+        CAKEZ_WARN("No definition found for %.*s", app->charCount - wordStart, text + wordStart);
+        return false;
+    }
+
+    char fullPath[MAX_PATH_LENGTH];
+    snprintf(fullPath, MAX_PATH_LENGTH, "%s/%s", app->fileFinder.rootFolder, path);
+    CAKEZ_TRACE("%.*s is defined in %s:%u", app->charCount - wordStart, text + wordStart, path, line);
+    return app_open_file(app, fullPath);
+}
+
+internal void open_file_palette(AppState *app, bool open)
+{
+    app->filePaletteOpen = open;
+    app->filePaletteQueryLength = 0;
+    app->filePaletteQuery[0] = 0;
+    app->filePaletteStale = false;
+    app->fileFinder.resultCount = 0;
+}
+
+// Returns true if the query changed
+internal bool file_palette_on_char(AppState *app, u32 codepoint)
+{
+    FileFinder *finder = &app->fileFinder;
+
+    // Escape
+    if (codepoint == 27)
+    {
+        open_file_palette(app, false);
+    }
+    // Enter
+    else if (codepoint == '\r')
+    {
+        if (finder->resultCount)
+        {
+            char path[MAX_PATH_LENGTH];
+            snprintf(path, MAX_PATH_LENGTH, "%s/%s", finder->rootFolder,
+                     file_finder_get_path(finder, finder->results[0].pathIdx));
+            app_open_file(app, path);
+        }
+        open_file_palette(app, false);
+    }
+    // Backspace
+    else if (codepoint == '\b')
+    {
+        if (app->filePaletteQueryLength)
+        {
+            app->filePaletteQueryLength = utf8_previous_char_start(app->filePaletteQuery, app->filePaletteQueryLength);
+            app->filePaletteQuery[app->filePaletteQueryLength] = 0;
+            return true;
+        }
+    }
+    else if (codepoint > ' ' && codepoint != 127 && app->filePaletteQueryLength + 4 <= MAX_FINDER_QUERY_LENGTH)
+    {
+        u8 *queryEnd = (u8 *)app->filePaletteQuery + app->filePaletteQueryLength;
+        app->filePaletteQueryLength += (u32)(write_utf8(queryEnd, codepoint) - queryEnd);
+        app->filePaletteQuery[app->filePaletteQueryLength] = 0;
+        return true;
+    }
+
+    return false;
+}
+
+// The codepoint is inserted as UTF-8, the buffer is always valid UTF-8
+internal void app_on_char(AppState *app, u32 codepoint)
+{
+    // Ctrl+Letter and friends, only Tab, Enter and Backspace edit the text
+    bool isBackspace = codepoint == '\b';
+    if (codepoint == '\r')
+    {
+        codepoint = '\n';
+    }
+    else if ((codepoint < ' ' && codepoint != '\t' && !isBackspace) ||
+             (codepoint >= 127 && codepoint < 0xA0) ||
+             (codepoint >= 0xD800 && codepoint <= 0xDFFF) || codepoint > 0x10FFFF)
+    {
+        return;
+    }
+
+    char *text = (char *)app->buffer;
+
+    // Remove the words around the edit from the Word Index, they get added back after the edit
+    u32 editStart = isBackspace ? utf8_previous_char_start(text, app->charCount) : app->charCount;
+    u32 wordStart = word_index_word_start(text, editStart);
+    u32 wordEnd = word_index_word_end(text, app->charCount, app->charCount);
+    word_index_queue_words(&app->wordIndex, WORD_INDEX_OP_REMOVE, text + wordStart, wordEnd - wordStart);
+
+    if (isBackspace)
+    {
+        memset(app->buffer + editStart, 0, app->charCount - editStart);
+        app->charCount = editStart;
+    }
+    // The longest UTF-8 sequence is 4 bytes
+    else if (app_reserve_text(app, app->charCount + 4))
+    {
+        u8 *end = write_utf8(app->buffer + app->charCount, codepoint);
+        app->charCount = (u32)(end - app->buffer);
+    }
+
+    wordEnd = word_index_word_end(text, app->charCount, app->charCount);
+    word_index_queue_words(&app->wordIndex, WORD_INDEX_OP_ADD, text + wordStart, wordEnd - wordStart);
+}
+
+internal void app_execute_command(AppState *app, Command command)
+{
+    MEASURE_FUNCTION();
+    switch (command)
+    {
+    case COMMAND_TOGGLE_FILE_PALETTE:
+        open_file_palette(app, !app->filePaletteOpen);
+        break;
+
+    case COMMAND_GOTO_DEFINITION:
+        app_goto_definition(app);
+        break;
+
+    case COMMAND_SAVE_FILE:
+        if (app->filePath[0] && !app_save_file(app, app->filePath))
+        {
+            CAKEZ_WARN("Failed to save file %s", app->filePath);
+        }
+        break;
+
+    case COMMAND_SORT_LINES:
+        app_sort_lines(app);
+        break;
+
+    case COMMAND_UNIQUE_LINES:
+        app_unique_lines(app);
+        break;
+
+    case COMMAND_REVERSE_LINES:
+        app_reverse_lines(app);
+        break;
+
+    case COMMAND_REPORT_LATENCY:
+    {
+        TempMemory tempMemory = begin_temp_memory(&app->transientMemory);
+        u32 *scratch = (u32 *)allocate_memory(&app->transientMemory, MAX_LATENCY_SAMPLES * sizeof(u32));
+        latency_report(&app->latency, scratch);
+        end_temp_memory(tempMemory);
+        break;
+    }
+
+    case COMMAND_TOGGLE_MEMORY_OVERLAY:
+        app->memoryOverlayOpen = !app->memoryOverlayOpen;
+        break;
+
+    case COMMAND_DUMP_MEMORY_REPORT:
+    {
+        TempMemory tempMemory = begin_temp_memory(&app->transientMemory);
+        char *report = (char *)allocate_memory(&app->transientMemory, MAX_MEMORY_REPORT_LENGTH);
+        u32 length = memory_format_report(app->gameMemory, report, MAX_MEMORY_REPORT_LENGTH);
+        if (platform_write_file("memory_report.txt", report, length, true) == length)
+        {
+            CAKEZ_TRACE("Wrote the Memory Report to memory_report.txt");
+        }
+        end_temp_memory(tempMemory);
+        break;
+    }
+
+    case COMMAND_TOGGLE_TRACE_CAPTURE:
+        if (profiler.trace.isCapturing)
+        {
+            profiler_end_trace();
+        }
+        else
+        {
+            profiler_begin_trace("trace.json", app->workQueue);
+        }
+        break;
+
+    case COMMAND_TOGGLE_PERF_HUD:
+        app->perfHudOpen = !app->perfHudOpen;
+        break;
+
+    default:
+        break;
+    }
+}
+
+internal void app_on_key_down(AppState *app, InputEvent *event)
+{
+    bool consumed;
+    Command command = keybindings_dispatch(&app->keyBindings, event->key, event->modifiers, &consumed);
+    app->suppressNextChar = consumed;
+    app_execute_command(app, command);
+}
+
+/**
+ * Sets up the default Key Bindings, the bindings in the config
+ * file are added on top of them.
+ */
+internal void app_load_keybindings(AppState *app, char *configPath)
+{
+    keybindings_init(&app->keyBindings);
+
+    u32 fileSize = 0;
+    char *config = platform_file_exists(configPath) ? platform_read_file(configPath, &fileSize) : 0;
+    if (config)
+    {
+        keybindings_parse(&app->keyBindings, config, fileSize);
+    }
+}
+
+// Called by the platform layer when a file below the root folder changed
+internal void app_on_folder_changed(AppState *app)
+{
+    app->folderChanged = true;
+}
+
+// Only the name is kept, the path can be relative or absolute
+internal void app_add_output_file(AppState *app, char *path)
+{
+    if (app->outputFileCount == MAX_OUTPUT_FILES)
+    {
+        return;
+    }
+
+    char *name = path;
+    for (char *at = path; *at; at++)
+    {
+        if (*at == '/' || *at == '\\')
+        {
+            name = at + 1;
+        }
+    }
+    snprintf(app->outputFileNames[app->outputFileCount++], MAX_PATH_LENGTH, "%s", name);
+}
+
+/**
+ * Decides if a change in the watched folder has to rebuild the File Finder and
+ * the Symbol Index. Files the editor writes itself, version control and build
+ * output don't.
+ * @param path Relative to the watched folder, with '/' as separator
+ */
+internal bool app_is_watched_path(char *path, u32 length, void *data)
+{
+    AppState *app = (AppState *)data;
+
+    u32 nameStart = 0;
+    for (u32 at = 0; at <= length; at++)
+    {
+        if (at < length && path[at] != '/')
+        {
+            continue;
+        }
+
+        for (u32 folderIdx = 0; folderIdx < ArraySize(ignoredFolderNames); folderIdx++)
+        {
+            if (token_equals(path + nameStart, at - nameStart, ignoredFolderNames[folderIdx]))
+            {
+                return false;
+            }
+        }
+
+        if (at < length)
+        {
+            nameStart = at + 1;
+        }
+    }
+
+    char *name = path + nameStart;
+    u32 nameLength = length - nameStart;
+    for (u32 outputIdx = 0; outputIdx < ArraySize(editorOutputNames); outputIdx++)
+    {
+        if (token_equals(name, nameLength, editorOutputNames[outputIdx]))
+        {
+            return false;
+        }
+    }
+
+    for (u32 outputIdx = 0; outputIdx < app->outputFileCount; outputIdx++)
+    {
+        if (token_equals(name, nameLength, app->outputFileNames[outputIdx]))
+        {
+            return false;
+        }
+    }
+
+    u32 extensionStart = nameLength;
+    while (extensionStart > 0 && name[extensionStart - 1] != '.')
+    {
+        extensionStart--;
+    }
+
+    for (u32 extensionIdx = 0; extensionStart > 0 && extensionIdx < ArraySize(ignoredExtensions); extensionIdx++)
+    {
+        if (token_equals(name + extensionStart, nameLength - extensionStart, ignoredExtensions[extensionIdx]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Handles all input since the last call and picks up the results of
+ * background work.
+ * @return true if something visible changed and a frame has to be drawn
+ */
+internal bool update_app(AppState* app, InputState* input)
+{
+    MEASURE_FUNCTION();
+    bool needsRender = false;
+
+    // Files were added, removed or changed, the Symbol Index follows once the File Finder is done.
+    // A running refresh still uses the paths of the File Finder
+    if (app->folderChanged && app->symbolIndex.refreshState == SYMBOL_REFRESH_IDLE &&
+        file_finder_rebuild(&app->fileFinder, app->workQueue))
+    {
+        app->folderChanged = false;
+        app->symbolIndex.isRefreshed = false;
+        app->filePaletteStale = app->filePaletteOpen;
+    }
+
+    symbol_index_update(&app->symbolIndex, app->workQueue);
+    if (app->fileFinder.isReady && !app->symbolIndex.isRefreshed)
+    {
+        symbol_index_refresh(&app->symbolIndex, &app->fileFinder, app->workQueue);
+    }
+
+    // Events are handled in the order they happened, no matter how many arrive in one frame
+    InputEvent event;
+    while (input_pop_event(input, &event))
+    {
+        switch (event.type)
+        {
+        case INPUT_EVENT_KEY_DOWN:
+        {
+            app_on_key_down(app, &event);
+            needsRender = true;
+
+            // Keys that ran a Command, typed text is measured with its char
+            if (app->suppressNextChar)
+            {
+                latency_add_keystroke(&app->latency, event.timestamp);
+            }
+            break;
+        }
+
+        case INPUT_EVENT_CHAR:
+        {
+            // WM_CHAR directly follows the key down it was translated from
+            if (app->suppressNextChar)
+            {
+                app->suppressNextChar = false;
+            }
+            else if (app->filePaletteOpen)
             {
-                if(app->charCount > 0)
-                {
-                    app->buffer[--app->charCount] = 0;
-                }
+                app->filePaletteStale |= file_palette_on_char(app, event.codepoint);
+                latency_add_keystroke(&app->latency, event.timestamp);
             }
             else
             {
-               app->buffer[app->charCount++] = (char)keyIdx;
+                app_on_char(app, event.codepoint);
+                app->completionsStale = true;
+                latency_add_keystroke(&app->latency, event.timestamp);
             }
+            needsRender = true;
+            break;
         }
+
+        case INPUT_EVENT_MOUSE_BUTTON_DOWN:
+        case INPUT_EVENT_MOUSE_WHEEL:
+        {
+            needsRender = true;
+            break;
+        }
+
+        default:
+            break;
+        }
+
+        if (event.type != INPUT_EVENT_KEY_DOWN && event.type != INPUT_EVENT_CHAR)
+        {
+            app->suppressNextChar = false;
+        }
+    }
+
+    // The File Finder is built in the background, the query runs once it is ready
+    if (app->filePaletteOpen && app->filePaletteStale && app->fileFinder.isReady)
+    {
+        file_finder_query(&app->fileFinder, app->workQueue, app->filePaletteQuery, app->filePaletteQueryLength);
+        app->filePaletteStale = false;
+        needsRender = true;
+    }
+
+    // Edits didn't fit into the Word Index Ops, so the worker indexes the whole text again
+    if (app->wordIndex.needsRebuild)
+    {
+        word_index_queue_text(&app->wordIndex, app->workQueue, (char *)app->buffer, app->charCount);
     }
-}
\ No newline at end of file
+    word_index_update(&app->wordIndex, app->workQueue);
+
+    // Complete the word in front of the cursor, once the Word Index caught up with the edits
+    if (app->completionsStale && !app->wordIndex.jobInFlight)
+    {
+        char *text = (char *)app->buffer;
+        u32 prefixStart = word_index_word_start(text, app->charCount);
+        app->completionCount = word_index_complete(&app->wordIndex, text + prefixStart,
+                                                   app->charCount - prefixStart,
+                                                   app->completions, MAX_COMPLETIONS);
+        app->completionsStale = false;
+        needsRender = true;
+    }
+
+    latency_mark_stage(&app->latency, LATENCY_STAGE_UPDATE);
+    return needsRender;
+}
+
+/**
+ * Runs update_app once per recorded frame, as fast as possible and without
+ * rendering, then logs the frame times. Background work is finished inside
+ * the frame that started it, so every run does the same work.
+ * @return false if the recording could not be opened
+ */
+internal bool app_run_replay(AppState *app, InputState *input, char *path)
+{
+    TempMemory tempMemory = begin_temp_memory(&app->transientMemory);
+    InputReplay *replay = (InputReplay *)allocate_memory(&app->transientMemory, sizeof(InputReplay));
+    u32 *histogram = (u32 *)allocate_memory(&app->transientMemory, REPLAY_HISTOGRAM_BUCKETS * sizeof(u32));
+    memset(histogram, 0, REPLAY_HISTOGRAM_BUCKETS * sizeof(u32));
+
+    if (!input_replay_open(replay, path))
+    {
+        end_temp_memory(tempMemory);
+        return false;
+    }
+
+    // Start from the same state every time, with the File Finder and Symbol Index built
+    do
+    {
+        update_app(app, input);
+        platform_complete_all_work(app->workQueue);
+    } while (!app->fileFinder.isReady || !app->symbolIndex.isRefreshed ||
+             app->symbolIndex.refreshState != SYMBOL_REFRESH_IDLE);
+
+    u64 frequency = platform_get_performance_tick_frequency();
+    u64 totalTicks = 0;
+    u32 frameCount = 0;
+    while (input_replay_next_frame(replay, input))
+    {
+        u64 startTicks = platform_get_performance_tick_count();
+        profiler_begin_frame();
+        reset_memory(&app->frameMemory);
+        update_app(app, input);
+        platform_complete_all_work(app->workQueue);
+        u64 elapsedTicks = platform_get_performance_tick_count() - startTicks;
+        profiler_end_frame();
+
+        u64 microseconds = (elapsedTicks * 1000000) / frequency;
+        histogram[microseconds < REPLAY_HISTOGRAM_BUCKETS ? microseconds : REPLAY_HISTOGRAM_BUCKETS - 1]++;
+        totalTicks += elapsedTicks;
+        frameCount++;
+    }
+
+    input_replay_report(histogram, frameCount, (totalTicks * 1000000) / frequency);
+    profiler_log_report();
+
+    end_temp_memory(tempMemory);
+    return true;
+}
@@ -0,0 +1,710 @@
+#include "defines.h"
+#include "logger.h"
+
+// SSE2 is part of x64, so we don't need to check for it
+#include <emmintrin.h>
+#include <intrin.h>
+
+#include <string.h>
+
+// Text inside the editor is always UTF-8 with LF line endings, files
+// get converted once per chunk when loading and back when saving
+enum TextEncoding : u8
+{
+    TEXT_ENCODING_UTF8,
+    TEXT_ENCODING_UTF16_LE,
+    TEXT_ENCODING_UTF16_BE,
+    TEXT_ENCODING_LATIN1,
+};
+
+enum LineEnding : u8
+{
+    LINE_ENDING_LF,
+    LINE_ENDING_CRLF,
+};
+
+u32 constexpr TEXT_CHUNK_SIZE = KB(64);
+u32 constexpr UTF8_REPLACEMENT_CHARACTER = 0xFFFD;
+
+// Worst case: Latin-1 -> UTF-8 doubles the size
+#define TEXT_DECODE_OUT_SIZE(inSize) (2 * (inSize) + 8)
+// Worst case: LF -> CRLF and ASCII -> UTF-16 both double the size
+#define TEXT_ENCODE_SCRATCH_SIZE(inSize) (2 * (inSize) + 8)
+#define TEXT_ENCODE_OUT_SIZE(inSize) (4 * (inSize) + 16)
+
+struct TextDecoder
+{
+    TextEncoding encoding;
+    LineEnding lineEnding;
+    bool hasBom;
+    u32 bytesToSkip;
+
+    // State carried over from the last chunk
+    bool pendingCR;
+    s32 pendingByte;
+    u32 pendingHighSurrogate;
+};
+
+struct TextEncoder
+{
+    TextEncoding encoding;
+    LineEnding lineEnding;
+    bool hasBom;
+    bool wroteBom;
+
+    // Incomplete UTF-8 sequence at the end of the last chunk
+    u8 carry[4];
+    u32 carryCount;
+};
+
+internal u32 bit_scan_forward(u32 mask)
+{
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return idx;
+}
+
+internal u8 *write_utf8(u8 *out, u32 codepoint)
+{
+    if (codepoint < 0x80)
+    {
+        *out++ = (u8)codepoint;
+    }
+    else if (codepoint < 0x800)
+    {
+        *out++ = (u8)(0xC0 | (codepoint >> 6));
+        *out++ = (u8)(0x80 | (codepoint & 0x3F));
+    }
+    else if (codepoint < 0x10000)
+    {
+        *out++ = (u8)(0xE0 | (codepoint >> 12));
+        *out++ = (u8)(0x80 | ((codepoint >> 6) & 0x3F));
+        *out++ = (u8)(0x80 | (codepoint & 0x3F));
+    }
+    else
+    {
+        *out++ = (u8)(0xF0 | (codepoint >> 18));
+        *out++ = (u8)(0x80 | ((codepoint >> 12) & 0x3F));
+        *out++ = (u8)(0x80 | ((codepoint >> 6) & 0x3F));
+        *out++ = (u8)(0x80 | (codepoint & 0x3F));
+    }
+
+    return out;
+}
+
+// Returns the length of the UTF-8 sequence started by lead, 0 if lead is a continuation byte
+internal u32 utf8_sequence_length(u8 lead)
+{
+    return lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+}
+
+// Returns the offset of the character in front of offset, continuation bytes are skipped
+internal u32 utf8_previous_char_start(char *text, u32 offset)
+{
+    while (offset > 0 && ((u8)text[--offset] & 0xC0) == 0x80)
+    {
+    }
+
+    return offset;
+}
+
+/**
+ * Decodes one UTF-8 sequence. Invalid sequences decode to
+ * the replacement character and consume a single byte.
+ * @param size Bytes available at in, the caller makes sure the sequence is complete
+ * @return The amount of bytes consumed
+ */
+internal u32 read_utf8(u8 *in, u32 size, u32 *codepoint)
+{
+    u8 lead = in[0];
+    u32 length = utf8_sequence_length(lead);
+
+    if (length == 1)
+    {
+        *codepoint = lead;
+        return 1;
+    }
+
+    if (length == 0 || length > size)
+    {
+        *codepoint = UTF8_REPLACEMENT_CHARACTER;
+        return 1;
+    }
+
+    u32 result = lead & (0xFF >> (length + 1));
+    for (u32 i = 1; i < length; i++)
+    {
+        if ((in[i] & 0xC0) != 0x80)
+        {
+            *codepoint = UTF8_REPLACEMENT_CHARACTER;
+            return 1;
+        }
+        result = (result << 6) | (in[i] & 0x3F);
+    }
+
+    *codepoint = result;
+    return length;
+}
+
+internal bool is_valid_utf8(u8 *data, u32 size)
+{
+    u32 idx = 0;
+    while (idx < size)
+    {
+        u32 length = utf8_sequence_length(data[idx]);
+        if (!length)
+        {
+            return false;
+        }
+
+        // The sequence is cut off by the end of the sample
+        if (idx + length > size)
+        {
+            break;
+        }
+
+        for (u32 i = 1; i < length; i++)
+        {
+            if ((data[idx + i] & 0xC0) != 0x80)
+            {
+                return false;
+            }
+        }
+        idx += length;
+    }
+
+    return true;
+}
+
+/**
+ * Looks at the first chunk of a file to figure out the encoding,
+ * a BOM wins, otherwise UTF-16 is detected by the zero bytes of ASCII
+ * text and invalid UTF-8 is treated as Latin-1.
+ */
+void text_decoder_begin(TextDecoder *decoder, u8 *data, u32 size)
+{
+    *decoder = {};
+    decoder->pendingByte = -1;
+
+    if (size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF)
+    {
+        decoder->encoding = TEXT_ENCODING_UTF8;
+        decoder->hasBom = true;
+        decoder->bytesToSkip = 3;
+    }
+    else if (size >= 2 && data[0] == 0xFF && data[1] == 0xFE)
+    {
+        decoder->encoding = TEXT_ENCODING_UTF16_LE;
+        decoder->hasBom = true;
+        decoder->bytesToSkip = 2;
+    }
+    else if (size >= 2 && data[0] == 0xFE && data[1] == 0xFF)
+    {
+        decoder->encoding = TEXT_ENCODING_UTF16_BE;
+        decoder->hasBom = true;
+        decoder->bytesToSkip = 2;
+    }
+    else
+    {
+        u32 sampleSize = size > KB(4) ? KB(4) : size;
+
+        u32 evenZeros = 0;
+        u32 oddZeros = 0;
+        for (u32 idx = 0; idx + 1 < sampleSize; idx += 2)
+        {
+            evenZeros += data[idx] == 0;
+            oddZeros += data[idx + 1] == 0;
+        }
+
+        u32 pairCount = sampleSize / 2;
+        if (pairCount && oddZeros * 10 > pairCount * 4 && evenZeros * 20 < pairCount)
+        {
+            decoder->encoding = TEXT_ENCODING_UTF16_LE;
+        }
+        else if (pairCount && evenZeros * 10 > pairCount * 4 && oddZeros * 20 < pairCount)
+        {
+            decoder->encoding = TEXT_ENCODING_UTF16_BE;
+        }
+        else
+        {
+            decoder->encoding = is_valid_utf8(data, sampleSize) ? TEXT_ENCODING_UTF8 : TEXT_ENCODING_LATIN1;
+        }
+    }
+}
+
+/**
+ * Replaces CRLF with LF, 16 bytes at a time while there is no CR.
+ * dst can be the same as src or in front of it.
+ * @return The amount of bytes written to dst
+ */
+internal u32 crlf_to_lf(TextDecoder *decoder, u8 *src, u32 size, u8 *dst)
+{
+    u8 *read = src;
+    u8 *end = src + size;
+    u8 *write = dst;
+    __m128i carriageReturn = _mm_set1_epi8('\r');
+
+    // CR at the end of the last chunk
+    if (decoder->pendingCR && read < end)
+    {
+        decoder->pendingCR = false;
+        if (*read == '\n')
+        {
+            decoder->lineEnding = LINE_ENDING_CRLF;
+        }
+        else
+        {
+            *write++ = '\r';
+        }
+    }
+
+    while (read < end)
+    {
+        if (end - read >= 16)
+        {
+            __m128i chunk = _mm_loadu_si128((__m128i *)read);
+            u32 mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, carriageReturn));
+            if (!mask)
+            {
+                _mm_storeu_si128((__m128i *)write, chunk);
+                read += 16;
+                write += 16;
+                continue;
+            }
+
+            u32 runLength = bit_scan_forward(mask);
+            memmove(write, read, runLength);
+            read += runLength;
+            write += runLength;
+        }
+
+        u8 c = *read++;
+        if (c == '\r')
+        {
+            if (read == end)
+            {
+                decoder->pendingCR = true;
+                continue;
+            }
+
+            if (*read == '\n')
+            {
+                decoder->lineEnding = LINE_ENDING_CRLF;
+                continue;
+            }
+        }
+
+        *write++ = c;
+    }
+
+    return (u32)(write - dst);
+}
+
+internal u8 *write_utf16_unit_as_utf8(TextDecoder *decoder, u32 unit, u8 *out)
+{
+    bool isHighSurrogate = unit >= 0xD800 && unit <= 0xDBFF;
+    bool isLowSurrogate = unit >= 0xDC00 && unit <= 0xDFFF;
+
+    if (decoder->pendingHighSurrogate)
+    {
+        if (isLowSurrogate)
+        {
+            u32 codepoint = 0x10000 + ((decoder->pendingHighSurrogate - 0xD800) << 10) + (unit - 0xDC00);
+            decoder->pendingHighSurrogate = 0;
+            return write_utf8(out, codepoint);
+        }
+
+        // Lonely High Surrogate
+        out = write_utf8(out, UTF8_REPLACEMENT_CHARACTER);
+        decoder->pendingHighSurrogate = 0;
+    }
+
+    if (isHighSurrogate)
+    {
+        decoder->pendingHighSurrogate = unit;
+    }
+    else
+    {
+        out = write_utf8(out, isLowSurrogate ? UTF8_REPLACEMENT_CHARACTER : unit);
+    }
+
+    return out;
+}
+
+internal u32 utf16_to_utf8(TextDecoder *decoder, u8 *in, u32 size, u8 *out)
+{
+    bool bigEndian = decoder->encoding == TEXT_ENCODING_UTF16_BE;
+    u8 *outStart = out;
+    u8 *end = in + size;
+
+    // Code Unit split between two chunks
+    if (decoder->pendingByte >= 0 && in < end)
+    {
+        u32 unit = bigEndian ? ((u32)decoder->pendingByte << 8) | in[0]
+                             : ((u32)in[0] << 8) | (u32)decoder->pendingByte;
+        out = write_utf16_unit_as_utf8(decoder, unit, out);
+        decoder->pendingByte = -1;
+        in++;
+    }
+
+    __m128i nonAsciiMask = _mm_set1_epi16((s16)0xFF80);
+    __m128i zero = _mm_setzero_si128();
+
+    while (end - in >= 2)
+    {
+        // 8 ASCII Code Units at a time
+        if (end - in >= 16 && !decoder->pendingHighSurrogate)
+        {
+            __m128i units = _mm_loadu_si128((__m128i *)in);
+            if (bigEndian)
+            {
+                units = _mm_or_si128(_mm_slli_epi16(units, 8), _mm_srli_epi16(units, 8));
+            }
+
+            __m128i isAscii = _mm_cmpeq_epi16(_mm_and_si128(units, nonAsciiMask), zero);
+            if (_mm_movemask_epi8(isAscii) == 0xFFFF)
+            {
+                _mm_storel_epi64((__m128i *)out, _mm_packus_epi16(units, units));
+                in += 16;
+                out += 8;
+                continue;
+            }
+        }
+
+        u32 unit = bigEndian ? ((u32)in[0] << 8) | in[1] : ((u32)in[1] << 8) | in[0];
+        out = write_utf16_unit_as_utf8(decoder, unit, out);
+        in += 2;
+    }
+
+    if (in < end)
+    {
+        decoder->pendingByte = *in;
+    }
+
+    return (u32)(out - outStart);
+}
+
+internal u32 latin1_to_utf8(u8 *in, u32 size, u8 *out)
+{
+    u8 *outStart = out;
+    u8 *end = in + size;
+
+    while (in < end)
+    {
+        // 16 ASCII Characters at a time
+        if (end - in >= 16)
+        {
+            __m128i chars = _mm_loadu_si128((__m128i *)in);
+            if (!_mm_movemask_epi8(chars))
+            {
+                _mm_storeu_si128((__m128i *)out, chars);
+                in += 16;
+                out += 16;
+                continue;
+            }
+        }
+
+        out = write_utf8(out, *in++);
+    }
+
+    return (u32)(out - outStart);
+}
+
+/**
+ * Converts a chunk of a file to UTF-8 with LF line endings.
+ * Chunks can be split anywhere, incomplete characters are
+ * carried over to the next call.
+ * @param out Needs to hold TEXT_DECODE_OUT_SIZE(size) bytes
+ * @return The amount of bytes written to out
+ */
+u32 text_decoder_decode(TextDecoder *decoder, u8 *in, u32 size, u8 *out)
+{
+    u32 skip = decoder->bytesToSkip < size ? decoder->bytesToSkip : size;
+    decoder->bytesToSkip -= skip;
+    in += skip;
+    size -= skip;
+
+    u32 outLength = 0;
+    switch (decoder->encoding)
+    {
+    case TEXT_ENCODING_UTF8:
+    {
+        outLength = crlf_to_lf(decoder, in, size, out);
+        break;
+    }
+
+    // Transcode behind a one byte gap, a pending CR might need it
+    case TEXT_ENCODING_UTF16_LE:
+    case TEXT_ENCODING_UTF16_BE:
+    {
+        u32 length = utf16_to_utf8(decoder, in, size, out + 1);
+        outLength = crlf_to_lf(decoder, out + 1, length, out);
+        break;
+    }
+
+    case TEXT_ENCODING_LATIN1:
+    {
+        u32 length = latin1_to_utf8(in, size, out + 1);
+        outLength = crlf_to_lf(decoder, out + 1, length, out);
+        break;
+    }
+    }
+
+    return outLength;
+}
+
+/**
+ * Flushes the state that is left after the last chunk
+ * @param out Needs to hold 8 bytes
+ */
+u32 text_decoder_finish(TextDecoder *decoder, u8 *out)
+{
+    u8 *outStart = out;
+
+    if (decoder->pendingHighSurrogate || decoder->pendingByte >= 0)
+    {
+        out = write_utf8(out, UTF8_REPLACEMENT_CHARACTER);
+        decoder->pendingHighSurrogate = 0;
+        decoder->pendingByte = -1;
+    }
+
+    if (decoder->pendingCR)
+    {
+        *out++ = '\r';
+        decoder->pendingCR = false;
+    }
+
+    return (u32)(out - outStart);
+}
+
+/**
+ * Replaces LF with CRLF, 16 bytes at a time while there is no LF.
+ * @return The amount of bytes written to dst
+ */
+internal u32 lf_to_crlf(u8 *src, u32 size, u8 *dst)
+{
+    u8 *read = src;
+    u8 *end = src + size;
+    u8 *write = dst;
+    __m128i lineFeed = _mm_set1_epi8('\n');
+
+    while (read < end)
+    {
+        if (end - read >= 16)
+        {
+            __m128i chunk = _mm_loadu_si128((__m128i *)read);
+            u32 mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, lineFeed));
+            if (!mask)
+            {
+                _mm_storeu_si128((__m128i *)write, chunk);
+                read += 16;
+                write += 16;
+                continue;
+            }
+
+            u32 runLength = bit_scan_forward(mask);
+            memcpy(write, read, runLength);
+            read += runLength;
+            write += runLength;
+        }
+
+        u8 c = *read++;
+        if (c == '\n')
+        {
+            *write++ = '\r';
+        }
+        *write++ = c;
+    }
+
+    return (u32)(write - dst);
+}
+
+internal u8 *write_utf16(u8 *out, u32 unit, bool bigEndian)
+{
+    out[0] = bigEndian ? (u8)(unit >> 8) : (u8)unit;
+    out[1] = bigEndian ? (u8)unit : (u8)(unit >> 8);
+    return out + 2;
+}
+
+internal u32 utf8_to_utf16(u8 *in, u32 size, u8 *out, bool bigEndian)
+{
+    u8 *outStart = out;
+    u8 *end = in + size;
+    __m128i zero = _mm_setzero_si128();
+
+    while (in < end)
+    {
+        // 16 ASCII Characters at a time
+        if (end - in >= 16)
+        {
+            __m128i chars = _mm_loadu_si128((__m128i *)in);
+            if (!_mm_movemask_epi8(chars))
+            {
+                __m128i low = _mm_unpacklo_epi8(chars, zero);
+                __m128i high = _mm_unpackhi_epi8(chars, zero);
+                if (bigEndian)
+                {
+                    low = _mm_slli_epi16(low, 8);
+                    high = _mm_slli_epi16(high, 8);
+                }
+
+                _mm_storeu_si128((__m128i *)out, low);
+                _mm_storeu_si128((__m128i *)(out + 16), high);
+                in += 16;
+                out += 32;
+                continue;
+            }
+        }
+
+        u32 codepoint;
+        in += read_utf8(in, (u32)(end - in), &codepoint);
+
+        if (codepoint >= 0x10000)
+        {
+            codepoint -= 0x10000;
+            out = write_utf16(out, 0xD800 + (codepoint >> 10), bigEndian);
+            out = write_utf16(out, 0xDC00 + (codepoint & 0x3FF), bigEndian);
+        }
+        else
+        {
+            out = write_utf16(out, codepoint, bigEndian);
+        }
+    }
+
+    return (u32)(out - outStart);
+}
+
+internal u32 utf8_to_latin1(u8 *in, u32 size, u8 *out)
+{
+    u8 *outStart = out;
+    u8 *end = in + size;
+
+    while (in < end)
+    {
+        // 16 ASCII Characters at a time
+        if (end - in >= 16)
+        {
+            __m128i chars = _mm_loadu_si128((__m128i *)in);
+            if (!_mm_movemask_epi8(chars))
+            {
+                _mm_storeu_si128((__m128i *)out, chars);
+                in += 16;
+                out += 16;
+                continue;
+            }
+        }
+
+        u32 codepoint;
+        in += read_utf8(in, (u32)(end - in), &codepoint);
+        *out++ = codepoint <= 0xFF ? (u8)codepoint : '?';
+    }
+
+    return (u32)(out - outStart);
+}
+
+void text_encoder_begin(TextEncoder *encoder, TextEncoding encoding,
+                        LineEnding lineEnding, bool hasBom)
+{
+    *encoder = {};
+    encoder->encoding = encoding;
+    encoder->lineEnding = lineEnding;
+    encoder->hasBom = hasBom;
+}
+
+internal u32 text_encoder_transcode(TextEncoder *encoder, u8 *in, u32 size, u8 *out)
+{
+    u8 *outStart = out;
+
+    if (encoder->hasBom && !encoder->wroteBom)
+    {
+        encoder->wroteBom = true;
+        switch (encoder->encoding)
+        {
+        case TEXT_ENCODING_UTF8:
+            out[0] = 0xEF, out[1] = 0xBB, out[2] = 0xBF;
+            out += 3;
+            break;
+        case TEXT_ENCODING_UTF16_LE:
+            out[0] = 0xFF, out[1] = 0xFE;
+            out += 2;
+            break;
+        case TEXT_ENCODING_UTF16_BE:
+            out[0] = 0xFE, out[1] = 0xFF;
+            out += 2;
+            break;
+        default:
+            break;
+        }
+    }
+
+    switch (encoder->encoding)
+    {
+    case TEXT_ENCODING_UTF8:
+        memcpy(out, in, size);
+        out += size;
+        break;
+    case TEXT_ENCODING_UTF16_LE:
+    case TEXT_ENCODING_UTF16_BE:
+        out += utf8_to_utf16(in, size, out, encoder->encoding == TEXT_ENCODING_UTF16_BE);
+        break;
+    case TEXT_ENCODING_LATIN1:
+        out += utf8_to_latin1(in, size, out);
+        break;
+    }
+
+    return (u32)(out - outStart);
+}
+
+/**
+ * Converts a chunk of UTF-8 text with LF line endings back to the
+ * encoding and line endings of the file.
+ * @param scratch Needs to hold TEXT_ENCODE_SCRATCH_SIZE(size) bytes
+ * @param out Needs to hold TEXT_ENCODE_OUT_SIZE(size) bytes
+ * @return The amount of bytes written to out
+ */
+u32 text_encoder_encode(TextEncoder *encoder, u8 *in, u32 size, u8 *scratch, u8 *out)
+{
+    // Prepend the incomplete sequence of the last chunk
+    memcpy(scratch, encoder->carry, encoder->carryCount);
+    u32 length = encoder->carryCount;
+    encoder->carryCount = 0;
+
+    if (encoder->lineEnding == LINE_ENDING_CRLF)
+    {
+        length += lf_to_crlf(in, size, scratch + length);
+    }
+    else
+    {
+        memcpy(scratch + length, in, size);
+        length += size;
+    }
+
+    // Hold back a UTF-8 sequence that is cut off by the end of the chunk
+    for (u32 back = 1; back <= 3 && back <= length; back++)
+    {
+        u32 sequenceLength = utf8_sequence_length(scratch[length - back]);
+        if (sequenceLength)
+        {
+            if (sequenceLength > back)
+            {
+                memcpy(encoder->carry, scratch + length - back, back);
+                encoder->carryCount = back;
+                length -= back;
+            }
+            break;
+        }
+    }
+
+    return text_encoder_transcode(encoder, scratch, length, out);
+}
+
+/**
+ * Flushes the incomplete sequence that is left after the last chunk
+ * @param out Needs to hold 16 bytes
+ */
+u32 text_encoder_finish(TextEncoder *encoder, u8 *out)
+{
+    u32 length = text_encoder_transcode(encoder, encoder->carry, encoder->carryCount, out);
+    encoder->carryCount = 0;
+    return length;
+}
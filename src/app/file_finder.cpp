@@ -0,0 +1,503 @@
+#include "defines.h"
+#include "logger.h"
+#include "memory.h"
+#include "platform.h"
+#include "profiler.h"
+
+// SSE2 is part of x64, so we don't need to check for it
+#include <emmintrin.h>
+
+#include <string.h>
+
+u32 constexpr MAX_FINDER_QUERY_LENGTH = 64;
+u32 constexpr MAX_FINDER_RESULTS = 16;
+u32 constexpr MAX_FINDER_JOBS = 128;
+// Small enough that a query on a large tree is split between all workers
+u32 constexpr PATHS_PER_FINDER_JOB = KB(8);
+// The path tables commit memory for this many paths at a time
+u32 constexpr FINDER_PATH_GROW_COUNT = KB(16);
+
+// The job index is packed with the generation of the query, so a queue entry that
+// runs late can't claim a job of the next query
+u32 constexpr FINDER_JOB_INDEX_BITS = 16;
+u32 constexpr FINDER_JOB_INDEX_MASK = (1 << FINDER_JOB_INDEX_BITS) - 1;
+
+// Every path gets a mask of the characters it contains, a path can
+// only match if it contains every character of the query
+u64 constexpr PATH_MASK_IS_FILE = (u64)1 << 63;
+
+struct FinderResult
+{
+    u32 pathIdx;
+    s32 score;
+};
+
+struct FinderJob
+{
+    struct FileFinder *finder;
+    u32 start;
+    u32 end;
+
+    u32 resultCount;
+    FinderResult results[MAX_FINDER_RESULTS];
+};
+
+struct FileFinder
+{
+    char rootFolder[MAX_PATH_LENGTH];
+
+    // Flat arena of null terminated paths, relative to the root folder
+    GameMemory pathMemory;
+
+    // The tables grow inside of their reserved memory, so they never move
+    GameMemory offsetMemory;
+    GameMemory lengthMemory;
+    GameMemory maskMemory;
+    u32 *pathOffsets;
+    u16 *pathLengths;
+    u64 *pathMasks;
+    u32 pathCount;
+    u32 pathCapacity;
+    u32 maxPaths;
+    u32 volatile isReady;
+
+    char query[MAX_FINDER_QUERY_LENGTH + 1];
+    u32 queryLength;
+    u64 queryMask;
+
+    u32 resultCount;
+    FinderResult results[MAX_FINDER_RESULTS];
+
+    FinderJob jobs[MAX_FINDER_JOBS];
+    u32 jobCount;
+    u32 volatile nextJob;
+    u32 volatile jobsPending;
+};
+
+internal u8 to_lower(u8 c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+internal u64 get_char_mask_bit(u8 c)
+{
+    c = to_lower(c);
+
+    u32 bit = 62;
+    if (c >= 'a' && c <= 'z')
+    {
+        bit = c - 'a';
+    }
+    else if (c >= '0' && c <= '9')
+    {
+        bit = 26 + c - '0';
+    }
+    else if (c == '_' || c == '-' || c == '.' || c == '/' || c == ' ')
+    {
+        bit = c == '_' ? 36 : c == '-' ? 37 : c == '.' ? 38 : c == '/' ? 39 : 40;
+    }
+    else if (c >= 0x80)
+    {
+        bit = 41 + (c & 0xF);
+    }
+
+    return (u64)1 << bit;
+}
+
+internal u64 get_path_mask(char *path, u32 length)
+{
+    u64 mask = 0;
+    for (u32 idx = 0; idx < length; idx++)
+    {
+        mask |= get_char_mask_bit((u8)path[idx]);
+    }
+
+    return mask;
+}
+
+char *file_finder_get_path(FileFinder *finder, u32 pathIdx)
+{
+    return (char *)finder->pathMemory.memory + finder->pathOffsets[pathIdx];
+}
+
+// Commits the path tables for the next FINDER_PATH_GROW_COUNT paths
+internal bool file_finder_grow(FileFinder *finder)
+{
+    u32 growCount = finder->maxPaths - finder->pathCapacity;
+    growCount = growCount < FINDER_PATH_GROW_COUNT ? growCount : FINDER_PATH_GROW_COUNT;
+
+    if (!growCount ||
+        !allocate_memory(&finder->offsetMemory, growCount * sizeof(u32), MEMORY_TAG_FILE_FINDER) ||
+        !allocate_memory(&finder->lengthMemory, growCount * sizeof(u16), MEMORY_TAG_FILE_FINDER) ||
+        !allocate_memory(&finder->maskMemory, growCount * sizeof(u64), MEMORY_TAG_FILE_FINDER))
+    {
+        return false;
+    }
+
+    finder->pathCapacity += growCount;
+    return true;
+}
+
+internal bool file_finder_add_path(FileFinder *finder, char *folder, char *name, bool isDirectory)
+{
+    u32 folderLength = folder ? (u32)strlen(folder) : 0;
+    u32 nameLength = (u32)strlen(name);
+    u32 length = folderLength + (folderLength ? 1 : 0) + nameLength;
+
+    if ((finder->pathCount == finder->pathCapacity && !file_finder_grow(finder)) ||
+        finder->pathMemory.allocatedBytes + length + 1 >= finder->pathMemory.memorySizeInBytes)
+    {
+        return false;
+    }
+
+    u32 offset = (u32)finder->pathMemory.allocatedBytes;
+    char *path = (char *)allocate_memory(&finder->pathMemory, length + 1, MEMORY_TAG_FILE_FINDER);
+    if (!path)
+    {
+        return false;
+    }
+
+    if (folderLength)
+    {
+        memcpy(path, folder, folderLength);
+        path[folderLength] = '/';
+    }
+    memcpy(path + length - nameLength, name, nameLength);
+    path[length] = 0;
+
+    u32 pathIdx = finder->pathCount++;
+    finder->pathOffsets[pathIdx] = offset;
+    finder->pathLengths[pathIdx] = (u16)length;
+    finder->pathMasks[pathIdx] = get_path_mask(path, length) | (isDirectory ? 0 : PATH_MASK_IS_FILE);
+
+    return true;
+}
+
+/**
+ * Enumerates every file below rootFolder once, folders are visited
+ * breadth first because only one folder can be iterated at a time.
+ * Hidden folders, like .git, are skipped.
+ */
+internal void file_finder_enumerate(FileFinder *finder, char *rootFolder)
+{
+    char fileName[MAX_PATH_LENGTH];
+    char folder[MAX_PATH_LENGTH];
+    bool isFull = false;
+
+    // Entries get appended while we walk them, folders are expanded when we reach them
+    for (s32 entryIdx = -1; entryIdx < (s32)finder->pathCount && !isFull; entryIdx++)
+    {
+        char *relativeFolder = 0;
+        if (entryIdx >= 0)
+        {
+            if (finder->pathMasks[entryIdx] & PATH_MASK_IS_FILE)
+            {
+                continue;
+            }
+
+            relativeFolder = file_finder_get_path(finder, entryIdx);
+            snprintf(folder, MAX_PATH_LENGTH, "%s/%s", rootFolder, relativeFolder);
+        }
+        else
+        {
+            snprintf(folder, MAX_PATH_LENGTH, "%s", rootFolder);
+        }
+
+        for (bool found = platform_get_first_filename(fileName, folder); found;
+             found = platform_get_next_filename(fileName, folder))
+        {
+            u32 nameLength = (u32)strlen(fileName);
+            bool isDirectory = nameLength && fileName[nameLength - 1] == '/';
+            if (isDirectory)
+            {
+                if (fileName[0] == '.')
+                {
+                    continue;
+                }
+                fileName[nameLength - 1] = 0;
+            }
+
+            if (!file_finder_add_path(finder, relativeFolder, fileName, isDirectory))
+            {
+                CAKEZ_WARN("File Finder is full, stopped at %u paths", finder->pathCount);
+                isFull = true;
+                break;
+            }
+        }
+    }
+}
+
+internal void file_finder_build_work(WorkQueue *queue, void *data)
+{
+    MEASURE_FUNCTION();
+    FileFinder *finder = (FileFinder *)data;
+    file_finder_enumerate(finder, finder->rootFolder);
+    platform_atomic_exchange(&finder->isReady, true);
+}
+
+/**
+ * Enumerates rootFolder on a worker thread, queries return
+ * no results until that is done. Only address space is reserved
+ * up front, the paths commit memory as they are found.
+ * @param maxPaths Paths the File Finder can grow to
+ * @param maxPathBytes Address space reserved for the paths themselves
+ */
+bool file_finder_init(FileFinder *finder, WorkQueue *queue,
+                      char *rootFolder, u32 maxPaths, u64 maxPathBytes)
+{
+    *finder = {};
+    finder->maxPaths = maxPaths;
+
+    // allocate_memory needs a byte to spare, so the last path fits too
+    if (!init_reserved_memory(&finder->offsetMemory, (u64)maxPaths * sizeof(u32) + 1) ||
+        !init_reserved_memory(&finder->lengthMemory, (u64)maxPaths * sizeof(u16) + 1) ||
+        !init_reserved_memory(&finder->maskMemory, (u64)maxPaths * sizeof(u64) + 1) ||
+        !init_reserved_memory(&finder->pathMemory, maxPathBytes))
+    {
+        return false;
+    }
+    finder->pathOffsets = (u32 *)finder->offsetMemory.memory;
+    finder->pathLengths = (u16 *)finder->lengthMemory.memory;
+    finder->pathMasks = (u64 *)finder->maskMemory.memory;
+
+    snprintf(finder->rootFolder, MAX_PATH_LENGTH, "%s", rootFolder);
+    platform_add_work_entry(queue, file_finder_build_work, finder);
+
+    return true;
+}
+
+/**
+ * Enumerates the root folder again, queries return no
+ * results until that is done.
+ * @return false if an enumeration is still running
+ */
+bool file_finder_rebuild(FileFinder *finder, WorkQueue *queue)
+{
+    if (!finder->isReady)
+    {
+        return false;
+    }
+
+    platform_atomic_exchange(&finder->isReady, false);
+    finder->pathCount = 0;
+    reset_memory(&finder->pathMemory);
+    finder->resultCount = 0;
+    platform_add_work_entry(queue, file_finder_build_work, finder);
+
+    return true;
+}
+
+internal bool is_path_separator(u8 c)
+{
+    return c == '/' || c == '_' || c == '-' || c == '.' || c == ' ';
+}
+
+/**
+ * Greedy subsequence match of the query in path[start, length),
+ * matches at the start of words and runs of matches score higher.
+ * @return The score, INT32_MIN if the query is not a subsequence
+ */
+internal s32 score_path_range(char *path, u32 start, u32 length, char *query, u32 queryLength)
+{
+    s32 score = 0;
+    u32 lastMatch = INVALID_IDX;
+    u32 at = start;
+
+    for (u32 queryIdx = 0; queryIdx < queryLength; queryIdx++)
+    {
+        u8 q = to_lower((u8)query[queryIdx]);
+        while (at < length && to_lower((u8)path[at]) != q)
+        {
+            at++;
+        }
+
+        if (at == length)
+        {
+            return INT32_MIN;
+        }
+
+        u8 prev = at > 0 ? (u8)path[at - 1] : '/';
+        bool isWordStart = is_path_separator(prev) ||
+                           (prev >= 'a' && prev <= 'z' && path[at] >= 'A' && path[at] <= 'Z');
+
+        score += 16;
+        score += isWordStart ? 24 : 0;
+        score += lastMatch != INVALID_IDX && lastMatch + 1 == at ? 32 : 0;
+        score -= lastMatch != INVALID_IDX ? (s32)(at - lastMatch - 1) : (s32)(at - start);
+
+        lastMatch = at++;
+    }
+
+    return score;
+}
+
+internal s32 score_path(char *path, u32 length, char *query, u32 queryLength)
+{
+    u32 nameStart = length;
+    while (nameStart > 0 && path[nameStart - 1] != '/')
+    {
+        nameStart--;
+    }
+
+    // Matches inside the file name are worth more than matches in the folders
+    s32 score = score_path_range(path, nameStart, length, query, queryLength);
+    if (score != INT32_MIN)
+    {
+        score += 256;
+    }
+    else
+    {
+        score = score_path_range(path, 0, length, query, queryLength);
+    }
+
+    // Prefer short paths on equal matches
+    return score != INT32_MIN ? score - (s32)(length / 8) : score;
+}
+
+internal void insert_finder_result(FinderResult *results, u32 *resultCount, FinderResult result)
+{
+    if (*resultCount == MAX_FINDER_RESULTS && results[MAX_FINDER_RESULTS - 1].score >= result.score)
+    {
+        return;
+    }
+
+    u32 insertIdx = *resultCount < MAX_FINDER_RESULTS ? (*resultCount)++ : MAX_FINDER_RESULTS - 1;
+    while (insertIdx > 0 && results[insertIdx - 1].score < result.score)
+    {
+        results[insertIdx] = results[insertIdx - 1];
+        insertIdx--;
+    }
+    results[insertIdx] = result;
+}
+
+internal void file_finder_run_job(FinderJob *job)
+{
+    MEASURE_FUNCTION();
+    FileFinder *finder = job->finder;
+    job->resultCount = 0;
+
+    // Prefilter two masks at a time, the query mask always has PATH_MASK_IS_FILE set
+    __m128i queryMask = _mm_set1_epi64x((s64)finder->queryMask);
+    u32 pathIdx = job->start;
+    for (; pathIdx < job->end; pathIdx += 2)
+    {
+        u32 matches;
+        if (pathIdx + 1 < job->end)
+        {
+            __m128i masks = _mm_loadu_si128((__m128i *)(finder->pathMasks + pathIdx));
+            __m128i hasAll = _mm_cmpeq_epi32(_mm_and_si128(masks, queryMask), queryMask);
+            u32 byteMask = _mm_movemask_epi8(hasAll);
+            matches = ((byteMask & 0xFF) == 0xFF ? 1 : 0) | ((byteMask >> 8) == 0xFF ? 2 : 0);
+        }
+        else
+        {
+            matches = (finder->pathMasks[pathIdx] & finder->queryMask) == finder->queryMask ? 1 : 0;
+        }
+
+        for (u32 lane = 0; lane < 2; lane++)
+        {
+            if (matches & (1 << lane))
+            {
+                u32 candidateIdx = pathIdx + lane;
+                s32 score = score_path(file_finder_get_path(finder, candidateIdx),
+                                       finder->pathLengths[candidateIdx],
+                                       finder->query, finder->queryLength);
+                if (score != INT32_MIN)
+                {
+                    insert_finder_result(job->results, &job->resultCount, {candidateIdx, score});
+                }
+            }
+        }
+    }
+}
+
+// Runs jobs of the current query until all of them are claimed
+internal void file_finder_run_jobs(FileFinder *finder)
+{
+    while (true)
+    {
+        u32 nextJob = finder->nextJob;
+        u32 jobIdx = nextJob & FINDER_JOB_INDEX_MASK;
+        if (jobIdx >= finder->jobCount)
+        {
+            break;
+        }
+
+        if (platform_atomic_compare_exchange(&finder->nextJob, nextJob + 1, nextJob) == nextJob)
+        {
+            file_finder_run_job(&finder->jobs[jobIdx]);
+            platform_atomic_add(&finder->jobsPending, (u32)-1);
+        }
+    }
+}
+
+internal void file_finder_query_work(WorkQueue *queue, void *data)
+{
+    file_finder_run_jobs((FileFinder *)data);
+}
+
+/**
+ * Scores every path against query in parallel chunks, the best
+ * results end up in finder->results. The calling thread works on the
+ * chunks too, it only waits for the chunks of this query and not
+ * for other entries of the queue.
+ */
+void file_finder_query(FileFinder *finder, WorkQueue *queue, char *query, u32 queryLength)
+{
+    finder->resultCount = 0;
+    if (!finder->isReady || !queryLength)
+    {
+        return;
+    }
+
+    queryLength = queryLength > MAX_FINDER_QUERY_LENGTH ? MAX_FINDER_QUERY_LENGTH : queryLength;
+    memcpy(finder->query, query, queryLength);
+    finder->query[queryLength] = 0;
+    finder->queryLength = queryLength;
+    finder->queryMask = get_path_mask(query, queryLength) | PATH_MASK_IS_FILE;
+
+    u32 jobCount = (finder->pathCount + PATHS_PER_FINDER_JOB - 1) / PATHS_PER_FINDER_JOB;
+    jobCount = jobCount > MAX_FINDER_JOBS ? MAX_FINDER_JOBS : jobCount;
+    u32 pathsPerJob = jobCount ? (finder->pathCount + jobCount - 1) / jobCount : 0;
+
+    for (u32 jobIdx = 0; jobIdx < jobCount; jobIdx++)
+    {
+        FinderJob *job = &finder->jobs[jobIdx];
+        job->finder = finder;
+        job->start = jobIdx * pathsPerJob;
+        job->end = job->start + pathsPerJob > finder->pathCount ? finder->pathCount : job->start + pathsPerJob;
+    }
+    finder->jobCount = jobCount;
+    finder->jobsPending = jobCount;
+
+    // Opens the jobs of the new generation
+    u32 generation = (finder->nextJob >> FINDER_JOB_INDEX_BITS) + 1;
+    platform_atomic_exchange(&finder->nextJob, generation << FINDER_JOB_INDEX_BITS);
+
+    // Entries that get picked up late find nothing left to claim
+    u32 threadCount = platform_get_thread_count();
+    u32 helperCount = jobCount < threadCount ? jobCount : threadCount;
+    helperCount = helperCount ? helperCount - 1 : 0;
+    for (u32 helperIdx = 0; helperIdx < helperCount; helperIdx++)
+    {
+        platform_add_work_entry(queue, file_finder_query_work, finder);
+    }
+
+    file_finder_run_jobs(finder);
+    while (finder->jobsPending)
+    {
+        platform_yield_thread();
+    }
+
+    // Closes the jobs, a late entry can't claim one while the next query sets them up
+    platform_atomic_exchange(&finder->nextJob, (generation << FINDER_JOB_INDEX_BITS) | FINDER_JOB_INDEX_MASK);
+
+    for (u32 jobIdx = 0; jobIdx < jobCount; jobIdx++)
+    {
+        FinderJob *job = &finder->jobs[jobIdx];
+        for (u32 resultIdx = 0; resultIdx < job->resultCount; resultIdx++)
+        {
+            insert_finder_result(finder->results, &finder->resultCount, job->results[resultIdx]);
+        }
+    }
+}
@@ -0,0 +1,325 @@
+#include "defines.h"
+#include "input.h"
+#include "logger.h"
+#include "platform.h"
+
+#include <string.h>
+
+u32 constexpr INPUT_RECORDING_MAGIC = 'C' | ('R' << 8) | ('E' << 16) | ('C' << 24);
+u32 constexpr INPUT_RECORDING_VERSION = 1;
+u32 constexpr INPUT_RECORDING_BUFFER_SIZE = KB(64);
+
+// Type, modifiers, key and a pad byte, followed by a payload depending on the type
+u32 constexpr RECORDED_EVENT_HEADER_SIZE = 4;
+u32 constexpr MAX_RECORDED_EVENT_SIZE = RECORDED_EVENT_HEADER_SIZE + sizeof(s32) + sizeof(Vec2);
+
+// Event count followed by the events, a frame always fits into the buffer
+u32 constexpr MAX_RECORDED_FRAME_SIZE = sizeof(u16) + MAX_INPUT_EVENTS * MAX_RECORDED_EVENT_SIZE;
+
+// Frame times of the replay are counted in microsecond buckets, slower frames land in the last one
+u32 constexpr REPLAY_HISTOGRAM_BUCKETS = 65536;
+
+/*
+ * File Layout:
+ * u32 magic, u32 version
+ * Frame[] until the end of the file, only frames that had input are recorded:
+ *   u16 eventCount
+ *   Event[eventCount]
+ *
+ * Timestamps are not recorded, a replay runs as fast as possible and every
+ * recorded frame is one call to update_app.
+ */
+
+struct InputRecorder
+{
+    char path[MAX_PATH_LENGTH];
+    u32 frameCount;
+    u32 eventCount;
+
+    u32 bufferLength;
+    u8 buffer[INPUT_RECORDING_BUFFER_SIZE];
+};
+
+struct InputReplay
+{
+    char path[MAX_PATH_LENGTH];
+    u64 fileSize;
+    u64 fileOffset;
+
+    u32 bufferOffset;
+    u32 bufferLength;
+    u8 buffer[INPUT_RECORDING_BUFFER_SIZE];
+};
+
+internal u32 get_recorded_payload_size(u8 type)
+{
+    switch (type)
+    {
+    case INPUT_EVENT_CHAR:
+        return sizeof(u32);
+
+    case INPUT_EVENT_MOUSE_MOVE:
+    case INPUT_EVENT_MOUSE_BUTTON_DOWN:
+    case INPUT_EVENT_MOUSE_BUTTON_UP:
+        return sizeof(Vec2);
+
+    case INPUT_EVENT_MOUSE_WHEEL:
+        return sizeof(s32) + sizeof(Vec2);
+
+    default:
+        return 0;
+    }
+}
+
+internal bool input_recorder_flush(InputRecorder *recorder)
+{
+    u32 length = recorder->bufferLength;
+    recorder->bufferLength = 0;
+
+    if (platform_write_file(recorder->path, (char *)recorder->buffer, length, false) != length)
+    {
+        CAKEZ_WARN("Failed to write the Input Recording to %s", recorder->path);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Starts a new recording, an existing file at path is overwritten.
+ * @return false if the file could not be written
+ */
+bool input_recorder_begin(InputRecorder *recorder, char *path)
+{
+    if (strlen(path) >= MAX_PATH_LENGTH)
+    {
+        CAKEZ_WARN("Path of the Input Recording is too long: %s", path);
+        return false;
+    }
+
+    strcpy(recorder->path, path);
+    recorder->frameCount = 0;
+    recorder->eventCount = 0;
+    recorder->bufferLength = 0;
+
+    u32 header[2] = {INPUT_RECORDING_MAGIC, INPUT_RECORDING_VERSION};
+    if (platform_write_file(path, (char *)header, sizeof(header), true) != sizeof(header))
+    {
+        CAKEZ_WARN("Failed to create the Input Recording %s", path);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Records the events that wait in the queue as one frame, without taking
+ * them out. Call it right before update_app.
+ */
+void input_recorder_capture(InputRecorder *recorder, InputState *input)
+{
+    u32 readIdx = input->eventReadIdx;
+    u32 eventCount = input->eventWriteIdx - readIdx;
+    if (!eventCount)
+    {
+        return;
+    }
+
+    if (recorder->bufferLength + MAX_RECORDED_FRAME_SIZE > INPUT_RECORDING_BUFFER_SIZE)
+    {
+        input_recorder_flush(recorder);
+    }
+
+    u8 *at = recorder->buffer + recorder->bufferLength;
+    u16 frameEventCount = (u16)eventCount;
+    memcpy(at, &frameEventCount, sizeof(u16));
+    at += sizeof(u16);
+
+    for (u32 eventIdx = 0; eventIdx < eventCount; eventIdx++)
+    {
+        InputEvent *event = &input->events[(readIdx + eventIdx) % MAX_INPUT_EVENTS];
+        at[0] = event->type;
+        at[1] = event->modifiers;
+        at[2] = event->key;
+        at[3] = 0;
+        at += RECORDED_EVENT_HEADER_SIZE;
+
+        if (event->type == INPUT_EVENT_CHAR)
+        {
+            memcpy(at, &event->codepoint, sizeof(u32));
+            at += sizeof(u32);
+        }
+        else if (event->type == INPUT_EVENT_MOUSE_WHEEL)
+        {
+            memcpy(at, &event->wheelDelta, sizeof(s32));
+            at += sizeof(s32);
+        }
+
+        if (get_recorded_payload_size(event->type) >= sizeof(Vec2))
+        {
+            memcpy(at, &event->mousePos, sizeof(Vec2));
+            at += sizeof(Vec2);
+        }
+    }
+
+    recorder->bufferLength = (u32)(at - recorder->buffer);
+    recorder->frameCount++;
+    recorder->eventCount += eventCount;
+}
+
+void input_recorder_end(InputRecorder *recorder)
+{
+    if (input_recorder_flush(recorder))
+    {
+        CAKEZ_TRACE("Recorded %u Input Events in %u Frames to %s",
+                    recorder->eventCount, recorder->frameCount, recorder->path);
+    }
+}
+
+/**
+ * @return false if the file doesn't exist or is not an Input Recording
+ */
+bool input_replay_open(InputReplay *replay, char *path)
+{
+    if (strlen(path) >= MAX_PATH_LENGTH)
+    {
+        CAKEZ_WARN("Path of the Input Recording is too long: %s", path);
+        return false;
+    }
+
+    strcpy(replay->path, path);
+    replay->fileSize = platform_get_file_size(path);
+    replay->fileOffset = 0;
+    replay->bufferOffset = 0;
+    replay->bufferLength = 0;
+
+    u32 header[2] = {};
+    if (platform_read_file_chunk(path, 0, (char *)header, sizeof(header)) != sizeof(header) ||
+        header[0] != INPUT_RECORDING_MAGIC || header[1] != INPUT_RECORDING_VERSION)
+    {
+        CAKEZ_WARN("%s is not an Input Recording", path);
+        return false;
+    }
+
+    replay->fileOffset = sizeof(header);
+    return true;
+}
+
+/**
+ * Pushes the events of the next recorded frame into the queue, with
+ * the current time as their timestamp.
+ * @return false once all frames were replayed
+ */
+bool input_replay_next_frame(InputReplay *replay, InputState *input)
+{
+    // Keep a whole frame in the buffer
+    u32 remaining = replay->bufferLength - replay->bufferOffset;
+    if (remaining < MAX_RECORDED_FRAME_SIZE && replay->fileOffset < replay->fileSize)
+    {
+        memmove(replay->buffer, replay->buffer + replay->bufferOffset, remaining);
+        u32 bytesRead = platform_read_file_chunk(replay->path, replay->fileOffset,
+                                                 (char *)replay->buffer + remaining,
+                                                 INPUT_RECORDING_BUFFER_SIZE - remaining);
+        replay->fileOffset += bytesRead;
+        replay->bufferOffset = 0;
+        replay->bufferLength = remaining + bytesRead;
+        remaining += bytesRead;
+    }
+
+    if (remaining < sizeof(u16))
+    {
+        return false;
+    }
+
+    u8 *at = replay->buffer + replay->bufferOffset;
+    u8 *end = replay->buffer + replay->bufferLength;
+    u16 eventCount;
+    memcpy(&eventCount, at, sizeof(u16));
+    at += sizeof(u16);
+
+    u64 timestamp = platform_get_performance_tick_count();
+    for (u32 eventIdx = 0; eventIdx < eventCount; eventIdx++)
+    {
+        if (end - at < RECORDED_EVENT_HEADER_SIZE ||
+            (u32)(end - at) < RECORDED_EVENT_HEADER_SIZE + get_recorded_payload_size(at[0]))
+        {
+            CAKEZ_WARN("Input Recording %s is truncated", replay->path);
+            replay->bufferOffset = replay->bufferLength;
+            return false;
+        }
+
+        InputEvent event = {};
+        event.timestamp = timestamp;
+        event.type = (InputEventType)at[0];
+        event.modifiers = at[1];
+        event.key = at[2];
+        at += RECORDED_EVENT_HEADER_SIZE;
+
+        if (event.type == INPUT_EVENT_CHAR)
+        {
+            memcpy(&event.codepoint, at, sizeof(u32));
+            at += sizeof(u32);
+        }
+        else if (event.type == INPUT_EVENT_MOUSE_WHEEL)
+        {
+            memcpy(&event.wheelDelta, at, sizeof(s32));
+            at += sizeof(s32);
+        }
+
+        if (get_recorded_payload_size(event.type) >= sizeof(Vec2))
+        {
+            memcpy(&event.mousePos, at, sizeof(Vec2));
+            at += sizeof(Vec2);
+            input->mousePos = event.mousePos;
+        }
+
+        input_push_event(input, &event);
+    }
+
+    replay->bufferOffset = (u32)(at - replay->buffer);
+    return true;
+}
+
+internal u32 get_histogram_percentile(u32 *histogram, u32 count, u32 percentile)
+{
+    u32 rank = (count - 1) * percentile / 100;
+    u32 seen = 0;
+    for (u32 bucket = 0; bucket < REPLAY_HISTOGRAM_BUCKETS; bucket++)
+    {
+        seen += histogram[bucket];
+        if (seen > rank)
+        {
+            return bucket;
+        }
+    }
+
+    return REPLAY_HISTOGRAM_BUCKETS - 1;
+}
+
+/**
+ * Logs the distribution of the frame times of a replay.
+ * @param histogram Frame count per microsecond, REPLAY_HISTOGRAM_BUCKETS entries
+ */
+void input_replay_report(u32 *histogram, u32 frameCount, u64 totalMicroseconds)
+{
+    if (!frameCount)
+    {
+        CAKEZ_TRACE("Replay: no frames");
+        return;
+    }
+
+    u32 minMicroseconds = 0;
+    while (!histogram[minMicroseconds])
+    {
+        minMicroseconds++;
+    }
+
+    CAKEZ_TRACE("Replay of %u Frames took %.2f ms, %.2f us per Frame", frameCount,
+                totalMicroseconds / 1000.0f, (float)totalMicroseconds / frameCount);
+    CAKEZ_TRACE("  Frame Time in us (min / p50 / p90 / p99 / max): %u / %u / %u / %u / %u",
+                minMicroseconds,
+                get_histogram_percentile(histogram, frameCount, 50),
+                get_histogram_percentile(histogram, frameCount, 90),
+                get_histogram_percentile(histogram, frameCount, 99),
+                get_histogram_percentile(histogram, frameCount, 100));
+}
@@ -0,0 +1,386 @@
+#include "defines.h"
+#include "input.h"
+#include "logger.h"
+
+#include <string.h>
+
+#define COMMAND_LIST(COMMAND)              \
+    COMMAND(COMMAND_NONE)                  \
+    COMMAND(COMMAND_TOGGLE_FILE_PALETTE)   \
+    COMMAND(COMMAND_GOTO_DEFINITION)       \
+    COMMAND(COMMAND_SAVE_FILE)             \
+    COMMAND(COMMAND_SORT_LINES)            \
+    COMMAND(COMMAND_UNIQUE_LINES)          \
+    COMMAND(COMMAND_REVERSE_LINES)         \
+    COMMAND(COMMAND_REPORT_LATENCY)        \
+    COMMAND(COMMAND_TOGGLE_MEMORY_OVERLAY) \
+    COMMAND(COMMAND_DUMP_MEMORY_REPORT)    \
+    COMMAND(COMMAND_TOGGLE_TRACE_CAPTURE)  \
+    COMMAND(COMMAND_TOGGLE_PERF_HUD)
+
+enum Command : u16
+{
+    COMMAND_LIST(GENERATE_ENUM)
+    COMMAND_COUNT
+};
+
+global_variable char *commandNames[] = {COMMAND_LIST(GENERATE_STRING)};
+
+// A Stroke is one key together with its modifiers, every Node of the
+// Chord Trie is a dense table over all Strokes
+u32 constexpr KEY_STROKE_COUNT = 8 << 8;
+u32 constexpr MAX_KEY_BINDING_NODES = 16;
+u32 constexpr MAX_KEYS_PER_CHORD = 4;
+u32 constexpr ROOT_KEY_BINDING_NODE = 0;
+
+// Entries with this bit point to the next Node of a Chord, all others are Commands
+u16 constexpr KEY_BINDING_NODE_BIT = 0x8000;
+
+// Used when there is no config file, the config file can override all of them
+global_variable char *defaultKeyBindings =
+    "ctrl+p = toggle_file_palette\n"
+    "f12 = goto_definition\n"
+    "ctrl+s = save_file\n"
+    "ctrl+k ctrl+s = sort_lines\n"
+    "ctrl+k ctrl+u = unique_lines\n"
+    "ctrl+k ctrl+r = reverse_lines\n"
+    "ctrl+k ctrl+l = report_latency\n"
+    "ctrl+k ctrl+m = toggle_memory_overlay\n"
+    "ctrl+k ctrl+d = dump_memory_report\n"
+    "ctrl+k ctrl+t = toggle_trace_capture\n"
+    "ctrl+k ctrl+p = toggle_perf_hud\n";
+
+struct KeyBindings
+{
+    u16 nodes[MAX_KEY_BINDING_NODES][KEY_STROKE_COUNT];
+    u32 nodeCount;
+
+    // Node of the Chord that is being typed
+    u32 currentNode;
+};
+
+struct KeyName
+{
+    char *name;
+    u8 key;
+};
+
+// Windows Virtual Key codes, letters and digits use their ASCII value
+global_variable KeyName keyNames[] =
+    {
+        {"backspace", 0x08},
+        {"tab", 0x09},
+        {"enter", 0x0D},
+        {"escape", 0x1B},
+        {"space", 0x20},
+        {"pageup", 0x21},
+        {"pagedown", 0x22},
+        {"end", 0x23},
+        {"home", 0x24},
+        {"left", 0x25},
+        {"up", 0x26},
+        {"right", 0x27},
+        {"down", 0x28},
+        {"insert", 0x2D},
+        {"delete", 0x2E},
+};
+
+internal u32 get_key_stroke(u8 key, u8 modifiers)
+{
+    return ((modifiers & 0x7) << 8) | key;
+}
+
+internal bool is_modifier_key(u8 key)
+{
+    // Shift, Control, Alt and their left/right versions
+    return (key >= 0x10 && key <= 0x12) || (key >= 0xA0 && key <= 0xA5);
+}
+
+internal bool token_equals_ignore_case(char *token, u32 length, char *name)
+{
+    u32 nameLength = (u32)strlen(name);
+    if (nameLength != length)
+    {
+        return false;
+    }
+
+    for (u32 idx = 0; idx < length; idx++)
+    {
+        char c = token[idx];
+        c = c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+        if (c != name[idx])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Parses a single Stroke like "ctrl+shift+k" or "f12".
+ * @return false if the Stroke is not valid
+ */
+internal bool parse_key_stroke(char *token, u32 length, u32 *stroke)
+{
+    u8 modifiers = 0;
+    for (;;)
+    {
+        u32 partLength = 0;
+        while (partLength < length && token[partLength] != '+')
+        {
+            partLength++;
+        }
+
+        // The last part is the key
+        if (partLength == length)
+        {
+            break;
+        }
+
+        if (token_equals_ignore_case(token, partLength, "ctrl"))
+        {
+            modifiers |= INPUT_MODIFIER_CONTROL;
+        }
+        else if (token_equals_ignore_case(token, partLength, "shift"))
+        {
+            modifiers |= INPUT_MODIFIER_SHIFT;
+        }
+        else if (token_equals_ignore_case(token, partLength, "alt"))
+        {
+            modifiers |= INPUT_MODIFIER_ALT;
+        }
+        else
+        {
+            return false;
+        }
+
+        token += partLength + 1;
+        length -= partLength + 1;
+    }
+
+    s32 key = -1;
+    if (length == 1)
+    {
+        char c = token[0];
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+        {
+            key = c >= 'a' && c <= 'z' ? c - ('a' - 'A') : c;
+        }
+    }
+    else if ((token[0] == 'f' || token[0] == 'F') && length <= 3)
+    {
+        // F1 - F24
+        u32 number = 0;
+        for (u32 idx = 1; idx < length; idx++)
+        {
+            number = token[idx] >= '0' && token[idx] <= '9' ? number * 10 + token[idx] - '0' : 0;
+        }
+
+        if (number >= 1 && number <= 24)
+        {
+            key = 0x70 + number - 1;
+        }
+    }
+
+    for (u32 nameIdx = 0; key < 0 && nameIdx < ArraySize(keyNames); nameIdx++)
+    {
+        if (token_equals_ignore_case(token, length, keyNames[nameIdx].name))
+        {
+            key = keyNames[nameIdx].key;
+        }
+    }
+
+    if (key < 0)
+    {
+        return false;
+    }
+
+    *stroke = get_key_stroke((u8)key, modifiers);
+    return true;
+}
+
+internal Command parse_command(char *token, u32 length)
+{
+    // Names are the enum without "COMMAND_", in any case
+    u32 prefixLength = sizeof("COMMAND_") - 1;
+    for (u32 commandIdx = 1; commandIdx < COMMAND_COUNT; commandIdx++)
+    {
+        char *name = commandNames[commandIdx] + prefixLength;
+        if (strlen(name) != length)
+        {
+            continue;
+        }
+
+        bool isMatch = true;
+        for (u32 idx = 0; idx < length && isMatch; idx++)
+        {
+            char c = token[idx];
+            c = c >= 'a' && c <= 'z' ? c - ('a' - 'A') : c;
+            isMatch = c == name[idx];
+        }
+
+        if (isMatch)
+        {
+            return (Command)commandIdx;
+        }
+    }
+
+    return COMMAND_NONE;
+}
+
+internal bool keybindings_add(KeyBindings *bindings, u32 *strokes, u32 strokeCount, Command command)
+{
+    u32 node = ROOT_KEY_BINDING_NODE;
+    for (u32 strokeIdx = 0; strokeIdx + 1 < strokeCount; strokeIdx++)
+    {
+        u16 *entry = &bindings->nodes[node][strokes[strokeIdx]];
+        if (!(*entry & KEY_BINDING_NODE_BIT))
+        {
+            if (bindings->nodeCount == MAX_KEY_BINDING_NODES)
+            {
+                CAKEZ_WARN("Too many Chords, only %u Nodes are supported", MAX_KEY_BINDING_NODES);
+                return false;
+            }
+
+            // A Chord prefix replaces a Command bound to the same Stroke
+            u32 newNode = bindings->nodeCount++;
+            memset(bindings->nodes[newNode], 0, sizeof(bindings->nodes[newNode]));
+            *entry = (u16)(KEY_BINDING_NODE_BIT | newNode);
+        }
+
+        node = *entry & ~KEY_BINDING_NODE_BIT;
+    }
+
+    u16 *entry = &bindings->nodes[node][strokes[strokeCount - 1]];
+    if (*entry & KEY_BINDING_NODE_BIT)
+    {
+        return false;
+    }
+
+    *entry = command;
+    return true;
+}
+
+/**
+ * Adds the bindings in text, one per line:
+ * ctrl+k ctrl+s = sort_lines
+ * Lines starting with # are comments, binding a Stroke to none removes it.
+ */
+void keybindings_parse(KeyBindings *bindings, char *text, u32 length)
+{
+    u32 lineNumber = 0;
+    for (u32 lineStart = 0; lineStart < length;)
+    {
+        u32 lineEnd = lineStart;
+        while (lineEnd < length && text[lineEnd] != '\n')
+        {
+            lineEnd++;
+        }
+        lineNumber++;
+
+        char *line = text + lineStart;
+        u32 lineLength = lineEnd - lineStart;
+        lineStart = lineEnd + 1;
+
+        u32 strokes[MAX_KEYS_PER_CHORD];
+        u32 strokeCount = 0;
+        bool isValid = true;
+        Command command = COMMAND_NONE;
+        bool hasCommand = false;
+
+        for (u32 at = 0; at < lineLength && isValid;)
+        {
+            char c = line[at];
+            if (c == ' ' || c == '\t' || c == '\r')
+            {
+                at++;
+                continue;
+            }
+
+            if (c == '#' && !strokeCount)
+            {
+                break;
+            }
+
+            u32 tokenStart = at;
+            while (at < lineLength && line[at] != ' ' && line[at] != '\t' && line[at] != '\r' && line[at] != '=')
+            {
+                at++;
+            }
+
+            if (c == '=')
+            {
+                // The rest of the line is the Command
+                at++;
+                while (at < lineLength && (line[at] == ' ' || line[at] == '\t'))
+                {
+                    at++;
+                }
+
+                u32 commandEnd = at;
+                while (commandEnd < lineLength && line[commandEnd] != ' ' && line[commandEnd] != '\t' && line[commandEnd] != '\r')
+                {
+                    commandEnd++;
+                }
+
+                command = parse_command(line + at, commandEnd - at);
+                isValid = command != COMMAND_NONE || token_equals_ignore_case(line + at, commandEnd - at, "none");
+                hasCommand = true;
+                break;
+            }
+
+            isValid = strokeCount < MAX_KEYS_PER_CHORD &&
+                      parse_key_stroke(line + tokenStart, at - tokenStart, &strokes[strokeCount++]);
+        }
+
+        if (!isValid || (strokeCount && !hasCommand))
+        {
+            CAKEZ_WARN("Invalid Key Binding in line %u: %.*s", lineNumber, lineLength, line);
+        }
+        else if (strokeCount && !keybindings_add(bindings, strokes, strokeCount, command))
+        {
+            CAKEZ_WARN("Key Binding in line %u conflicts with a Chord: %.*s", lineNumber, lineLength, line);
+        }
+    }
+}
+
+void keybindings_init(KeyBindings *bindings)
+{
+    memset(bindings->nodes[ROOT_KEY_BINDING_NODE], 0, sizeof(bindings->nodes[ROOT_KEY_BINDING_NODE]));
+    bindings->nodeCount = 1;
+    bindings->currentNode = ROOT_KEY_BINDING_NODE;
+
+    keybindings_parse(bindings, defaultKeyBindings, (u32)strlen(defaultKeyBindings));
+}
+
+/**
+ * Advances the Chord that is being typed by one key, a single table
+ * lookup per key.
+ * @param consumed Set to true if the key was part of a binding, the text input
+ * of the key should be ignored then
+ * @return The Command to run or COMMAND_NONE
+ */
+Command keybindings_dispatch(KeyBindings *bindings, u8 key, u8 modifiers, bool *consumed)
+{
+    *consumed = false;
+    if (is_modifier_key(key))
+    {
+        return COMMAND_NONE;
+    }
+
+    bool isInChord = bindings->currentNode != ROOT_KEY_BINDING_NODE;
+    u16 entry = bindings->nodes[bindings->currentNode][get_key_stroke(key, modifiers)];
+    bindings->currentNode = ROOT_KEY_BINDING_NODE;
+
+    if (entry & KEY_BINDING_NODE_BIT)
+    {
+        bindings->currentNode = entry & ~KEY_BINDING_NODE_BIT;
+        *consumed = true;
+        return COMMAND_NONE;
+    }
+
+    // Keys that don't finish a Chord are swallowed, like in most editors
+    *consumed = entry != COMMAND_NONE || isInChord;
+    return (Command)entry;
+}
@@ -0,0 +1,131 @@
+#include "defines.h"
+#include "logger.h"
+#include "platform.h"
+
+#include <string.h>
+
+u32 constexpr MAX_LATENCY_SAMPLES = 1024;
+u32 constexpr MAX_PENDING_KEYSTROKES = 64;
+
+// Points a keystroke passes on its way to the screen, in order
+enum LatencyStage
+{
+    LATENCY_STAGE_UPDATE,
+    LATENCY_STAGE_INSTANCES,
+    LATENCY_STAGE_SUBMIT,
+    LATENCY_STAGE_PRESENT,
+
+    LATENCY_STAGE_COUNT
+};
+
+global_variable char *latencyStageNames[LATENCY_STAGE_COUNT] =
+    {
+        "update_app",
+        "instances",
+        "queue submit",
+        "present",
+};
+
+struct LatencyTracker
+{
+    // Keystrokes handled since the last present, tagged with the tick count of the input event
+    u32 pendingCount;
+    u64 pendingInputTicks[MAX_PENDING_KEYSTROKES];
+    u64 stageTicks[LATENCY_STAGE_COUNT];
+
+    // Ring of the last samples, in microseconds from the input event
+    u32 sampleCount;
+    u32 nextSample;
+    u32 samples[LATENCY_STAGE_COUNT][MAX_LATENCY_SAMPLES];
+};
+
+/**
+ * Tags a keystroke that changed what is on screen, it gets a
+ * sample once the frame showing it is presented.
+ */
+void latency_add_keystroke(LatencyTracker *tracker, u64 inputTicks)
+{
+    // Typing faster than one frame per 64 keys is not something we need to measure
+    if (tracker->pendingCount < MAX_PENDING_KEYSTROKES)
+    {
+        tracker->pendingInputTicks[tracker->pendingCount++] = inputTicks;
+    }
+}
+
+void latency_mark_stage(LatencyTracker *tracker, LatencyStage stage)
+{
+    if (tracker->pendingCount)
+    {
+        tracker->stageTicks[stage] = platform_get_performance_tick_count();
+    }
+}
+
+/**
+ * Marks the present and turns every pending keystroke into a sample.
+ */
+void latency_end_frame(LatencyTracker *tracker)
+{
+    if (!tracker->pendingCount)
+    {
+        return;
+    }
+
+    latency_mark_stage(tracker, LATENCY_STAGE_PRESENT);
+
+    u64 frequency = platform_get_performance_tick_frequency();
+    for (u32 keystrokeIdx = 0; keystrokeIdx < tracker->pendingCount; keystrokeIdx++)
+    {
+        u64 inputTicks = tracker->pendingInputTicks[keystrokeIdx];
+        for (u32 stage = 0; stage < LATENCY_STAGE_COUNT; stage++)
+        {
+            u64 elapsedTicks = tracker->stageTicks[stage] > inputTicks ? tracker->stageTicks[stage] - inputTicks : 0;
+            tracker->samples[stage][tracker->nextSample] = (u32)((elapsedTicks * 1000000) / frequency);
+        }
+
+        tracker->nextSample = (tracker->nextSample + 1) % MAX_LATENCY_SAMPLES;
+        tracker->sampleCount += tracker->sampleCount < MAX_LATENCY_SAMPLES ? 1 : 0;
+    }
+
+    tracker->pendingCount = 0;
+}
+
+/**
+ * Logs the 50th, 90th and 99th percentile and the maximum of the time
+ * from the input event to every stage, over the last samples.
+ * @param scratch Needs room for MAX_LATENCY_SAMPLES values
+ */
+void latency_report(LatencyTracker *tracker, u32 *scratch)
+{
+    if (!tracker->sampleCount)
+    {
+        CAKEZ_TRACE("Input Latency: no keystrokes measured yet");
+        return;
+    }
+
+    CAKEZ_TRACE("Input Latency over %u keystrokes, in ms (p50 / p90 / p99 / max)", tracker->sampleCount);
+
+    u32 count = tracker->sampleCount;
+    for (u32 stage = 0; stage < LATENCY_STAGE_COUNT; stage++)
+    {
+        memcpy(scratch, tracker->samples[stage], count * sizeof(u32));
+
+        // Only a thousand values, insertion sort is plenty
+        for (u32 i = 1; i < count; i++)
+        {
+            u32 value = scratch[i];
+            u32 j = i;
+            while (j > 0 && scratch[j - 1] > value)
+            {
+                scratch[j] = scratch[j - 1];
+                j--;
+            }
+            scratch[j] = value;
+        }
+
+        CAKEZ_TRACE("  %-12s %6.2f / %6.2f / %6.2f / %6.2f", latencyStageNames[stage],
+                    scratch[(count - 1) * 50 / 100] / 1000.0f,
+                    scratch[(count - 1) * 90 / 100] / 1000.0f,
+                    scratch[(count - 1) * 99 / 100] / 1000.0f,
+                    scratch[count - 1] / 1000.0f);
+    }
+}
@@ -0,0 +1,746 @@
+#include "defines.h"
+#include "logger.h"
+#include "memory.h"
+#include "platform.h"
+#include "profiler.h"
+
+#include <string.h>
+
+// Lines are never copied while sorting, we only sort
+// offsets into the text and write the result at the end
+struct LineSlice
+{
+    u32 offset;
+    u32 length;
+};
+
+u32 constexpr MAX_SORT_JOBS = 64;
+u32 constexpr MIN_LINES_PER_SORT_JOB = 4096;
+u32 constexpr INSERTION_SORT_RUN_LENGTH = 16;
+
+// External Sort, used when the Slices don't fit into the memory budget
+u32 constexpr MAX_SORT_RUNS = 256;
+u32 constexpr MAX_SORT_RUN_PATH_LENGTH = 320;
+u32 constexpr SORT_RUN_WRITE_BUFFER_SIZE = MB(1);
+u32 constexpr MIN_SORT_RUN_READ_BUFFER_SIZE = KB(64);
+
+struct LineSortJob
+{
+    char *text;
+    LineSlice *src;
+    LineSlice *dst;
+    u32 start;
+    u32 mid;
+    u32 end;
+    bool isMerge;
+
+    // Whoever claims the job runs it. It is set up claimed, so a late
+    // queue entry can't run it before complete_line_sort_jobs opens it
+    u32 volatile isClaimed;
+};
+
+// Jobs of the sort that runs right now, sorts only run on the main thread.
+// Queue entries that get picked up after the sort find every job claimed.
+struct LineSortBatch
+{
+    u32 jobCount;
+    u32 volatile jobsPending;
+    LineSortJob jobs[MAX_SORT_JOBS];
+};
+
+global_variable LineSortBatch lineSortBatch;
+
+struct SortRunReader
+{
+    char path[MAX_SORT_RUN_PATH_LENGTH];
+    u32 runIdx;
+
+    u64 fileOffset;
+    u64 fileSize;
+
+    char *buffer;
+    u32 bufferSize;
+    u32 bufferPos;
+    u32 bufferLength;
+
+    // Current line, points into buffer
+    char *line;
+    u32 lineLength;
+
+    // The Run could not be read back completely
+    bool hasFailed;
+};
+
+internal s32 compare_bytes(char *a, u32 aLength, char *b, u32 bLength)
+{
+    u32 minLength = aLength < bLength ? aLength : bLength;
+    s32 result = memcmp(a, b, minLength);
+    if (result == 0)
+    {
+        result = aLength < bLength ? -1 : (aLength > bLength ? 1 : 0);
+    }
+
+    return result;
+}
+
+internal s32 compare_lines(char *text, LineSlice a, LineSlice b)
+{
+    return compare_bytes(text + a.offset, a.length, text + b.offset, b.length);
+}
+
+internal void merge_line_slices(char *text, LineSlice *src, LineSlice *dst,
+                                u32 start, u32 mid, u32 end)
+{
+    u32 a = start;
+    u32 b = mid;
+    u32 out = start;
+
+    while (a < mid && b < end)
+    {
+        // Taking from the left on equal lines keeps the sort stable
+        if (compare_lines(text, src[a], src[b]) <= 0)
+        {
+            dst[out++] = src[a++];
+        }
+        else
+        {
+            dst[out++] = src[b++];
+        }
+    }
+
+    memcpy(dst + out, src + a, (mid - a) * sizeof(LineSlice));
+    out += mid - a;
+    memcpy(dst + out, src + b, (end - b) * sizeof(LineSlice));
+}
+
+// Bottom up merge sort of [start, end), the result always ends up in slices
+internal void sort_line_slices(char *text, LineSlice *slices, LineSlice *scratch,
+                               u32 start, u32 end)
+{
+    // Insertion sort short runs first, merging them is not worth it
+    for (u32 runStart = start; runStart < end; runStart += INSERTION_SORT_RUN_LENGTH)
+    {
+        u32 runEnd = runStart + INSERTION_SORT_RUN_LENGTH;
+        runEnd = runEnd > end ? end : runEnd;
+
+        for (u32 i = runStart + 1; i < runEnd; i++)
+        {
+            LineSlice slice = slices[i];
+            u32 j = i;
+            while (j > runStart && compare_lines(text, slices[j - 1], slice) > 0)
+            {
+                slices[j] = slices[j - 1];
+                j--;
+            }
+            slices[j] = slice;
+        }
+    }
+
+    LineSlice *src = slices;
+    LineSlice *dst = scratch;
+    u32 count = end - start;
+    for (u32 width = INSERTION_SORT_RUN_LENGTH; width < count; width *= 2)
+    {
+        for (u32 left = start; left < end; left += 2 * width)
+        {
+            u32 mid = left + width > end ? end : left + width;
+            u32 right = left + 2 * width > end ? end : left + 2 * width;
+            merge_line_slices(text, src, dst, left, mid, right);
+        }
+
+        LineSlice *temp = src;
+        src = dst;
+        dst = temp;
+    }
+
+    if (src != slices)
+    {
+        memcpy(slices + start, src + start, count * sizeof(LineSlice));
+    }
+}
+
+internal void sort_line_chunk(LineSortJob *job)
+{
+    MEASURE_FUNCTION();
+    sort_line_slices(job->text, job->src, job->dst, job->start, job->end);
+}
+
+internal void merge_line_chunks(LineSortJob *job)
+{
+    MEASURE_FUNCTION();
+    merge_line_slices(job->text, job->src, job->dst, job->start, job->mid, job->end);
+}
+
+// Runs the jobs of the current batch that nobody claimed yet
+internal void run_line_sort_jobs()
+{
+    for (u32 jobIdx = 0; jobIdx < lineSortBatch.jobCount; jobIdx++)
+    {
+        LineSortJob *job = &lineSortBatch.jobs[jobIdx];
+        if (platform_atomic_compare_exchange(&job->isClaimed, true, false) == false)
+        {
+            if (job->isMerge)
+            {
+                merge_line_chunks(job);
+            }
+            else
+            {
+                sort_line_chunk(job);
+            }
+            platform_atomic_add(&lineSortBatch.jobsPending, (u32)-1);
+        }
+    }
+}
+
+internal void line_sort_jobs_work(WorkQueue *queue, void *data)
+{
+    run_line_sort_jobs();
+}
+
+/**
+ * Runs the jobCount jobs that were set up in lineSortBatch. The calling
+ * thread works on them too and only waits for them, not for the other
+ * entries of the queue.
+ */
+internal void complete_line_sort_jobs(WorkQueue *queue, u32 jobCount)
+{
+    lineSortBatch.jobCount = jobCount;
+    lineSortBatch.jobsPending = jobCount;
+    for (u32 jobIdx = 0; jobIdx < jobCount; jobIdx++)
+    {
+        platform_atomic_exchange(&lineSortBatch.jobs[jobIdx].isClaimed, false);
+    }
+
+    u32 helperCount = queue ? platform_get_thread_count() : 1;
+    helperCount = jobCount < helperCount ? jobCount : helperCount;
+    for (u32 helperIdx = 1; helperIdx < helperCount; helperIdx++)
+    {
+        platform_add_work_entry(queue, line_sort_jobs_work, 0);
+    }
+
+    run_line_sort_jobs();
+    while (lineSortBatch.jobsPending)
+    {
+        platform_yield_thread();
+    }
+}
+
+/**
+ * Sorts count slices across all threads. Every thread sorts one chunk,
+ * then the chunks are merged pairwise, again in parallel. Only the main
+ * thread sorts, the jobs live in lineSortBatch.
+ * @return Either slices or scratch, depending on where the result ended up
+ */
+internal LineSlice *parallel_sort_line_slices(WorkQueue *queue, char *text,
+                                              LineSlice *slices, LineSlice *scratch,
+                                              u32 count)
+{
+    u32 chunkCount = queue ? platform_get_thread_count() : 1;
+    chunkCount = chunkCount > MAX_SORT_JOBS ? MAX_SORT_JOBS : chunkCount;
+    while (chunkCount > 1 && count / chunkCount < MIN_LINES_PER_SORT_JOB)
+    {
+        chunkCount /= 2;
+    }
+    chunkCount = chunkCount ? chunkCount : 1;
+
+    u32 chunkSize = (count + chunkCount - 1) / chunkCount;
+    for (u32 chunkIdx = 0; chunkIdx < chunkCount; chunkIdx++)
+    {
+        u32 start = chunkIdx * chunkSize;
+        u32 end = start + chunkSize > count ? count : start + chunkSize;
+        lineSortBatch.jobs[chunkIdx] = {text, slices, scratch, start, 0, start < end ? end : start, false, true};
+    }
+    complete_line_sort_jobs(queue, chunkCount);
+
+    LineSlice *src = slices;
+    LineSlice *dst = scratch;
+    for (u32 width = chunkSize; width < count; width *= 2)
+    {
+        u32 jobCount = 0;
+        for (u32 left = 0; left < count; left += 2 * width)
+        {
+            u32 mid = left + width > count ? count : left + width;
+            u32 right = left + 2 * width > count ? count : left + 2 * width;
+            lineSortBatch.jobs[jobCount++] = {text, src, dst, left, mid, right, true, true};
+        }
+        complete_line_sort_jobs(queue, jobCount);
+
+        LineSlice *temp = src;
+        src = dst;
+        dst = temp;
+    }
+
+    return src;
+}
+
+internal u32 count_lines(char *text, u32 length)
+{
+    u32 lineCount = 0;
+    char *at = text;
+    char *end = text + length;
+    while (at < end)
+    {
+        char *newline = (char *)memchr(at, '\n', end - at);
+        at = newline ? newline + 1 : end;
+        lineCount++;
+    }
+
+    return lineCount;
+}
+
+/**
+ * Collects up to maxSlices lines, starting at offset. The newline
+ * is not part of the slice.
+ * @param outOffset Receives the offset of the first line that was not collected
+ */
+internal u32 collect_line_slices(char *text, u32 length, u32 offset,
+                                 LineSlice *slices, u32 maxSlices, u32 *outOffset)
+{
+    u32 sliceCount = 0;
+    while (offset < length && sliceCount < maxSlices)
+    {
+        char *newline = (char *)memchr(text + offset, '\n', length - offset);
+        u32 lineEnd = newline ? (u32)(newline - text) : length;
+
+        slices[sliceCount++] = {offset, lineEnd - offset};
+        offset = newline ? lineEnd + 1 : length;
+    }
+
+    *outOffset = offset;
+    return sliceCount;
+}
+
+internal u32 write_line_slices(char *text, LineSlice *slices, u32 count,
+                               char *out, bool unique, bool trailingNewline)
+{
+    u32 outLength = 0;
+    for (u32 sliceIdx = 0; sliceIdx < count; sliceIdx++)
+    {
+        LineSlice slice = slices[sliceIdx];
+        if (unique && sliceIdx > 0 && compare_lines(text, slices[sliceIdx - 1], slice) == 0)
+        {
+            continue;
+        }
+
+        if (outLength)
+        {
+            out[outLength++] = '\n';
+        }
+        memcpy(out + outLength, text + slice.offset, slice.length);
+        outLength += slice.length;
+    }
+
+    if (trailingNewline && count)
+    {
+        out[outLength++] = '\n';
+    }
+
+    return outLength;
+}
+
+// The process id keeps the Runs of two editors that sort at the same time apart
+internal void get_sort_run_path(char *tempFolder, u32 runIdx, char *path)
+{
+    sprintf(path, "%scakeztor_sort_run_%u_%u.tmp", tempFolder, platform_get_process_id(), runIdx);
+}
+
+// @return false if not all of data made it to disk
+internal bool write_sort_run(char *path, char *data, u32 size, bool overwrite)
+{
+    return platform_write_file(path, data, size, overwrite) == size;
+}
+
+/**
+ * @return false at the end of the Run, or if it could not be read, then hasFailed is set
+ */
+internal bool sort_run_reader_next_line(SortRunReader *reader)
+{
+    char *start = reader->buffer + reader->bufferPos;
+    u32 available = reader->bufferLength - reader->bufferPos;
+    char *newline = (char *)memchr(start, '\n', available);
+
+    if (!newline && reader->fileOffset < reader->fileSize)
+    {
+        // Move the partial line to the front and refill the rest of the buffer
+        memmove(reader->buffer, start, available);
+        u64 remaining = reader->fileSize - reader->fileOffset;
+        u32 space = reader->bufferSize - available;
+        u32 bytesRead = platform_read_file_chunk(reader->path, reader->fileOffset,
+                                                 reader->buffer + available,
+                                                 remaining < space ? (u32)remaining : space);
+        reader->fileOffset += bytesRead;
+        reader->bufferPos = 0;
+        reader->bufferLength = available + bytesRead;
+
+        // The buffers fit the longest line of all Runs, so this only happens if the Run is cut short
+        start = reader->buffer;
+        newline = (char *)memchr(start, '\n', reader->bufferLength);
+        reader->hasFailed = !newline;
+    }
+    else if (!newline && available)
+    {
+        // Every line of a Run ends with a newline
+        reader->hasFailed = true;
+    }
+
+    if (newline)
+    {
+        reader->line = start;
+        reader->lineLength = (u32)(newline - start);
+        reader->bufferPos = (u32)(newline + 1 - reader->buffer);
+    }
+
+    return newline != 0;
+}
+
+// Returns true if the current line of reader a goes before the one of reader b
+internal bool sort_run_reader_less(SortRunReader *a, SortRunReader *b)
+{
+    s32 result = compare_bytes(a->line, a->lineLength, b->line, b->lineLength);
+
+    // Runs are in text order, so this keeps the merge stable
+    return result < 0 || (result == 0 && a->runIdx < b->runIdx);
+}
+
+internal void sort_run_heap_sift_down(SortRunReader **heap, u32 heapCount, u32 idx)
+{
+    for (;;)
+    {
+        u32 smallest = idx;
+        u32 left = idx * 2 + 1;
+        u32 right = left + 1;
+
+        if (left < heapCount && sort_run_reader_less(heap[left], heap[smallest]))
+        {
+            smallest = left;
+        }
+        if (right < heapCount && sort_run_reader_less(heap[right], heap[smallest]))
+        {
+            smallest = right;
+        }
+
+        if (smallest == idx)
+        {
+            break;
+        }
+
+        SortRunReader *temp = heap[idx];
+        heap[idx] = heap[smallest];
+        heap[smallest] = temp;
+        idx = smallest;
+    }
+}
+
+internal void delete_sort_runs(char *tempFolder, u32 runCount)
+{
+    char path[MAX_SORT_RUN_PATH_LENGTH];
+    for (u32 runIdx = 0; runIdx < runCount; runIdx++)
+    {
+        get_sort_run_path(tempFolder, runIdx, path);
+        platform_delete_file(path);
+    }
+}
+
+/**
+ * Sorts runs of lines that fit into the memory budget and spills them to temp
+ * files, then k-way merges the runs into a copy of the text. The text is only
+ * overwritten once every Run was read back completely.
+ * @return The new length of text, or length if the text was left untouched
+ */
+internal u32 line_ops_sort_external(char *text, u32 length, bool unique, bool trailingNewline,
+                                    GameMemory *sortMemory, WorkQueue *queue)
+{
+    char tempFolder[MAX_SORT_RUN_PATH_LENGTH - 32];
+    if (!platform_get_temp_folder(tempFolder, sizeof(tempFolder)))
+    {
+        CAKEZ_WARN("Failed to get the Temp Folder, can't sort lines");
+        return length;
+    }
+
+    TempMemory sortTempMemory = begin_temp_memory(sortMemory);
+    u64 budget = sortMemory->memorySizeInBytes - sortMemory->allocatedBytes;
+    u64 outSize = (u64)length + KB(1);
+    u64 runLineCapacity = budget > outSize + SORT_RUN_WRITE_BUFFER_SIZE + KB(1)
+                              ? (budget - outSize - SORT_RUN_WRITE_BUFFER_SIZE - KB(1)) / (2 * sizeof(LineSlice))
+                              : 0;
+
+    if (runLineCapacity < MIN_LINES_PER_SORT_JOB)
+    {
+        CAKEZ_WARN("Not enough memory to sort lines, budget: %llu", budget);
+        return length;
+    }
+
+    // The merge goes here, so a Run that can't be read back leaves the text untouched
+    char *out = (char *)allocate_memory(sortMemory, length, MEMORY_TAG_SORT);
+    budget -= outSize;
+
+    TempMemory tempMemory = begin_temp_memory(sortMemory);
+    char *writeBuffer = (char *)allocate_memory(sortMemory, SORT_RUN_WRITE_BUFFER_SIZE, MEMORY_TAG_SORT);
+
+    // The copy of the text before them has any length
+    LineSlice *slices = (LineSlice *)allocate_memory(sortMemory, (u32)runLineCapacity * sizeof(LineSlice),
+                                                     MEMORY_TAG_SORT, alignof(LineSlice));
+    LineSlice *scratch = (LineSlice *)allocate_memory(sortMemory, (u32)runLineCapacity * sizeof(LineSlice),
+                                                      MEMORY_TAG_SORT, alignof(LineSlice));
+    if (!out || !writeBuffer || !slices || !scratch)
+    {
+        CAKEZ_WARN("Failed to allocate %llu bytes to sort lines", budget + outSize);
+        end_temp_memory(sortTempMemory);
+        return length;
+    }
+
+    // Sort Runs and spill them to disk
+    u32 runCount = 0;
+    u32 offset = 0;
+    u32 maxLineLength = 0;
+    u64 runSizes[MAX_SORT_RUNS];
+    char path[MAX_SORT_RUN_PATH_LENGTH];
+    while (offset < length)
+    {
+        if (runCount == MAX_SORT_RUNS)
+        {
+            CAKEZ_WARN("Reached maximum amount of Sort Runs, can't sort lines");
+            delete_sort_runs(tempFolder, runCount);
+            end_temp_memory(sortTempMemory);
+            return length;
+        }
+
+        u32 count = collect_line_slices(text, length, offset, slices,
+                                        (u32)runLineCapacity, &offset);
+        LineSlice *sorted = parallel_sort_line_slices(queue, text, slices, scratch, count);
+
+        // Counted before the write, so a Run that failed halfway gets deleted too
+        get_sort_run_path(tempFolder, runCount, path);
+        u64 *runSize = &runSizes[runCount++];
+        *runSize = 0;
+        bool isWritten = write_sort_run(path, writeBuffer, 0, true);
+
+        u32 writeLength = 0;
+        for (u32 sliceIdx = 0; sliceIdx < count && isWritten; sliceIdx++)
+        {
+            LineSlice slice = sorted[sliceIdx];
+            if (unique && sliceIdx > 0 && compare_lines(text, sorted[sliceIdx - 1], slice) == 0)
+            {
+                continue;
+            }
+
+            maxLineLength = slice.length > maxLineLength ? slice.length : maxLineLength;
+            *runSize += slice.length + 1;
+            if (writeLength + slice.length + 1 > SORT_RUN_WRITE_BUFFER_SIZE)
+            {
+                isWritten = write_sort_run(path, writeBuffer, writeLength, false);
+                writeLength = 0;
+            }
+
+            if (slice.length + 1 > SORT_RUN_WRITE_BUFFER_SIZE)
+            {
+                // Lines that don't fit the Write Buffer are written directly
+                isWritten = isWritten && write_sort_run(path, text + slice.offset, slice.length, false) &&
+                            write_sort_run(path, "\n", 1, false);
+                continue;
+            }
+
+            memcpy(writeBuffer + writeLength, text + slice.offset, slice.length);
+            writeLength += slice.length;
+            writeBuffer[writeLength++] = '\n';
+        }
+
+        if (!isWritten || !write_sort_run(path, writeBuffer, writeLength, false))
+        {
+            CAKEZ_WARN("Failed to write the Sort Run %s, the lines are not sorted", path);
+            delete_sort_runs(tempFolder, runCount);
+            end_temp_memory(sortTempMemory);
+            return length;
+        }
+    }
+
+    // The Slices are not needed anymore, use the memory to read the Runs
+    end_temp_memory(tempMemory);
+    u32 readerSize = runCount * (sizeof(SortRunReader) + sizeof(SortRunReader *)) + KB(1);
+    u64 availableReadBufferSize = budget > readerSize ? (budget - readerSize) / runCount : 0;
+    u64 readBufferSize = availableReadBufferSize > MB(64) ? MB(64) : availableReadBufferSize;
+
+    // A reader needs room for the longest line and its newline, otherwise the merge would lose lines
+    u64 minReadBufferSize = (u64)maxLineLength + 1;
+    minReadBufferSize = minReadBufferSize > MIN_SORT_RUN_READ_BUFFER_SIZE ? minReadBufferSize
+                                                                          : MIN_SORT_RUN_READ_BUFFER_SIZE;
+    readBufferSize = readBufferSize < minReadBufferSize ? minReadBufferSize : readBufferSize;
+
+    if (readBufferSize > availableReadBufferSize)
+    {
+        CAKEZ_WARN("Not enough memory to merge %u Sort Runs with lines of up to %u bytes", runCount, maxLineLength);
+        delete_sort_runs(tempFolder, runCount);
+        end_temp_memory(sortTempMemory);
+        return length;
+    }
+
+    SortRunReader *readers = (SortRunReader *)allocate_memory(sortMemory, runCount * sizeof(SortRunReader),
+                                                              MEMORY_TAG_SORT, alignof(SortRunReader));
+    SortRunReader **heap = (SortRunReader **)allocate_memory(sortMemory, runCount * sizeof(SortRunReader *),
+                                                             MEMORY_TAG_SORT, alignof(SortRunReader *));
+
+    bool hasFailed = !readers || !heap;
+    u32 heapCount = 0;
+    for (u32 runIdx = 0; runIdx < runCount && !hasFailed; runIdx++)
+    {
+        SortRunReader *reader = &readers[runIdx];
+        *reader = {};
+        get_sort_run_path(tempFolder, runIdx, reader->path);
+        reader->runIdx = runIdx;
+        reader->fileSize = runSizes[runIdx];
+        reader->bufferSize = (u32)readBufferSize;
+        reader->buffer = (char *)allocate_memory(sortMemory, reader->bufferSize, MEMORY_TAG_SORT);
+
+        if (!reader->buffer)
+        {
+            hasFailed = true;
+        }
+        else if (sort_run_reader_next_line(reader))
+        {
+            heap[heapCount++] = reader;
+        }
+        hasFailed = hasFailed || reader->hasFailed;
+    }
+
+    for (s32 idx = (s32)heapCount / 2 - 1; idx >= 0; idx--)
+    {
+        sort_run_heap_sift_down(heap, heapCount, idx);
+    }
+
+    // K-Way Merge into the copy
+    u32 outLength = 0;
+    LineSlice lastLine = {};
+    bool hasLastLine = false;
+    while (heapCount && !hasFailed)
+    {
+        SortRunReader *reader = heap[0];
+
+        if (!unique || !hasLastLine ||
+            compare_bytes(reader->line, reader->lineLength,
+                          out + lastLine.offset, lastLine.length) != 0)
+        {
+            if (hasLastLine)
+            {
+                out[outLength++] = '\n';
+            }
+
+            memcpy(out + outLength, reader->line, reader->lineLength);
+            lastLine = {outLength, reader->lineLength};
+            outLength += reader->lineLength;
+            hasLastLine = true;
+        }
+
+        if (!sort_run_reader_next_line(reader))
+        {
+            hasFailed = reader->hasFailed;
+            heap[0] = heap[--heapCount];
+        }
+        sort_run_heap_sift_down(heap, heapCount, 0);
+    }
+
+    if (hasFailed)
+    {
+        CAKEZ_WARN("Failed to read the Sort Runs back, the lines are not sorted");
+        outLength = length;
+    }
+    else
+    {
+        if (trailingNewline && hasLastLine)
+        {
+            out[outLength++] = '\n';
+        }
+        memcpy(text, out, outLength);
+    }
+
+    delete_sort_runs(tempFolder, runCount);
+    end_temp_memory(sortTempMemory);
+
+    return outLength;
+}
+
+/**
+ * Sorts the lines of text in place, the lines are compared byte wise.
+ * If the slices and a copy of the text don't fit into sortMemory, sorted
+ * runs are spilled to temp files and merged back.
+ * @param sortMemory Best reserved memory that can hold a copy of the text,
+ * only what is used gets committed
+ * @param unique Drops duplicate lines, like sort -u
+ * @param queue Can be 0, then everything runs on the calling thread
+ * @return The new length of text
+ */
+u32 line_ops_sort(char *text, u32 length, bool unique,
+                  GameMemory *sortMemory, WorkQueue *queue)
+{
+    u32 newLength = length;
+
+    if (length)
+    {
+        bool trailingNewline = text[length - 1] == '\n';
+        u32 lineCount = count_lines(text, length);
+
+        TempMemory tempMemory = begin_temp_memory(sortMemory);
+        u64 budget = sortMemory->memorySizeInBytes - sortMemory->allocatedBytes;
+        u64 inMemorySize = 2 * (u64)lineCount * sizeof(LineSlice) + length + KB(1);
+
+        if (inMemorySize < budget)
+        {
+            LineSlice *slices = (LineSlice *)allocate_memory(sortMemory, lineCount * sizeof(LineSlice), MEMORY_TAG_SORT);
+            LineSlice *scratch = (LineSlice *)allocate_memory(sortMemory, lineCount * sizeof(LineSlice), MEMORY_TAG_SORT);
+            char *out = (char *)allocate_memory(sortMemory, length, MEMORY_TAG_SORT);
+            if (slices && scratch && out)
+            {
+                u32 offset;
+                u32 count = collect_line_slices(text, length, 0, slices, lineCount, &offset);
+                LineSlice *sorted = parallel_sort_line_slices(queue, text, slices, scratch, count);
+
+                newLength = write_line_slices(text, sorted, count, out, unique, trailingNewline);
+                memcpy(text, out, newLength);
+            }
+            else
+            {
+                CAKEZ_WARN("Failed to allocate %llu bytes to sort lines", inMemorySize);
+            }
+
+            end_temp_memory(tempMemory);
+        }
+        else
+        {
+            newLength = line_ops_sort_external(text, length, unique, trailingNewline,
+                                               sortMemory, queue);
+        }
+    }
+
+    return newLength;
+}
+
+internal void reverse_bytes(char *start, char *end)
+{
+    while (start + 1 < end)
+    {
+        char temp = *start;
+        *start++ = *--end;
+        *end = temp;
+    }
+}
+
+/**
+ * Reverses the order of the lines of text in place. The whole text gets
+ * reversed first, then every line on its own, so no extra memory is needed,
+ * no matter the size of the text.
+ */
+void line_ops_reverse(char *text, u32 length)
+{
+    // Keep the trailing newline at the end
+    u32 contentLength = (length && text[length - 1] == '\n') ? length - 1 : length;
+    reverse_bytes(text, text + contentLength);
+
+    char *at = text;
+    char *end = text + contentLength;
+    while (at < end)
+    {
+        char *newline = (char *)memchr(at, '\n', end - at);
+        char *lineEnd = newline ? newline : end;
+        reverse_bytes(at, lineEnd);
+        at = lineEnd + 1;
+    }
+}
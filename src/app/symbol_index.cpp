@@ -0,0 +1,1029 @@
+#include "defines.h"
+#include "logger.h"
+#include "memory.h"
+#include "platform.h"
+#include "profiler.h"
+
+#include <string.h>
+
+u32 constexpr SYMBOL_INDEX_VERSION = 1;
+u32 constexpr MAX_SYMBOL_NAME_LENGTH = 128;
+u32 constexpr MAX_SYMBOL_JOBS = 8;
+u32 constexpr SYMBOL_SOURCE_BUFFER_SIZE = KB(256);
+u32 constexpr SYMBOL_JOB_SYMBOL_BYTES = KB(256);
+u32 constexpr SYMBOL_JOB_NAME_BYTES = KB(128);
+
+enum SymbolKind : u8
+{
+    SYMBOL_KIND_FUNCTION,
+    SYMBOL_KIND_TYPE,
+    SYMBOL_KIND_MACRO,
+};
+
+// The Index File is used straight from the mapped memory, the layout is
+// Header | Files | Symbols sorted by name | Strings
+struct SymbolIndexHeader
+{
+    u32 magic;
+    u32 version;
+    u32 fileCount;
+    u32 symbolCount;
+    u32 stringBytes;
+    u32 filesOffset;
+    u32 symbolsOffset;
+    u32 stringsOffset;
+};
+
+struct SymbolFile
+{
+    long long lastEditTimestamp;
+    u32 pathOffset;
+    u32 pathLength;
+};
+
+struct Symbol
+{
+    u32 nameOffset;
+    u32 fileIdx;
+    u32 line;
+    u16 nameLength;
+    SymbolKind kind;
+    u8 padding;
+};
+
+// Source file found by the File Finder, either parsed again or taken from the old Index
+struct SymbolSourceFile
+{
+    char *path;
+    u32 pathLength;
+    long long lastEditTimestamp;
+    u32 oldFileIdx;
+};
+
+struct SymbolParseJob
+{
+    struct SymbolIndex *index;
+    char *sourceBuffer;
+
+    // Symbol names point into nameMemory until they get merged
+    GameMemory symbolMemory;
+    GameMemory nameMemory;
+    u32 symbolCount;
+    bool isFull;
+};
+
+enum SymbolRefreshState : u32
+{
+    SYMBOL_REFRESH_IDLE,
+    SYMBOL_REFRESH_SCANNING,
+    SYMBOL_REFRESH_SCANNED,
+    SYMBOL_REFRESH_PARSING,
+    SYMBOL_REFRESH_WRITTEN,
+};
+
+struct SymbolIndex
+{
+    char indexPath[MAX_PATH_LENGTH];
+    char newIndexPath[MAX_PATH_LENGTH];
+    bool isRefreshed;
+
+    // Mapped Index File, 0 if there is none
+    void *mappedMemory;
+    SymbolIndexHeader *header;
+    SymbolFile *files;
+    Symbol *symbols;
+    char *strings;
+
+    // Reset for every refresh, the refresh runs on the queue. The main thread
+    // only starts it, queues the parse jobs and maps the new Index File
+    u32 volatile refreshState;
+    GameMemory workMemory;
+    FileFinder *finder;
+    char *rootFolder;
+    SymbolSourceFile *sourceFiles;
+    u32 sourceFileCount;
+    u32 changedFileCount;
+    u32 volatile nextSourceFile;
+    u32 jobCount;
+    u32 volatile runningJobCount;
+    SymbolParseJob jobs[MAX_SYMBOL_JOBS];
+};
+
+// allocate_memory asserts when it runs out, the Index just stops growing instead
+internal bool fits_into(GameMemory *memory, u32 size)
+{
+    return memory->allocatedBytes + size < memory->memorySizeInBytes;
+}
+
+internal bool is_identifier_start(u8 c)
+{
+    return is_word_char(c) && !(c >= '0' && c <= '9');
+}
+
+internal bool token_equals(char *token, u32 length, char *keyword)
+{
+    return strlen(keyword) == length && memcmp(token, keyword, length) == 0;
+}
+
+internal bool is_source_file(char *path, u32 length)
+{
+    char *extension = path + length;
+    while (extension > path && extension[-1] != '.' && extension[-1] != '/')
+    {
+        extension--;
+    }
+
+    if (extension == path || extension[-1] != '.')
+    {
+        return false;
+    }
+
+    u32 extensionLength = (u32)(path + length - extension);
+    return token_equals(extension, extensionLength, "c") ||
+           token_equals(extension, extensionLength, "h") ||
+           token_equals(extension, extensionLength, "cpp") ||
+           token_equals(extension, extensionLength, "hpp") ||
+           token_equals(extension, extensionLength, "cc") ||
+           token_equals(extension, extensionLength, "inl");
+}
+
+/**
+ * The Index File comes from the Temp Folder and is used without copying it, so
+ * every offset in it gets checked once when it is mapped. A file that was cut
+ * short or got corrupted is rebuilt instead of being read out of bounds.
+ */
+internal bool validate_symbol_index(SymbolIndexHeader *header, u64 size)
+{
+    if (size < sizeof(SymbolIndexHeader) ||
+        header->magic != FOURCC("CSYM") ||
+        header->version != SYMBOL_INDEX_VERSION)
+    {
+        return false;
+    }
+
+    if ((u64)header->filesOffset + (u64)header->fileCount * sizeof(SymbolFile) > size ||
+        (u64)header->symbolsOffset + (u64)header->symbolCount * sizeof(Symbol) > size ||
+        (u64)header->stringsOffset + header->stringBytes > size)
+    {
+        return false;
+    }
+
+    SymbolFile *files = (SymbolFile *)((u8 *)header + header->filesOffset);
+    for (u32 fileIdx = 0; fileIdx < header->fileCount; fileIdx++)
+    {
+        if ((u64)files[fileIdx].pathOffset + files[fileIdx].pathLength > header->stringBytes)
+        {
+            return false;
+        }
+    }
+
+    Symbol *symbols = (Symbol *)((u8 *)header + header->symbolsOffset);
+    for (u32 symbolIdx = 0; symbolIdx < header->symbolCount; symbolIdx++)
+    {
+        Symbol *symbol = &symbols[symbolIdx];
+        if ((u64)symbol->nameOffset + symbol->nameLength > header->stringBytes ||
+            symbol->fileIdx >= header->fileCount)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+internal void symbol_index_map(SymbolIndex *index)
+{
+    u64 size = 0;
+    void *memory = platform_map_file(index->indexPath, &size);
+    if (!memory)
+    {
+        return;
+    }
+
+    SymbolIndexHeader *header = (SymbolIndexHeader *)memory;
+    if (!validate_symbol_index(header, size))
+    {
+        CAKEZ_WARN("Symbol Index %s is invalid, it will be rebuilt", index->indexPath);
+        platform_unmap_file(memory);
+        return;
+    }
+
+    index->mappedMemory = memory;
+    index->header = header;
+    index->files = (SymbolFile *)((u8 *)memory + header->filesOffset);
+    index->symbols = (Symbol *)((u8 *)memory + header->symbolsOffset);
+    index->strings = (char *)memory + header->stringsOffset;
+}
+
+internal void symbol_index_unmap(SymbolIndex *index)
+{
+    if (index->mappedMemory)
+    {
+        platform_unmap_file(index->mappedMemory);
+    }
+
+    index->mappedMemory = 0;
+    index->header = 0;
+    index->files = 0;
+    index->symbols = 0;
+    index->strings = 0;
+}
+
+/**
+ * Maps the Index File at indexPath if there is one, so lookups work
+ * right away. workBytes are used for refreshing the Index.
+ */
+bool symbol_index_init(SymbolIndex *index, GameMemory *memory, u32 workBytes, char *indexPath)
+{
+    *index = {};
+    if (!init_sub_memory(&index->workMemory, memory, workBytes, MEMORY_TAG_SYMBOL_INDEX))
+    {
+        return false;
+    }
+
+    snprintf(index->indexPath, MAX_PATH_LENGTH, "%s", indexPath);
+    snprintf(index->newIndexPath, MAX_PATH_LENGTH, "%s.new", indexPath);
+    symbol_index_map(index);
+    return true;
+}
+
+internal void add_symbol(SymbolParseJob *job, u32 fileIdx, char *name, u32 length,
+                         u32 line, SymbolKind kind)
+{
+    if (length > MAX_SYMBOL_NAME_LENGTH || token_equals(name, length, "operator"))
+    {
+        return;
+    }
+
+    if (!fits_into(&job->symbolMemory, sizeof(Symbol)) || !fits_into(&job->nameMemory, length))
+    {
+        job->isFull = true;
+        return;
+    }
+
+    Symbol *symbol = (Symbol *)allocate_memory(&job->symbolMemory, sizeof(Symbol));
+    char *nameCopy = (char *)allocate_memory(&job->nameMemory, length);
+
+    memcpy(nameCopy, name, length);
+    symbol->nameOffset = (u32)(nameCopy - (char *)job->nameMemory.memory);
+    symbol->fileIdx = fileIdx;
+    symbol->line = line;
+    symbol->nameLength = (u16)length;
+    symbol->kind = kind;
+    symbol->padding = 0;
+    job->symbolCount++;
+}
+
+struct SymbolToken
+{
+    u32 offset;
+    u32 length;
+    u32 line;
+};
+
+/**
+ * A small ctags like scanner, finds function definitions, struct, class,
+ * union and enum definitions, typedefs and macros. Bodies of functions and
+ * types are skipped, namespaces and extern "C" blocks are not.
+ */
+internal void parse_symbols(SymbolParseJob *job, u32 fileIdx, char *text, u32 length)
+{
+    u32 line = 1;
+    u32 depth = 0;
+    u32 parenDepth = 0;
+
+    // One bit per open brace, set for namespaces and extern "C"
+    u64 transparentBraces = 0;
+    u32 braceLevel = 0;
+    bool isNamespacePending = false;
+    bool isExternPending = false;
+
+    SymbolToken lastName = {};
+    SymbolToken functionName = {};
+    bool isFunctionPending = false;
+
+    // 1 after struct/class/union/enum, 2 once the name was seen
+    u32 typeState = 0;
+    SymbolToken typeName = {};
+
+    bool isTypedef = false;
+    u32 typedefDepth = 0;
+
+    u32 at = 0;
+    while (at < length)
+    {
+        u8 c = text[at];
+        u8 next = at + 1 < length ? text[at + 1] : 0;
+
+        if (c == '\n')
+        {
+            line++;
+            at++;
+        }
+        else if (c == ' ' || c == '\t' || c == '\r')
+        {
+            at++;
+        }
+        else if (c == '/' && next == '/')
+        {
+            while (at < length && text[at] != '\n')
+            {
+                at++;
+            }
+        }
+        else if (c == '/' && next == '*')
+        {
+            at += 2;
+            while (at < length && !(text[at] == '*' && at + 1 < length && text[at + 1] == '/'))
+            {
+                line += text[at++] == '\n';
+            }
+            at += 2;
+        }
+        else if (c == '"' || c == '\'')
+        {
+            at++;
+            while (at < length && text[at] != c && text[at] != '\n')
+            {
+                at += text[at] == '\\' ? 2 : 1;
+            }
+            at++;
+        }
+        else if (c == '#')
+        {
+            at++;
+            while (at < length && (text[at] == ' ' || text[at] == '\t'))
+            {
+                at++;
+            }
+
+            u32 directiveStart = at;
+            while (at < length && is_word_char(text[at]))
+            {
+                at++;
+            }
+
+            if (token_equals(text + directiveStart, at - directiveStart, "define"))
+            {
+                while (at < length && (text[at] == ' ' || text[at] == '\t'))
+                {
+                    at++;
+                }
+
+                u32 nameStart = at;
+                while (at < length && is_word_char(text[at]))
+                {
+                    at++;
+                }
+
+                if (at > nameStart)
+                {
+                    add_symbol(job, fileIdx, text + nameStart, at - nameStart, line, SYMBOL_KIND_MACRO);
+                }
+            }
+
+            // Skip the rest of the directive, including continued lines
+            while (at < length && text[at] != '\n')
+            {
+                if (text[at] == '\\' && at + 1 < length && text[at + 1] == '\n')
+                {
+                    line++;
+                    at++;
+                }
+                at++;
+            }
+        }
+        else if (is_identifier_start(c))
+        {
+            u32 start = at;
+            while (at < length && is_word_char(text[at]))
+            {
+                at++;
+            }
+
+            if (parenDepth > 0)
+            {
+                continue;
+            }
+
+            char *token = text + start;
+            u32 tokenLength = at - start;
+            if (token_equals(token, tokenLength, "struct") || token_equals(token, tokenLength, "class") ||
+                token_equals(token, tokenLength, "union") || token_equals(token, tokenLength, "enum"))
+            {
+                // enum class
+                if (typeState != 1)
+                {
+                    typeState = 1;
+                    isFunctionPending = false;
+                }
+            }
+            else if (token_equals(token, tokenLength, "namespace"))
+            {
+                isNamespacePending = true;
+            }
+            else if (token_equals(token, tokenLength, "extern"))
+            {
+                isExternPending = true;
+            }
+            else if (token_equals(token, tokenLength, "typedef"))
+            {
+                isTypedef = true;
+                typedefDepth = depth;
+            }
+            else
+            {
+                if (typeState == 1)
+                {
+                    typeName = {start, tokenLength, line};
+                    typeState = 2;
+                }
+                lastName = {start, tokenLength, line};
+            }
+        }
+        else
+        {
+            if (c == '(')
+            {
+                // extern "C" void foo(), not a block
+                isExternPending = false;
+
+                if (parenDepth == 0 && depth == 0 && !isFunctionPending && !typeState && lastName.length)
+                {
+                    functionName = lastName;
+                }
+                parenDepth++;
+            }
+            else if (c == ')')
+            {
+                parenDepth = parenDepth ? parenDepth - 1 : 0;
+                if (parenDepth == 0 && functionName.length)
+                {
+                    isFunctionPending = true;
+                }
+            }
+            else if (parenDepth > 0)
+            {
+                // Lambdas, initializers and so on
+            }
+            else if (c == '{')
+            {
+                if (typeState == 2)
+                {
+                    add_symbol(job, fileIdx, text + typeName.offset, typeName.length, typeName.line, SYMBOL_KIND_TYPE);
+                }
+                else if (isFunctionPending)
+                {
+                    add_symbol(job, fileIdx, text + functionName.offset, functionName.length, functionName.line, SYMBOL_KIND_FUNCTION);
+                }
+
+                bool isTransparent = isNamespacePending || isExternPending;
+                if (braceLevel < 64)
+                {
+                    u64 bit = (u64)1 << braceLevel;
+                    transparentBraces = isTransparent ? transparentBraces | bit : transparentBraces & ~bit;
+                }
+                depth += isTransparent ? 0 : 1;
+                braceLevel++;
+
+                isNamespacePending = false;
+                isExternPending = false;
+                isFunctionPending = false;
+                functionName = {};
+                lastName = {};
+                typeState = 0;
+            }
+            else if (c == '}')
+            {
+                if (braceLevel > 0)
+                {
+                    braceLevel--;
+                    bool isTransparent = braceLevel < 64 && (transparentBraces & ((u64)1 << braceLevel));
+                    depth -= isTransparent || !depth ? 0 : 1;
+                }
+
+                isFunctionPending = false;
+                functionName = {};
+                lastName = {};
+            }
+            else if (c == ';')
+            {
+                if (isTypedef && depth == typedefDepth && lastName.length)
+                {
+                    add_symbol(job, fileIdx, text + lastName.offset, lastName.length, lastName.line, SYMBOL_KIND_TYPE);
+                    isTypedef = false;
+                }
+
+                isNamespacePending = false;
+                isExternPending = false;
+                isFunctionPending = false;
+                functionName = {};
+                lastName = {};
+                typeState = 0;
+            }
+            else if (c == '=')
+            {
+                isFunctionPending = false;
+                functionName = {};
+                typeState = 0;
+            }
+            else if (c == ',')
+            {
+                // Template arguments of base classes can have commas
+                isFunctionPending = false;
+                functionName = {};
+            }
+            at++;
+        }
+    }
+}
+
+internal void parse_source_files(SymbolParseJob *job)
+{
+    MEASURE_FUNCTION();
+    SymbolIndex *index = job->index;
+
+    while (true)
+    {
+        u32 fileIdx = platform_atomic_add(&index->nextSourceFile, 1);
+        if (fileIdx >= index->sourceFileCount)
+        {
+            break;
+        }
+
+        SymbolSourceFile *sourceFile = &index->sourceFiles[fileIdx];
+        if (sourceFile->oldFileIdx != INVALID_IDX)
+        {
+            continue;
+        }
+
+        char path[MAX_PATH_LENGTH];
+        snprintf(path, MAX_PATH_LENGTH, "%s/%s", index->rootFolder, sourceFile->path);
+
+        // Large files only get their beginning indexed
+        u32 bytesRead = platform_read_file_chunk(path, 0, job->sourceBuffer, SYMBOL_SOURCE_BUFFER_SIZE);
+        parse_symbols(job, fileIdx, job->sourceBuffer, bytesRead);
+
+        // Out of space, the file gets parsed again on the next refresh
+        if (job->isFull)
+        {
+            CAKEZ_WARN("Symbol Index ran out of space parsing %s", path);
+            sourceFile->lastEditTimestamp = 0;
+        }
+    }
+}
+
+internal u32 hash_path(char *path, u32 length)
+{
+    // FNV-1a
+    u32 hash = 2166136261;
+    for (u32 idx = 0; idx < length; idx++)
+    {
+        hash = (hash ^ (u8)path[idx]) * 16777619;
+    }
+
+    return hash;
+}
+
+/**
+ * The Index File goes into the temp folder and not into rootFolder, writing it
+ * must not look like a change to the watched folder. Its name is a hash of the
+ * full path of rootFolder, so every folder keeps its own Index.
+ * @param indexPath Receives the path, needs to hold MAX_PATH_LENGTH bytes
+ * @return false if the path does not fit
+ */
+bool symbol_index_get_path(char *indexPath, char *rootFolder)
+{
+    char fullPath[MAX_PATH_LENGTH];
+    char tempFolder[MAX_PATH_LENGTH];
+    if (!platform_get_full_path(rootFolder, fullPath, MAX_PATH_LENGTH) ||
+        !platform_get_temp_folder(tempFolder, MAX_PATH_LENGTH))
+    {
+        return false;
+    }
+
+    // Paths on Windows don't care about the case
+    u32 length = (u32)strlen(fullPath);
+    for (u32 idx = 0; idx < length; idx++)
+    {
+        fullPath[idx] = to_lower((u8)fullPath[idx]);
+    }
+
+    u32 written = snprintf(indexPath, MAX_PATH_LENGTH, "%scakeztor_symbols_%08x",
+                           tempFolder, hash_path(fullPath, length));
+    return written < MAX_PATH_LENGTH - 4;
+}
+
+internal s32 compare_symbols(char *strings, Symbol *a, Symbol *b)
+{
+    return compare_bytes(strings + a->nameOffset, a->nameLength, strings + b->nameOffset, b->nameLength);
+}
+
+// Bottom up merge sort, the result always ends up in symbols
+internal void sort_symbols(char *strings, Symbol *symbols, Symbol *scratch, u32 count)
+{
+    Symbol *src = symbols;
+    Symbol *dst = scratch;
+    for (u32 width = 1; width < count; width *= 2)
+    {
+        for (u32 left = 0; left < count; left += 2 * width)
+        {
+            u32 mid = left + width > count ? count : left + width;
+            u32 right = left + 2 * width > count ? count : left + 2 * width;
+
+            u32 a = left;
+            u32 b = mid;
+            for (u32 out = left; out < right; out++)
+            {
+                dst[out] = b >= right || (a < mid && compare_symbols(strings, src + a, src + b) <= 0)
+                               ? src[a++]
+                               : src[b++];
+            }
+        }
+
+        Symbol *temp = src;
+        src = dst;
+        dst = temp;
+    }
+
+    if (src != symbols)
+    {
+        memcpy(symbols, src, count * sizeof(Symbol));
+    }
+}
+
+/**
+ * Writes a new Index File from the old Index and the parse jobs to
+ * newIndexPath, the old Index stays mapped.
+ * @return false if the work memory ran out or the file could not be written
+ */
+internal bool symbol_index_write(SymbolIndex *index, u32 jobCount)
+{
+    GameMemory *memory = &index->workMemory;
+
+    // Old Index File -> new Index File
+    u32 *fileRemap = 0;
+    if (index->header)
+    {
+        if (!fits_into(memory, index->header->fileCount * sizeof(u32)))
+        {
+            CAKEZ_WARN("Symbol Index ran out of work memory");
+            return false;
+        }
+        fileRemap = (u32 *)allocate_memory(memory, index->header->fileCount * sizeof(u32));
+        memset(fileRemap, 0xFF, index->header->fileCount * sizeof(u32));
+    }
+
+    u32 symbolCount = 0;
+    u32 stringBytes = 0;
+    for (u32 fileIdx = 0; fileIdx < index->sourceFileCount; fileIdx++)
+    {
+        SymbolSourceFile *sourceFile = &index->sourceFiles[fileIdx];
+        if (sourceFile->oldFileIdx != INVALID_IDX)
+        {
+            fileRemap[sourceFile->oldFileIdx] = fileIdx;
+        }
+        stringBytes += sourceFile->pathLength + 1;
+    }
+
+    if (index->header)
+    {
+        for (u32 symbolIdx = 0; symbolIdx < index->header->symbolCount; symbolIdx++)
+        {
+            Symbol *symbol = &index->symbols[symbolIdx];
+            if (symbol->fileIdx < index->header->fileCount && fileRemap[symbol->fileIdx] != INVALID_IDX)
+            {
+                symbolCount++;
+                stringBytes += symbol->nameLength;
+            }
+        }
+    }
+
+    for (u32 jobIdx = 0; jobIdx < jobCount; jobIdx++)
+    {
+        symbolCount += index->jobs[jobIdx].symbolCount;
+        stringBytes += index->jobs[jobIdx].nameMemory.allocatedBytes;
+    }
+
+    u32 filesOffset = sizeof(SymbolIndexHeader);
+    u32 symbolsOffset = filesOffset + index->sourceFileCount * sizeof(SymbolFile);
+    u32 stringsOffset = symbolsOffset + symbolCount * sizeof(Symbol);
+    u32 size = stringsOffset + stringBytes;
+
+    if (!fits_into(memory, size + symbolCount * sizeof(Symbol)))
+    {
+        CAKEZ_WARN("Symbol Index ran out of work memory");
+        return false;
+    }
+    // The strings leave out unaligned, so the scratch goes first
+    Symbol *scratch = (Symbol *)allocate_memory(memory, symbolCount * sizeof(Symbol));
+    u8 *out = allocate_memory(memory, size);
+
+    SymbolIndexHeader *header = (SymbolIndexHeader *)out;
+    header->magic = FOURCC("CSYM");
+    header->version = SYMBOL_INDEX_VERSION;
+    header->fileCount = index->sourceFileCount;
+    header->symbolCount = symbolCount;
+    header->stringBytes = stringBytes;
+    header->filesOffset = filesOffset;
+    header->symbolsOffset = symbolsOffset;
+    header->stringsOffset = stringsOffset;
+
+    SymbolFile *files = (SymbolFile *)(out + filesOffset);
+    Symbol *symbols = (Symbol *)(out + symbolsOffset);
+    char *strings = (char *)out + stringsOffset;
+    u32 stringOffset = 0;
+
+    for (u32 fileIdx = 0; fileIdx < index->sourceFileCount; fileIdx++)
+    {
+        SymbolSourceFile *sourceFile = &index->sourceFiles[fileIdx];
+        files[fileIdx].lastEditTimestamp = sourceFile->lastEditTimestamp;
+        files[fileIdx].pathOffset = stringOffset;
+        files[fileIdx].pathLength = sourceFile->pathLength;
+        memcpy(strings + stringOffset, sourceFile->path, sourceFile->pathLength + 1);
+        stringOffset += sourceFile->pathLength + 1;
+    }
+
+    u32 outSymbolIdx = 0;
+    if (index->header)
+    {
+        for (u32 symbolIdx = 0; symbolIdx < index->header->symbolCount; symbolIdx++)
+        {
+            Symbol symbol = index->symbols[symbolIdx];
+            if (symbol.fileIdx < index->header->fileCount && fileRemap[symbol.fileIdx] != INVALID_IDX)
+            {
+                memcpy(strings + stringOffset, index->strings + symbol.nameOffset, symbol.nameLength);
+                symbol.nameOffset = stringOffset;
+                symbol.fileIdx = fileRemap[symbol.fileIdx];
+                stringOffset += symbol.nameLength;
+                symbols[outSymbolIdx++] = symbol;
+            }
+        }
+    }
+
+    for (u32 jobIdx = 0; jobIdx < jobCount; jobIdx++)
+    {
+        SymbolParseJob *job = &index->jobs[jobIdx];
+        Symbol *jobSymbols = (Symbol *)job->symbolMemory.memory;
+        for (u32 symbolIdx = 0; symbolIdx < job->symbolCount; symbolIdx++)
+        {
+            Symbol symbol = jobSymbols[symbolIdx];
+            memcpy(strings + stringOffset, (char *)job->nameMemory.memory + symbol.nameOffset, symbol.nameLength);
+            symbol.nameOffset = stringOffset;
+            stringOffset += symbol.nameLength;
+            symbols[outSymbolIdx++] = symbol;
+        }
+    }
+
+    sort_symbols(strings, symbols, scratch, symbolCount);
+
+    if (platform_write_file(index->newIndexPath, (char *)out, size, true) != size)
+    {
+        CAKEZ_WARN("Failed writing Symbol Index %s", index->newIndexPath);
+        return false;
+    }
+
+    return true;
+}
+
+internal void symbol_index_finish_refresh(SymbolIndex *index, bool isWritten)
+{
+    platform_atomic_exchange(&index->refreshState, isWritten ? SYMBOL_REFRESH_WRITTEN : SYMBOL_REFRESH_IDLE);
+}
+
+internal void parse_symbols_work(WorkQueue *queue, void *data)
+{
+    SymbolParseJob *job = (SymbolParseJob *)data;
+    SymbolIndex *index = job->index;
+    parse_source_files(job);
+
+    // The last job to finish writes the new Index File
+    if (platform_atomic_add(&index->runningJobCount, (u32)-1) == 1)
+    {
+        symbol_index_finish_refresh(index, symbol_index_write(index, index->jobCount));
+    }
+}
+
+/**
+ * Looks up the timestamps of the source files the File Finder knows about,
+ * files whose timestamp didn't change are taken from the old Index.
+ */
+internal void symbol_index_scan_work(WorkQueue *queue, void *data)
+{
+    MEASURE_FUNCTION();
+    SymbolIndex *index = (SymbolIndex *)data;
+    FileFinder *finder = index->finder;
+    GameMemory *memory = &index->workMemory;
+
+    // Lookup of the old files by path
+    u32 oldFileCount = index->header ? index->header->fileCount : 0;
+    u32 slotCount = 16;
+    while (slotCount < oldFileCount * 2)
+    {
+        slotCount *= 2;
+    }
+
+    if (!fits_into(memory, finder->pathCount * sizeof(SymbolSourceFile) + slotCount * sizeof(u32)))
+    {
+        CAKEZ_WARN("Symbol Index ran out of work memory");
+        symbol_index_finish_refresh(index, false);
+        return;
+    }
+
+    index->rootFolder = finder->rootFolder;
+    index->sourceFiles = (SymbolSourceFile *)allocate_memory(memory, finder->pathCount * sizeof(SymbolSourceFile));
+    index->sourceFileCount = 0;
+    index->nextSourceFile = 0;
+
+    u32 *slots = (u32 *)allocate_memory(memory, slotCount * sizeof(u32));
+    memset(slots, 0xFF, slotCount * sizeof(u32));
+
+    for (u32 fileIdx = 0; fileIdx < oldFileCount; fileIdx++)
+    {
+        SymbolFile *file = &index->files[fileIdx];
+        u32 slot = hash_path(index->strings + file->pathOffset, file->pathLength) & (slotCount - 1);
+        while (slots[slot] != INVALID_IDX)
+        {
+            slot = (slot + 1) & (slotCount - 1);
+        }
+        slots[slot] = fileIdx;
+    }
+
+    u32 changedFileCount = 0;
+    for (u32 pathIdx = 0; pathIdx < finder->pathCount; pathIdx++)
+    {
+        char *path = file_finder_get_path(finder, pathIdx);
+        u32 pathLength = finder->pathLengths[pathIdx];
+        if (!(finder->pathMasks[pathIdx] & PATH_MASK_IS_FILE) || !is_source_file(path, pathLength))
+        {
+            continue;
+        }
+
+        char fullPath[MAX_PATH_LENGTH];
+        snprintf(fullPath, MAX_PATH_LENGTH, "%s/%s", finder->rootFolder, path);
+
+        SymbolSourceFile *sourceFile = &index->sourceFiles[index->sourceFileCount++];
+        sourceFile->path = path;
+        sourceFile->pathLength = pathLength;
+        sourceFile->lastEditTimestamp = platform_last_edit_timestamp(fullPath);
+        sourceFile->oldFileIdx = INVALID_IDX;
+
+        u32 slot = hash_path(path, pathLength) & (slotCount - 1);
+        for (; slots[slot] != INVALID_IDX; slot = (slot + 1) & (slotCount - 1))
+        {
+            SymbolFile *file = &index->files[slots[slot]];
+            if (file->pathLength == pathLength &&
+                memcmp(index->strings + file->pathOffset, path, pathLength) == 0)
+            {
+                if (file->lastEditTimestamp == sourceFile->lastEditTimestamp)
+                {
+                    sourceFile->oldFileIdx = slots[slot];
+                }
+                break;
+            }
+        }
+
+        changedFileCount += sourceFile->oldFileIdx == INVALID_IDX;
+    }
+    index->changedFileCount = changedFileCount;
+
+    // Nothing was added, changed or deleted
+    if (!changedFileCount && index->sourceFileCount == oldFileCount && index->header)
+    {
+        symbol_index_finish_refresh(index, false);
+        return;
+    }
+
+    u32 jobCount = platform_get_thread_count();
+    jobCount = jobCount > MAX_SYMBOL_JOBS ? MAX_SYMBOL_JOBS : jobCount;
+    jobCount = jobCount > changedFileCount ? changedFileCount : jobCount;
+
+    for (u32 jobIdx = 0; jobIdx < jobCount; jobIdx++)
+    {
+        if (!fits_into(memory, SYMBOL_SOURCE_BUFFER_SIZE + SYMBOL_JOB_SYMBOL_BYTES + SYMBOL_JOB_NAME_BYTES))
+        {
+            CAKEZ_WARN("Symbol Index ran out of work memory");
+            jobCount = jobIdx;
+            break;
+        }
+
+        SymbolParseJob *job = &index->jobs[jobIdx];
+        *job = {};
+        job->index = index;
+        job->sourceBuffer = (char *)allocate_memory(memory, SYMBOL_SOURCE_BUFFER_SIZE);
+        job->symbolMemory.memorySizeInBytes = SYMBOL_JOB_SYMBOL_BYTES;
+        job->symbolMemory.memory = allocate_memory(memory, SYMBOL_JOB_SYMBOL_BYTES);
+        job->nameMemory.memorySizeInBytes = SYMBOL_JOB_NAME_BYTES;
+        job->nameMemory.memory = allocate_memory(memory, SYMBOL_JOB_NAME_BYTES);
+    }
+    index->jobCount = jobCount;
+
+    // Only files were deleted, or there is no memory to parse, the Index File is written right away
+    if (!jobCount)
+    {
+        symbol_index_finish_refresh(index, symbol_index_write(index, 0));
+        return;
+    }
+
+    // Work entries are only added from the main thread, symbol_index_update queues the parse jobs
+    platform_atomic_exchange(&index->refreshState, SYMBOL_REFRESH_SCANNED);
+}
+
+/**
+ * Brings the Index up to date with the source files the File Finder knows
+ * about, on the queue. Files whose timestamp didn't change are taken from the
+ * old Index, all others are parsed in parallel. Lookups keep using the old
+ * Index until symbol_index_update maps the new one. The File Finder must not
+ * be rebuilt until refreshState is SYMBOL_REFRESH_IDLE again.
+ * @return false if the last refresh is still running
+ */
+bool symbol_index_refresh(SymbolIndex *index, FileFinder *finder, WorkQueue *queue)
+{
+    if (index->refreshState != SYMBOL_REFRESH_IDLE)
+    {
+        return false;
+    }
+
+    index->isRefreshed = true;
+    index->finder = finder;
+    reset_memory(&index->workMemory);
+
+    index->refreshState = SYMBOL_REFRESH_SCANNING;
+    platform_add_work_entry(queue, symbol_index_scan_work, index);
+    return true;
+}
+
+/**
+ * Called from the main thread every frame, queues the parse jobs once the
+ * timestamps are known and maps the new Index File once it is written.
+ */
+void symbol_index_update(SymbolIndex *index, WorkQueue *queue)
+{
+    if (index->refreshState == SYMBOL_REFRESH_SCANNED)
+    {
+        index->refreshState = SYMBOL_REFRESH_PARSING;
+        index->runningJobCount = index->jobCount;
+        for (u32 jobIdx = 0; jobIdx < index->jobCount; jobIdx++)
+        {
+            platform_add_work_entry(queue, parse_symbols_work, &index->jobs[jobIdx]);
+        }
+    }
+    else if (index->refreshState == SYMBOL_REFRESH_WRITTEN)
+    {
+        // The old Index File can't be replaced while it is mapped
+        symbol_index_unmap(index);
+        platform_replace_file(index->indexPath, index->newIndexPath, false);
+        symbol_index_map(index);
+
+        CAKEZ_TRACE("Symbol Index: parsed %u of %u files, %u symbols", index->changedFileCount,
+                    index->sourceFileCount, index->header ? index->header->symbolCount : 0);
+        index->refreshState = SYMBOL_REFRESH_IDLE;
+    }
+}
+
+/**
+ * Looks up the definition of name, works straight from the mapped Index File.
+ * @param path Receives the path relative to the root folder, needs to hold MAX_PATH_LENGTH bytes
+ * @return false if name is not in the Index
+ */
+bool symbol_index_find(SymbolIndex *index, char *name, u32 length, char *path, u32 *line)
+{
+    if (!index->header)
+    {
+        return false;
+    }
+
+    // Lower bound, the first Symbol with the name
+    u32 low = 0;
+    u32 high = index->header->symbolCount;
+    while (low < high)
+    {
+        u32 mid = low + (high - low) / 2;
+        Symbol *symbol = &index->symbols[mid];
+        if (compare_bytes(index->strings + symbol->nameOffset, symbol->nameLength, name, length) < 0)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    if (low == index->header->symbolCount)
+    {
+        return false;
+    }
+
+    Symbol *symbol = &index->symbols[low];
+    if (compare_bytes(index->strings + symbol->nameOffset, symbol->nameLength, name, length) != 0 ||
+        symbol->fileIdx >= index->header->fileCount)
+    {
+        return false;
+    }
+
+    SymbolFile *file = &index->files[symbol->fileIdx];
+    snprintf(path, MAX_PATH_LENGTH, "%.*s", file->pathLength, index->strings + file->pathOffset);
+    *line = symbol->line;
+    return true;
+}
@@ -0,0 +1,611 @@
+#include "defines.h"
+#include "logger.h"
+#include "memory.h"
+#include "platform.h"
+#include "profiler.h"
+
+#include <string.h>
+
+u32 constexpr MIN_WORD_LENGTH = 2;
+u32 constexpr MAX_WORD_LENGTH = 64;
+u32 constexpr MAX_WORD_INDEX_OPS = 1024;
+u32 constexpr WORDS_PER_INDEX_LOCK = 1024;
+// The Snapshot commits memory in steps of this size as the text grows
+u32 constexpr WORD_INDEX_SNAPSHOT_GROW_SIZE = MB(1);
+// Removed words stay in the Trie, once this many of them make up half of it the Trie is built again
+u32 constexpr MIN_DEAD_NODES_FOR_REBUILD = 4096;
+u32 constexpr ROOT_NODE_IDX = 0;
+
+enum WordIndexOpType : u8
+{
+    WORD_INDEX_OP_ADD,
+    WORD_INDEX_OP_REMOVE,
+};
+
+struct WordIndexOp
+{
+    WordIndexOpType type;
+    u8 length;
+    char word[MAX_WORD_LENGTH];
+};
+
+// Edges of the Radix Trie are stored on the Child, the Label
+// points into the Label Arena. Siblings are sorted by the first
+// byte of the Label.
+struct WordTrieNode
+{
+    u32 labelOffset;
+    u32 firstChild;
+    u32 nextSibling;
+
+    // Amount of times the word ending at this Node appears
+    u32 count;
+
+    // Upper bound of count in the subtree, removals don't lower it
+    u32 maxCount;
+
+    u16 labelLength;
+
+    // The count of the word dropped to zero, the Node stays until the Trie is built again
+    bool isDead;
+};
+
+struct WordCompletion
+{
+    char word[MAX_WORD_LENGTH + 1];
+    u32 length;
+    u32 count;
+};
+
+struct WordIndex
+{
+    // Guards the Trie, the worker holds it for a batch of words at a time
+    u32 volatile lock;
+    GameMemory nodeMemory;
+    GameMemory labelMemory;
+    WordTrieNode *nodes;
+    u32 nodeCount;
+    u32 deadNodeCount;
+    bool isFull;
+
+    // Edits from the main thread, drained by the worker
+    u32 volatile opWriteIdx;
+    u32 volatile opReadIdx;
+    WordIndexOp ops[MAX_WORD_INDEX_OPS];
+
+    // Set when an edit didn't fit into the Ops or too many Nodes are dead,
+    // the Trie has to be built from the whole text again
+    u32 volatile needsRebuild;
+
+    // Copy of a whole buffer, tokenized by the worker
+    GameMemory snapshotMemory;
+    char *snapshot;
+    u32 snapshotCapacity;
+    u32 snapshotLength;
+    u32 volatile snapshotPending;
+
+    // Makes the worker stop tokenizing a Snapshot that is about to be replaced
+    u32 volatile isCancelled;
+
+    // Set while a job is queued, cleared when it is done
+    u32 volatile jobInFlight;
+
+    // Held by whoever works on the Snapshot and the Ops, a job that doesn't get it does nothing
+    u32 volatile isWorking;
+};
+
+internal bool is_word_char(u8 c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '_' || c >= 0x80;
+}
+
+internal bool is_indexed_word(char *word, u32 length)
+{
+    return length >= MIN_WORD_LENGTH && length <= MAX_WORD_LENGTH &&
+           !(word[0] >= '0' && word[0] <= '9');
+}
+
+internal u32 word_trie_create_node(WordIndex *index)
+{
+    WordTrieNode *node = (WordTrieNode *)allocate_memory(&index->nodeMemory, sizeof(WordTrieNode),
+                                                         MEMORY_TAG_WORD_INDEX);
+    *node = {};
+    return index->nodeCount++;
+}
+
+internal void word_trie_clear(WordIndex *index)
+{
+    reset_memory(&index->nodeMemory);
+    reset_memory(&index->labelMemory);
+    index->nodeCount = 0;
+    index->deadNodeCount = 0;
+    index->isFull = false;
+    word_trie_create_node(index);
+}
+
+internal u8 *word_trie_label(WordIndex *index, WordTrieNode *node)
+{
+    return index->labelMemory.memory + node->labelOffset;
+}
+
+/**
+ * Adds delta to the count of word, the word is inserted if it doesn't
+ * exist and delta is positive. Counts never drop below zero.
+ */
+internal void word_trie_add(WordIndex *index, char *word, u32 length, s32 delta)
+{
+    // Worst case we need two Nodes and the whole word as a Label
+    if (delta > 0 &&
+        (index->nodeMemory.allocatedBytes + 2 * sizeof(WordTrieNode) >= index->nodeMemory.memorySizeInBytes ||
+         index->labelMemory.allocatedBytes + length >= index->labelMemory.memorySizeInBytes))
+    {
+        if (!index->isFull)
+        {
+            CAKEZ_WARN("Word Index is full, new words won't be indexed");
+            index->isFull = true;
+        }
+        return;
+    }
+
+    WordTrieNode *nodes = index->nodes;
+    u32 path[MAX_WORD_LENGTH + 2];
+    u32 pathLength = 0;
+
+    u32 nodeIdx = ROOT_NODE_IDX;
+    u32 at = 0;
+    while (at < length)
+    {
+        path[pathLength++] = nodeIdx;
+
+        u8 c = (u8)word[at];
+        u32 prevIdx = 0;
+        u32 childIdx = nodes[nodeIdx].firstChild;
+        while (childIdx && *word_trie_label(index, &nodes[childIdx]) < c)
+        {
+            prevIdx = childIdx;
+            childIdx = nodes[childIdx].nextSibling;
+        }
+
+        WordTrieNode *child = childIdx ? &nodes[childIdx] : 0;
+        if (!child || *word_trie_label(index, child) != c)
+        {
+            if (delta < 0)
+            {
+                return;
+            }
+
+            // New Leaf with the rest of the word
+            u32 leafIdx = word_trie_create_node(index);
+            WordTrieNode *leaf = &nodes[leafIdx];
+            leaf->labelOffset = index->labelMemory.allocatedBytes;
+            leaf->labelLength = (u16)(length - at);
+            memcpy(allocate_memory(&index->labelMemory, length - at, MEMORY_TAG_WORD_INDEX), word + at, length - at);
+
+            leaf->nextSibling = childIdx;
+            if (prevIdx)
+            {
+                nodes[prevIdx].nextSibling = leafIdx;
+            }
+            else
+            {
+                nodes[nodeIdx].firstChild = leafIdx;
+            }
+
+            nodeIdx = leafIdx;
+            break;
+        }
+
+        u8 *label = word_trie_label(index, child);
+        u32 common = 1;
+        while (common < child->labelLength && at + common < length &&
+               label[common] == (u8)word[at + common])
+        {
+            common++;
+        }
+
+        if (common < child->labelLength)
+        {
+            if (delta < 0)
+            {
+                return;
+            }
+
+            // Split the Edge, the new Node takes the shared part of the Label
+            u32 midIdx = word_trie_create_node(index);
+            WordTrieNode *mid = &nodes[midIdx];
+            mid->labelOffset = child->labelOffset;
+            mid->labelLength = (u16)common;
+            mid->firstChild = childIdx;
+            mid->nextSibling = child->nextSibling;
+            mid->maxCount = child->maxCount;
+
+            child->labelOffset += common;
+            child->labelLength -= (u16)common;
+            child->nextSibling = 0;
+
+            if (prevIdx)
+            {
+                nodes[prevIdx].nextSibling = midIdx;
+            }
+            else
+            {
+                nodes[nodeIdx].firstChild = midIdx;
+            }
+            childIdx = midIdx;
+        }
+
+        nodeIdx = childIdx;
+        at += common;
+    }
+
+    WordTrieNode *node = &nodes[nodeIdx];
+    if (delta < 0)
+    {
+        if (node->count && node->count <= (u32)-delta)
+        {
+            node->isDead = true;
+            index->deadNodeCount++;
+        }
+        node->count = node->count > (u32)-delta ? node->count + delta : 0;
+    }
+    else
+    {
+        if (node->isDead)
+        {
+            node->isDead = false;
+            index->deadNodeCount--;
+        }
+        node->count += delta;
+
+        path[pathLength++] = nodeIdx;
+        for (u32 pathIdx = 0; pathIdx < pathLength; pathIdx++)
+        {
+            WordTrieNode *pathNode = &nodes[path[pathIdx]];
+            pathNode->maxCount = pathNode->maxCount > node->count ? pathNode->maxCount : node->count;
+        }
+    }
+}
+
+/**
+ * Words are found without the lock, only adding a batch of them to the
+ * Trie holds it. Stops early if the Snapshot gets replaced.
+ */
+internal void word_index_tokenize(WordIndex *index, char *text, u32 length)
+{
+    u32 wordStarts[WORDS_PER_INDEX_LOCK];
+    u8 wordLengths[WORDS_PER_INDEX_LOCK];
+
+    u32 at = 0;
+    while (at < length && !index->isCancelled)
+    {
+        u32 wordCount = 0;
+        while (at < length && wordCount < WORDS_PER_INDEX_LOCK)
+        {
+            while (at < length && !is_word_char((u8)text[at]))
+            {
+                at++;
+            }
+
+            u32 start = at;
+            while (at < length && is_word_char((u8)text[at]))
+            {
+                at++;
+            }
+
+            if (is_indexed_word(text + start, at - start))
+            {
+                wordStarts[wordCount] = start;
+                wordLengths[wordCount++] = (u8)(at - start);
+            }
+        }
+
+        begin_spin_lock(&index->lock);
+        for (u32 wordIdx = 0; wordIdx < wordCount; wordIdx++)
+        {
+            word_trie_add(index, text + wordStarts[wordIdx], wordLengths[wordIdx], 1);
+        }
+        end_spin_lock(&index->lock);
+
+        // The lock is not fair, without this the worker takes it right back from a waiting query
+        platform_yield_thread();
+    }
+}
+
+internal void word_index_work(WorkQueue *queue, void *data)
+{
+    MEASURE_FUNCTION();
+    WordIndex *index = (WordIndex *)data;
+
+    // The main thread is replacing the Snapshot, it queues a new job afterwards
+    if (platform_atomic_compare_exchange(&index->isWorking, true, false))
+    {
+        platform_atomic_exchange(&index->jobInFlight, false);
+        return;
+    }
+
+    if (index->snapshotPending)
+    {
+        begin_spin_lock(&index->lock);
+        word_trie_clear(index);
+        end_spin_lock(&index->lock);
+
+        word_index_tokenize(index, index->snapshot, index->snapshotLength);
+        platform_atomic_exchange(&index->snapshotPending, false);
+
+        // A smaller text than the last one doesn't need all of the pages
+        decommit_unused_memory(&index->nodeMemory);
+        decommit_unused_memory(&index->labelMemory);
+    }
+
+    u32 writeIdx = index->opWriteIdx;
+    if (index->opReadIdx != writeIdx)
+    {
+        begin_spin_lock(&index->lock);
+        for (u32 opIdx = index->opReadIdx; opIdx != writeIdx; opIdx = (opIdx + 1) % MAX_WORD_INDEX_OPS)
+        {
+            WordIndexOp *op = &index->ops[opIdx];
+            word_trie_add(index, op->word, op->length, op->type == WORD_INDEX_OP_ADD ? 1 : -1);
+        }
+        end_spin_lock(&index->lock);
+
+        platform_atomic_exchange(&index->opReadIdx, writeIdx);
+
+        // Typing adds every prefix of a word and removes it again, the main thread rebuilds the Trie
+        if (index->deadNodeCount >= MIN_DEAD_NODES_FOR_REBUILD &&
+            index->deadNodeCount > index->nodeCount / 2 && !index->needsRebuild)
+        {
+            CAKEZ_TRACE("Word Index has %u dead of %u Nodes, it is built from the whole text again",
+                        index->deadNodeCount, index->nodeCount);
+            platform_atomic_exchange(&index->needsRebuild, true);
+        }
+    }
+
+    platform_atomic_exchange(&index->isWorking, false);
+    platform_atomic_exchange(&index->jobInFlight, false);
+}
+
+/**
+ * Only address space is reserved up front, the Nodes, Labels and the
+ * Snapshot commit memory as the text grows.
+ * @param maxNodes Nodes the Trie can grow to
+ * @param maxLabelBytes Address space reserved for the Labels
+ * @param maxSnapshotBytes Address space reserved for the Snapshot
+ */
+bool word_index_init(WordIndex *index, u32 maxNodes, u64 maxLabelBytes, u64 maxSnapshotBytes)
+{
+    *index = {};
+
+    if (!init_reserved_memory(&index->nodeMemory, (u64)maxNodes * sizeof(WordTrieNode)) ||
+        !init_reserved_memory(&index->labelMemory, maxLabelBytes) ||
+        !init_reserved_memory(&index->snapshotMemory, maxSnapshotBytes, true))
+    {
+        return false;
+    }
+    index->snapshot = (char *)index->snapshotMemory.memory;
+
+    index->nodes = (WordTrieNode *)index->nodeMemory.memory;
+    word_trie_clear(index);
+    return true;
+}
+
+// Called from the main thread every frame, kicks the worker if there is work
+void word_index_update(WordIndex *index, WorkQueue *queue)
+{
+    if (!index->jobInFlight &&
+        (index->snapshotPending || index->opReadIdx != index->opWriteIdx))
+    {
+        index->jobInFlight = true;
+        platform_add_work_entry(queue, word_index_work, index);
+    }
+}
+
+/**
+ * Replaces the content of the index with the words of text,
+ * the text is copied and tokenized on a worker thread.
+ */
+void word_index_queue_text(WordIndex *index, WorkQueue *queue, char *text, u32 length)
+{
+    // Only a job that is running right now uses the last Snapshot, it stops after its current batch
+    platform_atomic_exchange(&index->isCancelled, true);
+    while (platform_atomic_compare_exchange(&index->isWorking, true, false))
+    {
+        platform_yield_thread();
+    }
+    platform_atomic_exchange(&index->isCancelled, false);
+
+    // The Snapshot grows with the text, only the pages it uses are committed
+    if (length > index->snapshotCapacity)
+    {
+        u64 capacity = ((u64)length + WORD_INDEX_SNAPSHOT_GROW_SIZE - 1) / WORD_INDEX_SNAPSHOT_GROW_SIZE * WORD_INDEX_SNAPSHOT_GROW_SIZE;
+        capacity = capacity < index->snapshotMemory.memorySizeInBytes ? capacity : index->snapshotMemory.memorySizeInBytes - 1;
+        if (capacity > index->snapshotCapacity &&
+            allocate_memory(&index->snapshotMemory, capacity - index->snapshotCapacity, MEMORY_TAG_WORD_INDEX))
+        {
+            index->snapshotCapacity = (u32)capacity;
+        }
+    }
+
+    if (length > index->snapshotCapacity)
+    {
+        CAKEZ_WARN("Text too large for the Word Index, only the first %u bytes are indexed", index->snapshotCapacity);
+        length = index->snapshotCapacity;
+    }
+
+    memcpy(index->snapshot, text, length);
+    index->snapshotLength = length;
+
+    // Edits to the old text don't matter anymore
+    index->opReadIdx = index->opWriteIdx;
+    index->snapshotPending = true;
+    index->needsRebuild = false;
+    platform_atomic_exchange(&index->isWorking, false);
+
+    word_index_update(index, queue);
+}
+
+internal void word_index_queue_op(WordIndex *index, WordIndexOpType type, char *word, u32 length)
+{
+    if (index->needsRebuild)
+    {
+        return;
+    }
+
+    // Dropping the edit would leave the Trie out of sync with the text, so the caller rebuilds it
+    u32 nextWriteIdx = (index->opWriteIdx + 1) % MAX_WORD_INDEX_OPS;
+    if (nextWriteIdx == index->opReadIdx)
+    {
+        CAKEZ_TRACE("Word Index Op Queue is full, the Word Index is built from the whole text again");
+        index->needsRebuild = true;
+        return;
+    }
+
+    WordIndexOp *op = &index->ops[index->opWriteIdx];
+    op->type = type;
+    op->length = (u8)length;
+    memcpy(op->word, word, length);
+
+    // Publish the Op after it is written
+    platform_atomic_exchange(&index->opWriteIdx, nextWriteIdx);
+}
+
+/**
+ * Queues an op for every word in text. Edits remove the words around
+ * the edit before it happens and add the words around it afterwards.
+ */
+void word_index_queue_words(WordIndex *index, WordIndexOpType type, char *text, u32 length)
+{
+    u32 at = 0;
+    while (at < length)
+    {
+        while (at < length && !is_word_char((u8)text[at]))
+        {
+            at++;
+        }
+
+        u32 start = at;
+        while (at < length && is_word_char((u8)text[at]))
+        {
+            at++;
+        }
+
+        if (is_indexed_word(text + start, at - start))
+        {
+            word_index_queue_op(index, type, text + start, at - start);
+        }
+    }
+}
+
+// Returns the start of the word that touches offset
+u32 word_index_word_start(char *text, u32 offset)
+{
+    while (offset > 0 && is_word_char((u8)text[offset - 1]))
+    {
+        offset--;
+    }
+
+    return offset;
+}
+
+// Returns the end of the word that touches offset
+u32 word_index_word_end(char *text, u32 length, u32 offset)
+{
+    while (offset < length && is_word_char((u8)text[offset]))
+    {
+        offset++;
+    }
+
+    return offset;
+}
+
+internal void word_trie_collect(WordIndex *index, u32 nodeIdx, char *word, u32 length,
+                                u32 prefixLength, WordCompletion *results,
+                                u32 maxResults, u32 *resultCount)
+{
+    WordTrieNode *node = &index->nodes[nodeIdx];
+
+    // Nothing in here can beat the results we have
+    if (*resultCount == maxResults && node->maxCount <= results[maxResults - 1].count)
+    {
+        return;
+    }
+
+    if (node->count && length > prefixLength)
+    {
+        // Insert sorted by count, drop the last one if full
+        u32 insertIdx = *resultCount < maxResults ? (*resultCount)++ : maxResults - 1;
+        while (insertIdx > 0 && results[insertIdx - 1].count < node->count)
+        {
+            results[insertIdx] = results[insertIdx - 1];
+            insertIdx--;
+        }
+
+        WordCompletion *result = &results[insertIdx];
+        memcpy(result->word, word, length);
+        result->word[length] = 0;
+        result->length = length;
+        result->count = node->count;
+    }
+
+    for (u32 childIdx = node->firstChild; childIdx; childIdx = index->nodes[childIdx].nextSibling)
+    {
+        WordTrieNode *child = &index->nodes[childIdx];
+        memcpy(word + length, word_trie_label(index, child), child->labelLength);
+        word_trie_collect(index, childIdx, word, length + child->labelLength,
+                          prefixLength, results, maxResults, resultCount);
+    }
+}
+
+/**
+ * Finds the most frequent words that start with prefix, the
+ * prefix itself is not part of the results.
+ * @return The amount of results, sorted by count
+ */
+u32 word_index_complete(WordIndex *index, char *prefix, u32 prefixLength,
+                        WordCompletion *results, u32 maxResults)
+{
+    u32 resultCount = 0;
+    if (!prefixLength || prefixLength > MAX_WORD_LENGTH || !maxResults)
+    {
+        return 0;
+    }
+
+    begin_spin_lock(&index->lock);
+
+    char word[MAX_WORD_LENGTH + 1];
+    u32 nodeIdx = ROOT_NODE_IDX;
+    u32 length = 0;
+    while (nodeIdx != INVALID_IDX && length < prefixLength)
+    {
+        u32 childIdx = index->nodes[nodeIdx].firstChild;
+        while (childIdx && *word_trie_label(index, &index->nodes[childIdx]) != (u8)prefix[length])
+        {
+            childIdx = index->nodes[childIdx].nextSibling;
+        }
+
+        nodeIdx = INVALID_IDX;
+        if (childIdx)
+        {
+            WordTrieNode *child = &index->nodes[childIdx];
+            u8 *label = word_trie_label(index, child);
+            u32 compareLength = prefixLength - length < child->labelLength ? prefixLength - length : child->labelLength;
+
+            if (memcmp(label, prefix + length, compareLength) == 0)
+            {
+                memcpy(word + length, label, child->labelLength);
+                length += child->labelLength;
+                nodeIdx = childIdx;
+            }
+        }
+    }
+
+    if (nodeIdx != INVALID_IDX)
+    {
+        word_trie_collect(index, nodeIdx, word, length, prefixLength,
+                          results, maxResults, &resultCount);
+    }
+
+    end_spin_lock(&index->lock);
+
+    return resultCount;
+}
@@ -0,0 +1,763 @@
+// Defines
+#include "defines.h"
+
+// Logger
+#include "logger.h"
+
+// Math
+#include "my_math.cpp"
+
+// App
+#include "app/app.cpp"
+
+// Memory
+#include "memory.h"
+#include "heap.h"
+
+// Profiler
+#include "profiler.h"
+
+// Input
+#include "input.cpp"
+
+// Glyph Atlas and Text Layout, without the Renderer
+#include "renderer/glyph_atlas.cpp"
+
+// Platform layer, without a Window
+#include <windows.h>
+#include "platform/win32_services.cpp"
+
+// Standard Library
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Headless benchmark of the editor, it runs the App without a Window or
+ * Vulkan. Micro benchmarks measure one operation over a generated text,
+ * macro benchmarks measure what a user does, like typing or opening a file.
+ *
+ * Every benchmark is warmed up first and then timed run by run. The results
+ * are written as JSON Lines, one object per benchmark, so they can be
+ * compared between changes:
+ * {"name":"typing","kind":"macro","runs":20,"min_us":..,"p50_us":..,"p90_us":..,
+ *  "p99_us":..,"max_us":..,"mean_us":..,"checksum":..}
+ *
+ * Usage: editor_bench [--filter <text>] [--runs <count>] [--out <path>]
+ *                     [--baseline <path>] [--threshold <percent>]
+ * With a baseline every benchmark whose p50 got slower than the threshold
+ * is reported and the exit code is 1. Run it from the repository root, the
+ * Glyph Atlas is built from fonts/arial.ttf.
+ *
+ * Built with ALLOC_GUARD it only runs the benchmarks that are frame loops,
+ * typing and wheel_layout, with the Allocation Guard armed. Any allocation of
+ * the main thread from malloc, new, a Heap or the Game Memory is reported with
+ * its call site and the exit code is 1.
+ *
+ * What the frame loops don't cover: the editor has no scrolling yet, a wheel
+ * event only asks for a new frame. wheel_layout moves its own first line and
+ * lays out the visible lines with the Glyph Cache, like a frame that scrolls
+ * would. Nothing here runs vk_render, so building the instances of a frame is
+ * not checked, run main with ALLOC_GUARD for that.
+ */
+
+u32 constexpr BENCH_MAX_RUNS = 1000;
+u32 constexpr BENCH_TEXT_LINES = 16000;
+// The generated text has to fit into this
+u32 constexpr BENCH_MAX_TEXT_LENGTH = MB(1);
+u32 constexpr BENCH_FINDER_PATHS = 20000;
+u32 constexpr BENCH_TYPED_CHARS = 2000;
+u32 constexpr BENCH_SCROLL_FRAMES = 1000;
+u32 constexpr BENCH_SCROLL_LINES_PER_FRAME = 3;
+u32 constexpr BENCH_VISIBLE_LINES = 60;
+u32 constexpr BENCH_MAX_OUTPUT_LENGTH = KB(64);
+u32 constexpr BENCH_MAX_LINE_LENGTH = 128;
+float constexpr BENCH_DEFAULT_THRESHOLD = 10.0f;
+
+struct BenchState
+{
+    AppState *app;
+    InputState *input;
+    Heap *heap;
+
+    // Looks like source code and is the same on every run
+    char *text;
+    u32 textLength;
+
+    // The text with CRLF line endings, in memory and as a file
+    u8 *crlfText;
+    u32 crlfLength;
+    char textPath[MAX_PATH_LENGTH];
+
+    u8 *decodeBuffer;
+    GlyphCache glyphCache;
+    char *fontBitmap;
+};
+
+// @return A checksum of the result, so the work can't be optimized away
+typedef u64 BenchFunction(BenchState *state);
+
+struct Benchmark
+{
+    char *name;
+    char *kind;
+    BenchFunction *function;
+    u32 warmupRuns;
+    u32 runs;
+
+    // Runs frames like the main loop, with ALLOC_GUARD they must not allocate outside of the Arenas
+    bool isFrameLoop;
+};
+
+struct BenchResult
+{
+    u32 runs;
+    double minMicroseconds;
+    double p50Microseconds;
+    double p90Microseconds;
+    double p99Microseconds;
+    double maxMicroseconds;
+    double meanMicroseconds;
+    u64 checksum;
+};
+
+global_variable char *benchWords[] =
+    {"render", "context", "transform", "glyph", "buffer", "memory", "allocate", "index",
+     "word", "finder", "query", "result", "profiler", "thread", "queue", "input",
+     "event", "layout", "atlas", "command", "symbol", "parse", "decode", "encode",
+     "line", "sort", "count", "offset", "length", "frame", "latency", "heap"};
+
+global_variable char *benchFinderQueries[] =
+    {"rend", "ctxglyph", "app", "wordidx", "src/pa", "main", "bench", "qry"};
+
+// xorshift64, the generated data only depends on the seed
+internal u32 bench_random(u64 *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return (u32)*state;
+}
+
+internal char *bench_random_word(u64 *state)
+{
+    return benchWords[bench_random(state) % ArraySize(benchWords)];
+}
+
+/**
+ * Writes lineCount lines of C like code into text, some comments
+ * have characters outside of ASCII.
+ * @return The length of the text, without the null terminator
+ */
+internal u32 bench_generate_text(char *text, u32 maxLength, u32 lineCount)
+{
+    u64 state = 0x9E3779B97F4A7C15;
+    u32 length = 0;
+    u32 depth = 0;
+
+    for (u32 lineIdx = 0; lineIdx < lineCount && length + BENCH_MAX_LINE_LENGTH < maxLength; lineIdx++)
+    {
+        u32 lineType = bench_random(&state) % 6;
+
+        // Blocks open and close, up to 4 levels deep
+        lineType = lineType == 4 && depth == 4 ? 0 : lineType;
+        lineType = lineType == 5 && !depth ? 1 : lineType;
+        depth -= lineType == 5 ? 1 : 0;
+
+        char *line = text + length;
+        u32 indent = depth * 4;
+        memset(line, ' ', indent);
+        line += indent;
+
+        s32 lineLength = 0;
+        switch (lineType)
+        {
+        case 0:
+            lineLength = snprintf(line, BENCH_MAX_LINE_LENGTH, "u32 %s%s = %s_%s(%s, %u);\n",
+                                  bench_random_word(&state), bench_random_word(&state), bench_random_word(&state),
+                                  bench_random_word(&state), bench_random_word(&state), bench_random(&state) % 1000);
+            break;
+        case 1:
+            lineLength = snprintf(line, BENCH_MAX_LINE_LENGTH, "if (%s->%s < %u)\n",
+                                  bench_random_word(&state), bench_random_word(&state), bench_random(&state) % 100);
+            break;
+        case 2:
+            lineLength = snprintf(line, BENCH_MAX_LINE_LENGTH, "// The %s of the %s, gr\xC3\xB6\xC3\x9F\x65r than the %s\n",
+                                  bench_random_word(&state), bench_random_word(&state), bench_random_word(&state));
+            break;
+        case 3:
+            lineLength = snprintf(line, BENCH_MAX_LINE_LENGTH, "%s_%s(&%s, %s);\n",
+                                  bench_random_word(&state), bench_random_word(&state),
+                                  bench_random_word(&state), bench_random_word(&state));
+            break;
+        case 4:
+            lineLength = snprintf(line, BENCH_MAX_LINE_LENGTH, "{\n");
+            depth++;
+            break;
+        default:
+            lineLength = snprintf(line, BENCH_MAX_LINE_LENGTH, "}\n");
+            break;
+        }
+
+        length += indent + lineLength;
+    }
+
+    text[length] = 0;
+    return length;
+}
+
+internal u32 bench_lf_to_crlf(char *text, u32 length, u8 *out)
+{
+    u32 outLength = 0;
+    for (u32 idx = 0; idx < length; idx++)
+    {
+        if (text[idx] == '\n')
+        {
+            out[outLength++] = '\r';
+        }
+        out[outLength++] = text[idx];
+    }
+
+    return outLength;
+}
+
+// Same paths for every run, so the results don't depend on the folder the benchmark runs in
+internal void bench_fill_file_finder(FileFinder *finder)
+{
+    finder->pathCount = 0;
+    reset_memory(&finder->pathMemory);
+
+    u64 state = 0xD1B54A32D192ED03;
+    char folder[MAX_PATH_LENGTH];
+    char name[MAX_PATH_LENGTH];
+    for (u32 pathIdx = 0; pathIdx < BENCH_FINDER_PATHS; pathIdx++)
+    {
+        snprintf(folder, MAX_PATH_LENGTH, "src/%s/%s", bench_random_word(&state), bench_random_word(&state));
+        snprintf(name, MAX_PATH_LENGTH, "%s_%s.cpp", bench_random_word(&state), bench_random_word(&state));
+        file_finder_add_path(finder, folder, name, false);
+    }
+
+    finder->isReady = true;
+}
+
+// Micro Benchmarks
+internal u64 bench_utf8_decode(BenchState *state)
+{
+    u8 *text = (u8 *)state->text;
+    u64 checksum = 0;
+    for (u32 at = 0; at < state->textLength;)
+    {
+        u32 codepoint;
+        u32 size = state->textLength - at < 4 ? state->textLength - at : 4;
+        at += read_utf8(text + at, size, &codepoint);
+        checksum += codepoint;
+    }
+
+    return checksum;
+}
+
+// Loads the CRLF text chunk by chunk, like opening a file does
+internal u64 bench_text_decode(BenchState *state)
+{
+    TextDecoder decoder = {};
+    u64 length = 0;
+    for (u32 offset = 0; offset < state->crlfLength; offset += TEXT_CHUNK_SIZE)
+    {
+        u32 size = state->crlfLength - offset < TEXT_CHUNK_SIZE ? state->crlfLength - offset : TEXT_CHUNK_SIZE;
+        if (!offset)
+        {
+            text_decoder_begin(&decoder, state->crlfText, size);
+        }
+        length += text_decoder_decode(&decoder, state->crlfText + offset, size, state->decodeBuffer);
+    }
+    length += text_decoder_finish(&decoder, state->decodeBuffer);
+
+    return length;
+}
+
+// Everything vk_render_text does besides adding the Transforms
+internal u64 bench_layout_text(BenchState *state)
+{
+    u8 *text = (u8 *)state->text;
+    Vec2 pen = {40.0f, 40.0f};
+    u64 quadCount = 0;
+    for (u32 at = 0; at < state->textLength;)
+    {
+        u32 codepoint;
+        u32 size = state->textLength - at < 4 ? state->textLength - at : 4;
+        at += read_utf8(text + at, size, &codepoint);
+
+        GlyphQuad quad;
+        quadCount += glyph_cache_advance(&state->glyphCache, codepoint, 40.0f, &pen, &quad) ? 1 : 0;
+    }
+
+    return quadCount + (u64)pen.y;
+}
+
+internal u64 bench_count_lines(BenchState *state)
+{
+    return count_lines(state->text, state->textLength);
+}
+
+internal u64 bench_word_complete(BenchState *state)
+{
+    WordCompletion completions[MAX_COMPLETIONS];
+    u64 checksum = 0;
+    for (u32 wordIdx = 0; wordIdx < ArraySize(benchWords); wordIdx++)
+    {
+        for (u32 prefixLength = 1; prefixLength <= 3; prefixLength++)
+        {
+            u32 count = word_index_complete(&state->app->wordIndex, benchWords[wordIdx], prefixLength,
+                                            completions, MAX_COMPLETIONS);
+            checksum += count ? completions[0].count : 0;
+        }
+    }
+
+    return checksum;
+}
+
+internal u64 bench_file_finder_query(BenchState *state)
+{
+    FileFinder *finder = &state->app->fileFinder;
+    u64 checksum = 0;
+    for (u32 queryIdx = 0; queryIdx < ArraySize(benchFinderQueries); queryIdx++)
+    {
+        char *query = benchFinderQueries[queryIdx];
+        file_finder_query(finder, state->app->workQueue, query, (u32)strlen(query));
+        checksum += finder->resultCount ? finder->results[0].pathIdx : 0;
+    }
+
+    return checksum;
+}
+
+// Macro Benchmarks
+internal u64 bench_glyph_atlas(BenchState *state)
+{
+    glyph_cache_build(&state->glyphCache, state->heap, "fonts/arial.ttf", state->fontBitmap, 512, 42);
+    return (u64)state->glyphCache.glyphs['W'].size.x;
+}
+
+internal u64 bench_open_file(BenchState *state)
+{
+    app_open_file(state->app, state->textPath);
+    platform_complete_all_work(state->app->workQueue);
+    return state->app->charCount;
+}
+
+internal u64 bench_sort_lines(BenchState *state)
+{
+    AppState *app = state->app;
+    memcpy(app->buffer, state->text, state->textLength + 1);
+    app->charCount = state->textLength;
+    app_sort_lines(app);
+    return app->buffer[0] + app->charCount;
+}
+
+internal u64 bench_word_index_build(BenchState *state)
+{
+    AppState *app = state->app;
+    word_index_queue_text(&app->wordIndex, app->workQueue, state->text, state->textLength);
+    platform_complete_all_work(app->workQueue);
+    return app->wordIndex.nodeCount;
+}
+
+// One character per frame into an empty buffer, with the Word Index and completions
+internal u64 bench_typing(BenchState *state)
+{
+    AppState *app = state->app;
+    memset(app->buffer, 0, app->charCount);
+    app->charCount = 0;
+
+    u8 *text = (u8 *)state->text;
+    u32 at = 0;
+    for (u32 charIdx = 0; charIdx < BENCH_TYPED_CHARS && at < state->textLength; charIdx++)
+    {
+        // One event per codepoint, like WM_CHAR sends them
+        u32 codepoint;
+        u32 size = state->textLength - at < 4 ? state->textLength - at : 4;
+        at += read_utf8(text + at, size, &codepoint);
+
+        // Enter arrives as a carriage return
+        InputEvent event = {};
+        event.type = INPUT_EVENT_CHAR;
+        event.codepoint = codepoint == '\n' ? '\r' : codepoint;
+        input_push_event(state->input, &event);
+
+        reset_memory(&app->frameMemory);
+        update_app(app, state->input);
+        platform_complete_all_work(app->workQueue);
+    }
+
+    return app->charCount + app->completionCount;
+}
+
+// One wheel event per frame, the App only redraws for it. The bench moves the first
+// visible line itself and lays out the visible lines, it stands in for scrolling
+internal u64 bench_wheel_layout(BenchState *state)
+{
+    AppState *app = state->app;
+    memcpy(app->buffer, state->text, state->textLength + 1);
+    app->charCount = state->textLength;
+
+    u8 *text = (u8 *)app->buffer;
+    u32 firstVisible = 0;
+    u64 quadCount = 0;
+    for (u32 frameIdx = 0; frameIdx < BENCH_SCROLL_FRAMES; frameIdx++)
+    {
+        InputEvent event = {};
+        event.type = INPUT_EVENT_MOUSE_WHEEL;
+        event.wheelDelta = -120;
+        input_push_event(state->input, &event);
+
+        reset_memory(&app->frameMemory);
+        update_app(app, state->input);
+
+        for (u32 lineIdx = 0; lineIdx < BENCH_SCROLL_LINES_PER_FRAME && firstVisible < app->charCount; firstVisible++)
+        {
+            lineIdx += text[firstVisible] == '\n' ? 1 : 0;
+        }
+
+        Vec2 pen = {40.0f, 40.0f};
+        u32 lineCount = 0;
+        for (u32 at = firstVisible; at < app->charCount && lineCount < BENCH_VISIBLE_LINES;)
+        {
+            lineCount += text[at] == '\n' ? 1 : 0;
+
+            u32 codepoint;
+            u32 size = app->charCount - at < 4 ? app->charCount - at : 4;
+            at += read_utf8(text + at, size, &codepoint);
+
+            GlyphQuad quad;
+            quadCount += glyph_cache_advance(&state->glyphCache, codepoint, 40.0f, &pen, &quad) ? 1 : 0;
+        }
+    }
+
+    return quadCount + firstVisible;
+}
+
+global_variable Benchmark benchmarks[] =
+    {
+        {"utf8_decode", "micro", bench_utf8_decode, 5, 200},
+        {"text_decode_crlf", "micro", bench_text_decode, 5, 200},
+        {"layout_text", "micro", bench_layout_text, 5, 200},
+        {"count_lines", "micro", bench_count_lines, 5, 200},
+        {"word_complete", "micro", bench_word_complete, 5, 200},
+        {"file_finder_query", "micro", bench_file_finder_query, 5, 100},
+        {"glyph_atlas_build", "macro", bench_glyph_atlas, 2, 20},
+        {"open_file", "macro", bench_open_file, 2, 20},
+        {"sort_lines", "macro", bench_sort_lines, 2, 20},
+        {"word_index_build", "macro", bench_word_index_build, 2, 20},
+        {"typing", "macro", bench_typing, 1, 10, true},
+        {"wheel_layout", "macro", bench_wheel_layout, 1, 10, true},
+};
+
+internal double bench_ticks_to_microseconds(u64 ticks, u64 frequency)
+{
+    return (double)ticks * 1000000.0 / (double)frequency;
+}
+
+internal void bench_sort_ticks(u64 *ticks, u32 count)
+{
+    for (u32 idx = 1; idx < count; idx++)
+    {
+        u64 value = ticks[idx];
+        u32 insertIdx = idx;
+        for (; insertIdx > 0 && ticks[insertIdx - 1] > value; insertIdx--)
+        {
+            ticks[insertIdx] = ticks[insertIdx - 1];
+        }
+        ticks[insertIdx] = value;
+    }
+}
+
+// Nearest rank, the sorted ticks have at least one entry
+internal u64 bench_get_percentile(u64 *sortedTicks, u32 count, u32 percentile)
+{
+    u32 rank = (count * percentile + 99) / 100;
+    return sortedTicks[rank ? rank - 1 : 0];
+}
+
+internal void bench_run(BenchState *state, Benchmark *bench, u32 runs, BenchResult *result)
+{
+    u64 ticks[BENCH_MAX_RUNS];
+    runs = runs > BENCH_MAX_RUNS ? BENCH_MAX_RUNS : (runs ? runs : 1);
+
+    for (u32 run = 0; run < bench->warmupRuns; run++)
+    {
+        reset_memory(&state->app->frameMemory);
+        bench->function(state);
+    }
+
+    u64 totalTicks = 0;
+    *result = {};
+    for (u32 run = 0; run < runs; run++)
+    {
+        reset_memory(&state->app->frameMemory);
+#ifdef ALLOC_GUARD
+        // The warmup runs got the frame loop to its steady state
+        if (bench->isFrameLoop)
+        {
+            alloc_guard_arm();
+        }
+#endif
+        u64 startTicks = platform_get_performance_tick_count();
+        result->checksum += bench->function(state);
+        ticks[run] = platform_get_performance_tick_count() - startTicks;
+        totalTicks += ticks[run];
+#ifdef ALLOC_GUARD
+        alloc_guard_disarm();
+#endif
+    }
+
+    bench_sort_ticks(ticks, runs);
+    u64 frequency = platform_get_performance_tick_frequency();
+    result->runs = runs;
+    result->minMicroseconds = bench_ticks_to_microseconds(ticks[0], frequency);
+    result->p50Microseconds = bench_ticks_to_microseconds(bench_get_percentile(ticks, runs, 50), frequency);
+    result->p90Microseconds = bench_ticks_to_microseconds(bench_get_percentile(ticks, runs, 90), frequency);
+    result->p99Microseconds = bench_ticks_to_microseconds(bench_get_percentile(ticks, runs, 99), frequency);
+    result->maxMicroseconds = bench_ticks_to_microseconds(ticks[runs - 1], frequency);
+    result->meanMicroseconds = bench_ticks_to_microseconds(totalTicks, frequency) / runs;
+}
+
+/**
+ * Reads a whole file into memory, with a null terminator.
+ * @return 0 if the file doesn't exist
+ */
+internal char *bench_read_text_file(GameMemory *memory, char *path)
+{
+    u64 fileSize = platform_get_file_size(path);
+    char *text = fileSize < UINT32_MAX ? (char *)allocate_memory(memory, fileSize + 1) : 0;
+    if (!text || platform_read_file_chunk(path, 0, text, (u32)fileSize) != fileSize)
+    {
+        return 0;
+    }
+
+    text[fileSize] = 0;
+    return text;
+}
+
+/**
+ * Looks up the p50 of a benchmark in the JSON Lines of an earlier run.
+ * @return false if the baseline doesn't have the benchmark
+ */
+internal bool bench_find_baseline(char *baseline, char *name, double *p50Microseconds)
+{
+    char key[BENCH_MAX_LINE_LENGTH];
+    snprintf(key, sizeof(key), "\"name\":\"%s\"", name);
+
+    char *line = strstr(baseline, key);
+    char *lineEnd = line ? strchr(line, '\n') : 0;
+    char *value = line ? strstr(line, "\"p50_us\":") : 0;
+    if (!value || (lineEnd && value > lineEnd))
+    {
+        return false;
+    }
+
+    *p50Microseconds = atof(value + strlen("\"p50_us\":"));
+    return true;
+}
+
+s32 main(s32 argc, char **argv)
+{
+    log_start_thread();
+
+    char *filter = 0;
+#ifdef ALLOC_GUARD
+    // Debug runtime timings, don't mix them up with the real results
+    char *outPath = "bench_alloc_guard.jsonl";
+#else
+    char *outPath = "bench_results.jsonl";
+#endif
+    char *baselinePath = 0;
+    u32 runsOverride = 0;
+    float threshold = BENCH_DEFAULT_THRESHOLD;
+    for (s32 argIdx = 1; argIdx < argc; argIdx++)
+    {
+        if (!strcmp(argv[argIdx], "--filter") && argIdx + 1 < argc)
+        {
+            filter = argv[++argIdx];
+        }
+        else if (!strcmp(argv[argIdx], "--runs") && argIdx + 1 < argc)
+        {
+            runsOverride = (u32)atoi(argv[++argIdx]);
+        }
+        else if (!strcmp(argv[argIdx], "--out") && argIdx + 1 < argc)
+        {
+            outPath = argv[++argIdx];
+        }
+        else if (!strcmp(argv[argIdx], "--baseline") && argIdx + 1 < argc)
+        {
+            baselinePath = argv[++argIdx];
+        }
+        else if (!strcmp(argv[argIdx], "--threshold") && argIdx + 1 < argc)
+        {
+            threshold = (float)atof(argv[++argIdx]);
+        }
+    }
+
+    GameMemory gameMemory;
+    if (!init_reserved_memory(&gameMemory, GB(16)) || !win32_init_services(&gameMemory))
+    {
+        CAKEZ_FATAL("Failed to allocate the Game Memory");
+        return -1;
+    }
+
+    char *baseline = 0;
+    if (baselinePath && !(baseline = bench_read_text_file(&gameMemory, baselinePath)))
+    {
+        CAKEZ_FATAL("Failed to read the Baseline %s", baselinePath);
+        return -1;
+    }
+
+    // Set up like main does, without the Symbol Index
+    BenchState *state = (BenchState *)allocate_memory(&gameMemory, sizeof(BenchState), MEMORY_TAG_OTHER);
+    Heap *heap = (Heap *)allocate_memory(&gameMemory, sizeof(Heap), MEMORY_TAG_OTHER);
+    InputState *input = (InputState *)allocate_memory(&gameMemory, sizeof(InputState), MEMORY_TAG_INPUT);
+    AppState *app = (AppState *)allocate_memory(&gameMemory, sizeof(AppState), MEMORY_TAG_APP);
+    char *output = (char *)allocate_memory(&gameMemory, BENCH_MAX_OUTPUT_LENGTH, MEMORY_TAG_OTHER);
+    if (!state || !heap || !input || !app || !output || !app_init_text(app) ||
+        !init_sub_memory(&app->transientMemory, &gameMemory, MB(4), MEMORY_TAG_TRANSIENT) ||
+        !init_sub_memory(&app->frameMemory, &gameMemory, MB(1), MEMORY_TAG_FRAME) ||
+        !init_reserved_memory(&app->sortMemory, MAX_SORT_MEMORY, true) ||
+        !word_index_init(&app->wordIndex, MAX_WORD_INDEX_NODES, MAX_WORD_INDEX_LABEL_BYTES, MAX_TEXT_LENGTH) ||
+        !file_finder_init(&app->fileFinder, &workQueue, ".", MAX_FINDER_PATHS, MAX_FINDER_PATH_BYTES))
+    {
+        CAKEZ_FATAL("Failed to allocate memory for the App");
+        return -1;
+    }
+
+    app->workQueue = &workQueue;
+    app->gameMemory = &gameMemory;
+    app->symbolIndex.isRefreshed = true;
+    keybindings_init(&app->keyBindings);
+    heap_init(heap, &gameMemory, MB(1));
+
+    state->app = app;
+    state->input = input;
+    state->heap = heap;
+    state->text = (char *)allocate_memory(&gameMemory, BENCH_MAX_TEXT_LENGTH, MEMORY_TAG_OTHER);
+    state->crlfText = allocate_memory(&gameMemory, 2 * BENCH_MAX_TEXT_LENGTH, MEMORY_TAG_OTHER);
+    state->decodeBuffer = allocate_memory(&gameMemory, TEXT_DECODE_OUT_SIZE(TEXT_CHUNK_SIZE), MEMORY_TAG_OTHER);
+    state->fontBitmap = (char *)allocate_memory(&gameMemory, 512 * 512, MEMORY_TAG_FONT);
+    if (!state->text || !state->crlfText || !state->decodeBuffer || !state->fontBitmap)
+    {
+        CAKEZ_FATAL("Failed to allocate memory for the Benchmark Data");
+        return -1;
+    }
+
+    if (!glyph_cache_build(&state->glyphCache, heap, "fonts/arial.ttf", state->fontBitmap, 512, 42))
+    {
+        CAKEZ_FATAL("Failed to load fonts/arial.ttf, run the benchmark from the repository root");
+        return -1;
+    }
+
+    state->textLength = bench_generate_text(state->text, BENCH_MAX_TEXT_LENGTH, BENCH_TEXT_LINES);
+
+    // The benchmarks copy the text into the buffer, grow it once so no run commits memory
+    if (!app_reserve_text(app, state->textLength))
+    {
+        CAKEZ_FATAL("Failed to grow the Text to %u bytes", state->textLength);
+        return -1;
+    }
+    state->crlfLength = bench_lf_to_crlf(state->text, state->textLength, state->crlfText);
+
+    if (!platform_get_temp_folder(state->textPath, MAX_PATH_LENGTH - 32))
+    {
+        CAKEZ_FATAL("Failed to find the Temp Folder");
+        return -1;
+    }
+    strcat(state->textPath, "cakeztor_bench.txt");
+    if (platform_write_file(state->textPath, (char *)state->crlfText, state->crlfLength, true) != state->crlfLength)
+    {
+        CAKEZ_FATAL("Failed to write %s", state->textPath);
+        return -1;
+    }
+
+    // The File Finder enumerates the working directory first, its paths get replaced
+    platform_complete_all_work(&workQueue);
+    bench_fill_file_finder(&app->fileFinder);
+    bench_word_index_build(state);
+
+#ifdef ALLOC_GUARD
+    alloc_guard_init();
+#endif
+
+    CAKEZ_TRACE("%u Threads, %u KB of Text in %u Lines, %u Paths", platform_get_thread_count(),
+                state->textLength / 1024, BENCH_TEXT_LINES, app->fileFinder.pathCount);
+    CAKEZ_TRACE("  %-20s %-5s %10s %10s %10s %10s %10s", "Benchmark, us", "Kind", "Min", "p50", "p90", "p99", "Max");
+
+    u32 outputLength = 0;
+    u32 regressionCount = 0;
+    u32 allocatingCount = 0;
+    for (u32 benchIdx = 0; benchIdx < ArraySize(benchmarks); benchIdx++)
+    {
+        Benchmark *bench = &benchmarks[benchIdx];
+        if (filter && !strstr(bench->name, filter))
+        {
+            continue;
+        }
+
+#ifdef ALLOC_GUARD
+        if (!bench->isFrameLoop)
+        {
+            continue;
+        }
+#endif
+
+        BenchResult result;
+        bench_run(state, bench, runsOverride ? runsOverride : bench->runs, &result);
+
+#ifdef ALLOC_GUARD
+        u32 violationCount = alloc_guard_report();
+        if (violationCount)
+        {
+            CAKEZ_WARN("  %s allocated %u times outside of the Arenas", bench->name, violationCount);
+            allocatingCount++;
+        }
+#endif
+
+        CAKEZ_TRACE("  %-20s %-5s %10.1f %10.1f %10.1f %10.1f %10.1f", bench->name, bench->kind,
+                    result.minMicroseconds, result.p50Microseconds, result.p90Microseconds,
+                    result.p99Microseconds, result.maxMicroseconds);
+
+        s32 length = snprintf(output + outputLength, BENCH_MAX_OUTPUT_LENGTH - outputLength,
+                              "{\"name\":\"%s\",\"kind\":\"%s\",\"runs\":%u,\"min_us\":%.3f,\"p50_us\":%.3f,"
+                              "\"p90_us\":%.3f,\"p99_us\":%.3f,\"max_us\":%.3f,\"mean_us\":%.3f,\"checksum\":%llu}\n",
+                              bench->name, bench->kind, result.runs, result.minMicroseconds, result.p50Microseconds,
+                              result.p90Microseconds, result.p99Microseconds, result.maxMicroseconds,
+                              result.meanMicroseconds, result.checksum);
+        outputLength += length > 0 && (u32)length < BENCH_MAX_OUTPUT_LENGTH - outputLength ? length : 0;
+
+        double baselineMicroseconds;
+        if (baseline && bench_find_baseline(baseline, bench->name, &baselineMicroseconds) && baselineMicroseconds > 0.0)
+        {
+            double change = (result.p50Microseconds / baselineMicroseconds - 1.0) * 100.0;
+            if (change > threshold)
+            {
+                CAKEZ_WARN("  %s regressed by %.1f%%, p50 %.1f us, was %.1f us", bench->name, change,
+                           result.p50Microseconds, baselineMicroseconds);
+                regressionCount++;
+            }
+        }
+    }
+
+    platform_delete_file(state->textPath);
+
+    if (platform_write_file(outPath, output, outputLength, true) != outputLength)
+    {
+        CAKEZ_FATAL("Failed to write the Results to %s", outPath);
+        return -1;
+    }
+    CAKEZ_TRACE("Wrote the Results to %s", outPath);
+
+    if (baseline)
+    {
+        CAKEZ_TRACE("%u Benchmarks regressed by more than %.1f%% against %s", regressionCount, threshold, baselinePath);
+    }
+
+#ifdef ALLOC_GUARD
+    CAKEZ_TRACE("%u Benchmarks allocated outside of the Arenas", allocatingCount);
+#endif
+
+    return regressionCount || allocatingCount ? 1 : 0;
+}
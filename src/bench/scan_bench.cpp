@@ -0,0 +1,182 @@
+// Defines
+#include "defines.h"
+
+// Logger
+#include "logger.h"
+
+// Memory
+#include "memory.h"
+
+// Platform layer, without a Window
+#include <windows.h>
+#include "platform/win32_services.cpp"
+
+// Standard Library
+#include <emmintrin.h>
+#include <intrin.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Compares scanning a big buffer backed by regular pages with one backed
+ * by large pages. A sequential scan is mostly limited by memory bandwidth,
+ * random reads are where TLB misses show.
+ *
+ * Usage: scan_bench [--size <MB>]
+ * The default is 2 GB. Large pages need the "Lock pages in memory" right,
+ * without it only regular pages are measured.
+ */
+
+u32 constexpr SCAN_BENCH_LINE_LENGTH = 64;
+u32 constexpr SCAN_BENCH_SCAN_RUNS = 3;
+u32 constexpr SCAN_BENCH_RANDOM_READS = 1 << 24;
+u64 constexpr SCAN_BENCH_DEFAULT_SIZE = GB(2);
+
+struct ScanBenchResult
+{
+    float fillSeconds;
+    float scanGigabytesPerSecond;
+    float randomReadNanoseconds;
+    u64 checksum;
+};
+
+internal float get_seconds_since(u64 startTicks)
+{
+    u64 elapsedTicks = platform_get_performance_tick_count() - startTicks;
+    return (float)((double)elapsedTicks / (double)platform_get_performance_tick_frequency());
+}
+
+// Counts lines 16 bytes at a time, like a search over the whole text would
+internal u64 scan_count_newlines(u8 *buffer, u64 size)
+{
+    __m128i newline = _mm_set1_epi8('\n');
+    u64 count = 0;
+
+    u64 at = 0;
+    for (; at + 16 <= size; at += 16)
+    {
+        __m128i chunk = _mm_loadu_si128((__m128i *)(buffer + at));
+        u32 mask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+        count += __popcnt(mask);
+    }
+
+    for (; at < size; at++)
+    {
+        count += buffer[at] == '\n';
+    }
+
+    return count;
+}
+
+// Every read lands on a random page, like lookups in a large index
+internal u64 scan_random_reads(u8 *buffer, u64 size, u32 readCount)
+{
+    u64 state = 0x9E3779B97F4A7C15;
+    u64 sum = 0;
+    for (u32 readIdx = 0; readIdx < readCount; readIdx++)
+    {
+        // xorshift64
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+
+        u64 offset = (state % (size - sizeof(u64))) & ~(u64)(sizeof(u64) - 1);
+        u64 value;
+        memcpy(&value, buffer + offset, sizeof(u64));
+        sum += value;
+    }
+
+    return sum;
+}
+
+internal void scan_bench_run(u8 *buffer, u64 size, ScanBenchResult *result)
+{
+    // The first touch of every page is part of the fill
+    u64 startTicks = platform_get_performance_tick_count();
+    memset(buffer, 'a', size);
+    for (u64 at = SCAN_BENCH_LINE_LENGTH - 1; at < size; at += SCAN_BENCH_LINE_LENGTH)
+    {
+        buffer[at] = '\n';
+    }
+    result->fillSeconds = get_seconds_since(startTicks);
+
+    float bestSeconds = 0.0f;
+    for (u32 run = 0; run < SCAN_BENCH_SCAN_RUNS; run++)
+    {
+        startTicks = platform_get_performance_tick_count();
+        result->checksum = scan_count_newlines(buffer, size);
+        float seconds = get_seconds_since(startTicks);
+        bestSeconds = !run || seconds < bestSeconds ? seconds : bestSeconds;
+    }
+    result->scanGigabytesPerSecond = (float)((double)size / GB(1) / bestSeconds);
+
+    startTicks = platform_get_performance_tick_count();
+    result->checksum += scan_random_reads(buffer, size, SCAN_BENCH_RANDOM_READS);
+    result->randomReadNanoseconds = get_seconds_since(startTicks) * 1e9f / SCAN_BENCH_RANDOM_READS;
+}
+
+/**
+ * Fills and scans a buffer of size bytes, once with regular pages and once
+ * with large pages if the system allows them, and logs both.
+ * @return false if the memory could not be allocated
+ */
+bool run_scan_bench(u64 size)
+{
+    ScanBenchResult results[2] = {};
+    char *names[2] = {"Regular Pages", "Large Pages"};
+
+    for (u32 largePages = 0; largePages < 2; largePages++)
+    {
+        GameMemory memory;
+        bool success = largePages ? init_large_page_memory(&memory, size + MEMORY_COMMIT_SIZE)
+                                  : init_reserved_memory(&memory, size + MEMORY_COMMIT_SIZE);
+        if (success && largePages && !memory.hasLargePages)
+        {
+            CAKEZ_WARN("Large Pages are not available, only Regular Pages were measured");
+            release_memory(&memory);
+            break;
+        }
+
+        u8 *buffer = success ? allocate_memory(&memory, size, MEMORY_TAG_NONE) : 0;
+        if (!buffer)
+        {
+            CAKEZ_FATAL("Failed to allocate %llu MB for the Scan Benchmark", size / MB(1));
+            return false;
+        }
+
+        ScanBenchResult *result = &results[largePages];
+        scan_bench_run(buffer, size, result);
+        release_memory(&memory);
+
+        CAKEZ_TRACE("%-13s fill %6.2f s, scan %6.2f GB/s, random read %6.2f ns (checksum %llu)",
+                    names[largePages], result->fillSeconds, result->scanGigabytesPerSecond,
+                    result->randomReadNanoseconds, result->checksum);
+    }
+
+    if (results[1].scanGigabytesPerSecond > 0.0f)
+    {
+        CAKEZ_TRACE("Large Pages: scan %.2fx, random read %.2fx, fill %.2fx as fast",
+                    results[1].scanGigabytesPerSecond / results[0].scanGigabytesPerSecond,
+                    results[0].randomReadNanoseconds / results[1].randomReadNanoseconds,
+                    results[0].fillSeconds / results[1].fillSeconds);
+    }
+
+    return true;
+}
+
+s32 main(s32 argc, char **argv)
+{
+    log_start_thread();
+
+    u64 size = SCAN_BENCH_DEFAULT_SIZE;
+    for (s32 argIdx = 1; argIdx < argc; argIdx++)
+    {
+        if (!strcmp(argv[argIdx], "--size") && argIdx + 1 < argc)
+        {
+            s32 megabytes = atoi(argv[++argIdx]);
+            size = megabytes > 0 ? MB((u64)megabytes) : size;
+        }
+    }
+
+    return run_scan_bench(size) ? 0 : -1;
+}
@@ -43,6 +43,8 @@ typedef size_t memory_index;
 #define MB(x) ((uint64_t)1024 * KB(x))
 #define GB(x) ((uint64_t)1024 * MB(x))
 
+#define MAX_PATH_LENGTH 260
+
 #define U32_ERROR UINT32_MAX
 #define INVALID_IDX UINT32_MAX
 
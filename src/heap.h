@@ -0,0 +1,349 @@
+#pragma once
+
+#include "defines.h"
+#include "logger.h"
+#include "memory.h"
+
+#include <intrin.h>
+
+/*
+ * Two Level Segregated Fit Allocator, for blocks of any size that are freed
+ * one by one. Free blocks are kept in lists by size class: the first level
+ * is the power of two of the size, the second level splits every power of
+ * two into HEAP_SL_COUNT linear steps. Two bitmaps tell which lists have
+ * blocks, so alloc and free are O(1). Freed blocks are merged with their
+ * free neighbours right away, which keeps fragmentation bounded.
+ *
+ * The Heap manages Regions carved from a GameMemory and carves a new one
+ * when no free block is large enough. Not thread safe.
+ */
+
+u64 constexpr HEAP_ALIGNMENT = 8;
+u32 constexpr HEAP_SL_COUNT_LOG2 = 5;
+u32 constexpr HEAP_SL_COUNT = 1 << HEAP_SL_COUNT_LOG2;
+
+// Sizes below this all live in the first level, in steps of HEAP_ALIGNMENT
+u32 constexpr HEAP_FL_SHIFT = HEAP_SL_COUNT_LOG2 + 3;
+u64 constexpr HEAP_SMALL_BLOCK_SIZE = 1 << HEAP_FL_SHIFT;
+
+// Blocks up to 4 GB
+u32 constexpr HEAP_FL_MAX = 32;
+u32 constexpr HEAP_FL_COUNT = HEAP_FL_MAX - HEAP_FL_SHIFT + 1;
+
+u64 constexpr HEAP_BLOCK_FREE_BIT = BIT(0);
+u64 constexpr HEAP_BLOCK_PREV_FREE_BIT = BIT(1);
+
+struct HeapBlock
+{
+    // Only valid if the previous block is free, lies in the last bytes of the previous block
+    HeapBlock *prevPhysical;
+
+    // Size of the usable memory, the low bits are flags
+    u64 size;
+
+    // Only valid while the block is free, otherwise this is where the allocation starts
+    HeapBlock *nextFree;
+    HeapBlock *prevFree;
+};
+
+// Only the size is stored in front of an allocation
+u64 constexpr HEAP_BLOCK_OVERHEAD = sizeof(u64);
+u64 constexpr HEAP_BLOCK_START_OFFSET = sizeof(HeapBlock *) + sizeof(u64);
+u64 constexpr HEAP_MIN_BLOCK_SIZE = sizeof(HeapBlock) - sizeof(HeapBlock *);
+u64 constexpr HEAP_MAX_BLOCK_SIZE = (u64)1 << HEAP_FL_MAX;
+
+struct Heap
+{
+    GameMemory *gameMemory;
+    u64 regionSize;
+    MemoryTag tag;
+
+    u32 flBitmap;
+    u32 slBitmaps[HEAP_FL_COUNT];
+    HeapBlock *freeLists[HEAP_FL_COUNT][HEAP_SL_COUNT];
+
+    u32 regionCount;
+    u64 regionBytes;
+    u64 allocatedBytes;
+};
+
+internal u32 heap_find_last_set(u64 value)
+{
+    unsigned long idx;
+    _BitScanReverse64(&idx, value);
+    return idx;
+}
+
+internal u32 heap_find_first_set(u32 value)
+{
+    unsigned long idx;
+    _BitScanForward(&idx, value);
+    return idx;
+}
+
+internal u64 heap_block_size(HeapBlock *block)
+{
+    return block->size & ~(HEAP_BLOCK_FREE_BIT | HEAP_BLOCK_PREV_FREE_BIT);
+}
+
+internal u8 *heap_block_to_memory(HeapBlock *block)
+{
+    return (u8 *)block + HEAP_BLOCK_START_OFFSET;
+}
+
+internal HeapBlock *heap_memory_to_block(void *memory)
+{
+    return (HeapBlock *)((u8 *)memory - HEAP_BLOCK_START_OFFSET);
+}
+
+internal HeapBlock *heap_block_next(HeapBlock *block)
+{
+    return (HeapBlock *)(heap_block_to_memory(block) + heap_block_size(block) - HEAP_BLOCK_OVERHEAD);
+}
+
+// Tells the next block where this one starts, needed to merge with it once it is freed
+internal HeapBlock *heap_block_link_next(HeapBlock *block)
+{
+    HeapBlock *next = heap_block_next(block);
+    next->prevPhysical = block;
+    return next;
+}
+
+internal void heap_block_mark_free(HeapBlock *block)
+{
+    HeapBlock *next = heap_block_link_next(block);
+    next->size |= HEAP_BLOCK_PREV_FREE_BIT;
+    block->size |= HEAP_BLOCK_FREE_BIT;
+}
+
+internal void heap_block_mark_used(HeapBlock *block)
+{
+    HeapBlock *next = heap_block_next(block);
+    next->size &= ~HEAP_BLOCK_PREV_FREE_BIT;
+    block->size &= ~HEAP_BLOCK_FREE_BIT;
+}
+
+internal void heap_mapping_insert(u64 size, u32 *fl, u32 *sl)
+{
+    if (size < HEAP_SMALL_BLOCK_SIZE)
+    {
+        *fl = 0;
+        *sl = (u32)(size / (HEAP_SMALL_BLOCK_SIZE / HEAP_SL_COUNT));
+    }
+    else
+    {
+        u32 lastSet = heap_find_last_set(size);
+        *sl = (u32)(size >> (lastSet - HEAP_SL_COUNT_LOG2)) ^ HEAP_SL_COUNT;
+        *fl = lastSet - (HEAP_FL_SHIFT - 1);
+    }
+}
+
+// Rounds up to the next list, so every block in it is large enough
+internal void heap_mapping_search(u64 size, u32 *fl, u32 *sl)
+{
+    if (size >= HEAP_SMALL_BLOCK_SIZE)
+    {
+        size += ((u64)1 << (heap_find_last_set(size) - HEAP_SL_COUNT_LOG2)) - 1;
+    }
+    heap_mapping_insert(size, fl, sl);
+}
+
+internal void heap_remove_free_block(Heap *heap, HeapBlock *block, u32 fl, u32 sl)
+{
+    HeapBlock *prev = block->prevFree;
+    HeapBlock *next = block->nextFree;
+    if (next)
+    {
+        next->prevFree = prev;
+    }
+    if (prev)
+    {
+        prev->nextFree = next;
+    }
+
+    if (heap->freeLists[fl][sl] == block)
+    {
+        heap->freeLists[fl][sl] = next;
+        if (!next)
+        {
+            heap->slBitmaps[fl] &= ~BIT(sl);
+            if (!heap->slBitmaps[fl])
+            {
+                heap->flBitmap &= ~BIT(fl);
+            }
+        }
+    }
+}
+
+internal void heap_insert_free_block(Heap *heap, HeapBlock *block)
+{
+    u32 fl, sl;
+    heap_mapping_insert(heap_block_size(block), &fl, &sl);
+
+    HeapBlock *head = heap->freeLists[fl][sl];
+    block->nextFree = head;
+    block->prevFree = 0;
+    if (head)
+    {
+        head->prevFree = block;
+    }
+
+    heap->freeLists[fl][sl] = block;
+    heap->flBitmap |= BIT(fl);
+    heap->slBitmaps[fl] |= BIT(sl);
+}
+
+internal void heap_remove_block(Heap *heap, HeapBlock *block)
+{
+    u32 fl, sl;
+    heap_mapping_insert(heap_block_size(block), &fl, &sl);
+    heap_remove_free_block(heap, block, fl, sl);
+}
+
+internal HeapBlock *heap_find_free_block(Heap *heap, u64 size)
+{
+    u32 fl, sl;
+    heap_mapping_search(size, &fl, &sl);
+    if (fl >= HEAP_FL_COUNT)
+    {
+        return 0;
+    }
+
+    // A list of this first level with larger blocks, otherwise the next larger first level
+    u32 slMap = heap->slBitmaps[fl] & (~0u << sl);
+    if (!slMap)
+    {
+        u32 flMap = fl + 1 < 32 ? heap->flBitmap & (~0u << (fl + 1)) : 0;
+        if (!flMap)
+        {
+            return 0;
+        }
+
+        fl = heap_find_first_set(flMap);
+        slMap = heap->slBitmaps[fl];
+    }
+    sl = heap_find_first_set(slMap);
+
+    HeapBlock *block = heap->freeLists[fl][sl];
+    heap_remove_free_block(heap, block, fl, sl);
+    return block;
+}
+
+internal bool heap_add_region(Heap *heap, u64 size)
+{
+    // The Region holds one free block and a zero sized block that ends it
+    size = (size + HEAP_ALIGNMENT - 1) & ~(HEAP_ALIGNMENT - 1);
+    u8 *memory = allocate_memory(heap->gameMemory, size, heap->tag, HEAP_ALIGNMENT);
+    if (!memory)
+    {
+        return false;
+    }
+
+    // The prevPhysical of the first block would be in front of the Region, it is never used
+    HeapBlock *block = (HeapBlock *)(memory - sizeof(HeapBlock *));
+    block->size = size - 2 * HEAP_BLOCK_OVERHEAD;
+    block->size |= HEAP_BLOCK_FREE_BIT;
+    heap_insert_free_block(heap, block);
+
+    HeapBlock *sentinel = heap_block_link_next(block);
+    sentinel->size = HEAP_BLOCK_PREV_FREE_BIT;
+
+    heap->regionCount++;
+    heap->regionBytes += size;
+    return true;
+}
+
+/**
+ * @param regionSize Size of the Regions that are carved from gameMemory,
+ * larger allocations get a Region of their own
+ */
+void heap_init(Heap *heap, GameMemory *gameMemory, u64 regionSize, MemoryTag tag = MEMORY_TAG_HEAP)
+{
+    *heap = {};
+    heap->gameMemory = gameMemory;
+    heap->regionSize = regionSize;
+    heap->tag = tag;
+}
+
+/**
+ * @return Memory aligned to HEAP_ALIGNMENT, or 0 if the Game Memory is full
+ */
+void *heap_alloc(Heap *heap, u64 size)
+{
+#ifdef ALLOC_GUARD
+    alloc_guard_on_allocation("Heap", size);
+#endif
+
+    if (!size || size >= HEAP_MAX_BLOCK_SIZE / 2)
+    {
+        return 0;
+    }
+
+    size = (size + HEAP_ALIGNMENT - 1) & ~(HEAP_ALIGNMENT - 1);
+    size = size < HEAP_MIN_BLOCK_SIZE ? HEAP_MIN_BLOCK_SIZE : size;
+
+    HeapBlock *block = heap_find_free_block(heap, size);
+    if (!block)
+    {
+        // The search rounds up to the next list, the Region needs room for that too
+        u64 searchSize = size >= HEAP_SMALL_BLOCK_SIZE ? size + (size >> HEAP_SL_COUNT_LOG2) : size;
+        u64 regionSize = searchSize + 2 * HEAP_BLOCK_OVERHEAD;
+        regionSize = regionSize > heap->regionSize ? regionSize : heap->regionSize;
+        if (!heap_add_region(heap, regionSize))
+        {
+            return 0;
+        }
+
+        block = heap_find_free_block(heap, size);
+        CAKEZ_ASSERT(block, "New Heap Region has no block of %llu bytes", size);
+    }
+
+    // Give the rest back, if it is large enough to be a block
+    u64 blockSize = heap_block_size(block);
+    if (blockSize >= size + sizeof(HeapBlock))
+    {
+        HeapBlock *rest = (HeapBlock *)(heap_block_to_memory(block) + size - HEAP_BLOCK_OVERHEAD);
+        rest->size = blockSize - size - HEAP_BLOCK_OVERHEAD;
+        block->size = size | (block->size & HEAP_BLOCK_PREV_FREE_BIT);
+        heap_block_mark_free(rest);
+        heap_insert_free_block(heap, rest);
+    }
+
+    heap_block_mark_used(block);
+    heap->allocatedBytes += heap_block_size(block);
+    memory_tag_add_used(heap->tag, heap_block_size(block));
+    return heap_block_to_memory(block);
+}
+
+void heap_free(Heap *heap, void *memory)
+{
+    if (!memory)
+    {
+        return;
+    }
+
+    HeapBlock *block = heap_memory_to_block(memory);
+    CAKEZ_ASSERT(!(block->size & HEAP_BLOCK_FREE_BIT), "Heap Block is freed twice");
+    heap->allocatedBytes -= heap_block_size(block);
+    memory_tag_remove_used(heap->tag, heap_block_size(block));
+    heap_block_mark_free(block);
+
+    if (block->size & HEAP_BLOCK_PREV_FREE_BIT)
+    {
+        HeapBlock *prev = block->prevPhysical;
+        heap_remove_block(heap, prev);
+        prev->size += heap_block_size(block) + HEAP_BLOCK_OVERHEAD;
+        block = prev;
+        heap_block_link_next(block);
+    }
+
+    HeapBlock *next = heap_block_next(block);
+    if (next->size & HEAP_BLOCK_FREE_BIT)
+    {
+        heap_remove_block(heap, next);
+        block->size += heap_block_size(next) + HEAP_BLOCK_OVERHEAD;
+        heap_block_link_next(block);
+    }
+
+    heap_insert_free_block(heap, block);
+}
@@ -1,3 +1,6 @@
+#include "input.h"
+#include "platform.h"
+
 bool key_pressed_this_frame(InputState *input, s32 keyType)
 {
     Key *key = &input->keys[keyType];
@@ -16,4 +19,35 @@ bool key_is_down(InputState *input, s32 keyType)
 {
     Key *key = &input->keys[keyType];
     return key->keyState & KEY_STATE_DOWN;
-}
\ No newline at end of file
+}
+
+bool input_push_event(InputState *input, InputEvent *event)
+{
+    u32 writeIdx = input->eventWriteIdx;
+    if (writeIdx - input->eventReadIdx == MAX_INPUT_EVENTS)
+    {
+        input->droppedEventCount++;
+        return false;
+    }
+
+    input->events[writeIdx % MAX_INPUT_EVENTS] = *event;
+
+    // Publish the event only after it is written
+    platform_atomic_exchange(&input->eventWriteIdx, writeIdx + 1);
+    return true;
+}
+
+bool input_pop_event(InputState *input, InputEvent *event)
+{
+    u32 readIdx = input->eventReadIdx;
+    if (readIdx == input->eventWriteIdx)
+    {
+        return false;
+    }
+
+    *event = input->events[readIdx % MAX_INPUT_EVENTS];
+
+    // The slot can be reused once the event is copied out
+    platform_atomic_exchange(&input->eventReadIdx, readIdx + 1);
+    return true;
+}
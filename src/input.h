@@ -9,6 +9,51 @@ enum KeyState : u8
     KEY_STATE_DOWN
 };
 
+u32 constexpr MAX_INPUT_EVENTS = 1024;
+
+enum InputEventType : u8
+{
+    INPUT_EVENT_KEY_DOWN,
+    INPUT_EVENT_KEY_UP,
+    INPUT_EVENT_CHAR,
+    INPUT_EVENT_MOUSE_MOVE,
+    INPUT_EVENT_MOUSE_BUTTON_DOWN,
+    INPUT_EVENT_MOUSE_BUTTON_UP,
+    INPUT_EVENT_MOUSE_WHEEL,
+};
+
+enum InputModifier : u8
+{
+    INPUT_MODIFIER_CONTROL = BIT(0),
+    INPUT_MODIFIER_SHIFT = BIT(1),
+    INPUT_MODIFIER_ALT = BIT(2),
+};
+
+enum MouseButton : u8
+{
+    MOUSE_BUTTON_LEFT,
+    MOUSE_BUTTON_RIGHT,
+    MOUSE_BUTTON_MIDDLE,
+};
+
+struct InputEvent
+{
+    // platform_get_performance_tick_count when the event arrived
+    u64 timestamp;
+
+    InputEventType type;
+
+    // InputModifier flags at the time of the event
+    u8 modifiers;
+
+    // Virtual Key for key events, MouseButton for mouse button events
+    u8 key;
+
+    u32 codepoint;
+    s32 wheelDelta;
+    Vec2 mousePos;
+};
+
 struct Key
 {
     u8 halfTransitionCount;
@@ -25,9 +70,34 @@ struct InputState
 
     s32 wheelDelta;
     Key keys[255];
+
+    // Keys with a halfTransitionCount, so only those get reset every frame
+    u32 changedKeyCount;
+    u8 changedKeys[255];
+
+    // Single producer (window callback), single consumer (app) ring,
+    // the indices only ever grow and wrap around at U32_MAX
+    u32 volatile eventWriteIdx;
+    u32 volatile eventReadIdx;
+    u32 droppedEventCount;
+    InputEvent events[MAX_INPUT_EVENTS];
 };
 
 // TODO: Think about how to handle keys and actions
 bool key_pressed_this_frame(InputState *input, s32 keyType);
 bool key_released_this_frame(InputState *input, s32 keyType);
-bool key_is_down(InputState *input, s32 keyType);
\ No newline at end of file
+bool key_is_down(InputState *input, s32 keyType);
+
+/**
+ * Adds an event to the end of the queue, the event is dropped if the
+ * queue is full.
+ * @return false if the event was dropped
+ */
+bool input_push_event(InputState *input, InputEvent *event);
+
+/**
+ * Takes the oldest event out of the queue, events come out in the
+ * order they were pushed.
+ * @return false if there are no events
+ */
+bool input_pop_event(InputState *input, InputEvent *event);
\ No newline at end of file
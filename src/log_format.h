@@ -0,0 +1,51 @@
+#pragma once
+
+#include "defines.h"
+
+// Log Levels, calls below LOG_MIN_LEVEL compile to nothing
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_WARN 1
+#define LOG_LEVEL_ERROR 2
+#define LOG_LEVEL_FATAL 3
+
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_TRACE
+#endif
+
+global_variable char *logLevelNames[] = {"TRACE", "WARN", "ERROR", "FATAL"};
+
+/*
+ * Binary Log File, written by the log thread after log_open_binary_file
+ * and turned back into text by tools/log_decoder.cpp.
+ *
+ * File Layout:
+ * u32 magic, u32 version
+ * Records until the end of the file:
+ *   Format:  u8 LOG_RECORD_FORMAT, u16 formatId, u8 level, char argTypes[], char format[]
+ *   Message: u8 LOG_RECORD_MESSAGE, u16 formatId, u16 argsSize, u8 args[argsSize]
+ *
+ * Both strings of a Format are null terminated, it comes before the first
+ * Message that uses it. argTypes has one LogArgType per argument. The
+ * arguments are packed as they are in memory, strings are null terminated.
+ */
+
+u32 constexpr LOG_FILE_MAGIC = FOURCC("CLOG");
+u32 constexpr LOG_FILE_VERSION = 1;
+u32 constexpr LOG_MAX_FORMATS = 4096;
+
+enum LogRecordType : u8
+{
+    LOG_RECORD_FORMAT,
+    LOG_RECORD_MESSAGE,
+};
+
+enum LogArgType : char
+{
+    LOG_ARG_INT8 = 'b',
+    LOG_ARG_INT16 = 'h',
+    LOG_ARG_INT32 = 'i',
+    LOG_ARG_INT64 = 'l',
+    LOG_ARG_FLOAT = 'f',
+    LOG_ARG_DOUBLE = 'd',
+    LOG_ARG_STRING = 's',
+};
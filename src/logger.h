@@ -1,33 +1,614 @@
 #pragma once
 
+#include "log_format.h"
 #include "platform.h"
 
-// Standard Library for sprs32f
+// Standard Library for snprintf
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+/*
+ * A log call doesn't format anything, it copies the arguments into an entry
+ * of a ring buffer and returns. The log thread formats the entries and writes
+ * them to the console, in the order they were added by any thread. Only the
+ * pointer to the format string is kept, so it has to be a string literal.
+ * String arguments are copied, so the caller may reuse them right after the call.
+ *
+ * Until log_start_thread is called the entries are written right away,
+ * by the thread that adds them.
+ *
+ * After log_open_binary_file the entries go to that file instead of the
+ * console, without being formatted. Errors are written to both.
+ */
+
+u32 constexpr LOG_RING_SIZE = 1024;
+u32 constexpr LOG_BATCH_SIZE = 64;
+u32 constexpr LOG_ENTRY_SIZE = 512;
+u32 constexpr LOG_PAYLOAD_SIZE = LOG_ENTRY_SIZE - 3 * sizeof(u32) - 3 * sizeof(void *);
+u32 constexpr LOG_MAX_MESSAGE_LENGTH = KB(4);
+u32 constexpr LOG_FILE_BUFFER_SIZE = KB(64);
+u32 constexpr LOG_FORMAT_TABLE_SIZE = 2 * LOG_MAX_FORMATS;
+
+global_variable TextColor logLevelColors[] =
+    {
+        TEXT_COLOR_GREEN,
+        TEXT_COLOR_YELLOW,
+        TEXT_COLOR_RED,
+        TEXT_COLOR_LIGHT_RED,
+};
+
+struct LogEntry;
+typedef u32 LogFormatFunction(LogEntry *entry, char *buffer, u32 size);
+
+struct LogEntry
+{
+    // Says if the entry is free or written in the current lap of the ring, see log_begin_entry
+    u32 volatile sequence;
+    u32 level;
+    u32 payloadSize;
+
+    // A string literal, it outlives the entry
+    char *message;
+
+    // Both know the types of the arguments in the payload
+    LogFormatFunction *format;
+    char *argTypes;
+
+    // The arguments, strings get cut off if they don't fit
+    u8 payload[LOG_PAYLOAD_SIZE];
+};
+
+struct LogRing
+{
+    // Claimed by the threads that log
+    u32 volatile writeIdx;
+
+    // Only advanced by the thread that writes, the entries before it are free again
+    u32 volatile readIdx;
+
+    // The entries before it reached the console or the Log File
+    u32 volatile writtenIdx;
+
+    // Claimed by the thread that writes, it owns the batch, the messageBuffer and the Log File
+    u32 volatile isWriting;
+
+    bool hasThread;
+    u32 volatile isThreadWaiting;
+
+    char messageBuffer[LOG_MAX_MESSAGE_LENGTH];
+
+    // Entries are copied out of the ring before they are written, so the
+    // threads that wait for room don't wait for the console or the file
+    LogEntry batch[LOG_BATCH_SIZE];
+    LogEntry entries[LOG_RING_SIZE];
+};
+
+global_variable LogRing logRing;
+
+// The same literal can be logged with other arguments or at another level, each of those gets its own id
+struct LogFormatKey
+{
+    char *message;
+    char *argTypes;
+    u32 level;
+};
+
+struct LogFile
+{
+    // Stays open, false once a write failed
+    bool isOpen;
+    void *file;
+
+    // Open addressing, keyed by the level and the pointers to the argument types and the format string
+    u32 formatCount;
+    LogFormatKey formatKeys[LOG_FORMAT_TABLE_SIZE];
+    u16 formatIds[LOG_FORMAT_TABLE_SIZE];
+
+    u32 bufferLength;
+    u8 buffer[LOG_FILE_BUFFER_SIZE];
+};
+
+global_variable LogFile logFile;
+
+internal u32 log_write_string(u8 *at, u32 space, char *string)
+{
+    string = string ? string : (char *)"(null)";
+    u32 length = (u32)strnlen(string, space - 1);
+    memcpy(at, string, length);
+    at[length] = 0;
+    return length + 1;
+}
+
+internal char *log_read_string(u8 **at)
+{
+    char *string = (char *)*at;
+    *at += strlen(string) + 1;
+    return string;
+}
+
+template <typename T>
+constexpr char log_arg_type(T *)
+{
+    // Integers, enums and pointers
+    return sizeof(T) == 8 ? LOG_ARG_INT64 : sizeof(T) == 4 ? LOG_ARG_INT32
+                                        : sizeof(T) == 2   ? LOG_ARG_INT16
+                                                           : LOG_ARG_INT8;
+}
+
+constexpr char log_arg_type(float *)
+{
+    return LOG_ARG_FLOAT;
+}
+
+constexpr char log_arg_type(double *)
+{
+    return LOG_ARG_DOUBLE;
+}
+
+// Values are copied as they are, strings are copied into the entry
+template <typename T>
+struct LogArg
+{
+    static u32 constexpr fixedSize = sizeof(T);
+    static char constexpr type = log_arg_type((T *)0);
+
+    static u32 write(u8 *at, u32 space, T value)
+    {
+        memcpy(at, &value, sizeof(T));
+        return sizeof(T);
+    }
+
+    static T read(u8 **at)
+    {
+        T value;
+        memcpy(&value, *at, sizeof(T));
+        *at += sizeof(T);
+        return value;
+    }
+};
+
+template <typename String>
+struct LogStringArg
+{
+    static u32 constexpr fixedSize = 0;
+    static char constexpr type = LOG_ARG_STRING;
+
+    static u32 write(u8 *at, u32 space, String value)
+    {
+        return log_write_string(at, space, (char *)value);
+    }
+
+    static String read(u8 **at)
+    {
+        return (String)log_read_string(at);
+    }
+};
+
+template <>
+struct LogArg<char *> : LogStringArg<char *>
+{
+};
+
+template <>
+struct LogArg<const char *> : LogStringArg<const char *>
+{
+};
+
+template <>
+struct LogArg<u8 *> : LogStringArg<u8 *>
+{
+};
+
+template <typename... Args>
+struct LogArgTypes
+{
+    static constexpr char types[] = {LogArg<Args>::type..., 0};
+};
+
+// Room the arguments need at least, every string needs one byte for the terminator
+template <typename... Args>
+constexpr u32 log_reserved_size()
+{
+    return (LogArg<Args>::fixedSize + ... + 0) + sizeof...(Args);
+}
+
+inline u32 log_write_args(u8 *payload, u32 used)
+{
+    return used;
+}
+
+template <typename First, typename... Rest>
+u32 log_write_args(u8 *payload, u32 used, First first, Rest... rest)
+{
+    // Later arguments keep their room, only strings get cut off
+    u32 space = LOG_PAYLOAD_SIZE - used - log_reserved_size<Rest...>();
+    used += LogArg<First>::write(payload + used, space, first);
+    return log_write_args(payload, used, rest...);
+}
+
+// Reads the arguments one after another, they have to be passed to snprintf all at once
+template <typename... Remaining>
+struct LogFormatter
+{
+    template <typename... Values>
+    static s32 format(char *buffer, u32 size, char *format, u8 *at, Values... values)
+    {
+        return snprintf(buffer, size, format, values...);
+    }
+};
+
+template <typename First, typename... Rest>
+struct LogFormatter<First, Rest...>
+{
+    template <typename... Values>
+    static s32 format(char *buffer, u32 size, char *format, u8 *at, Values... values)
+    {
+        First value = LogArg<First>::read(&at);
+        return LogFormatter<Rest...>::format(buffer, size, format, at, values..., value);
+    }
+};
+
+/**
+ * @return The length of the message written to buffer
+ */
+template <typename... Args>
+u32 log_format_entry(LogEntry *entry, char *buffer, u32 size)
+{
+    s32 length = LogFormatter<Args...>::format(buffer, size, entry->message, entry->payload);
+    return length < 0 ? 0 : ((u32)length < size ? length : size - 1);
+}
+
+internal bool log_has_pending_entries()
+{
+    u32 readIdx = logRing.readIdx;
+    LogEntry *entry = &logRing.entries[readIdx % LOG_RING_SIZE];
+    return entry->sequence == (readIdx & ~(LOG_RING_SIZE - 1)) + 1;
+}
+
+internal void log_flush_file()
+{
+    if (logFile.bufferLength)
+    {
+        if (logFile.isOpen &&
+            platform_append_file(logFile.file, (char *)logFile.buffer, logFile.bufferLength) != logFile.bufferLength)
+        {
+            // Logging it would end up here again, the entries after it go to the console
+            platform_log("ERROR: Failed writing to the Log File, the log goes to the console again\n",
+                         logLevelColors[LOG_LEVEL_ERROR]);
+            logFile.isOpen = false;
+        }
+        logFile.bufferLength = 0;
+    }
+}
+
+internal u8 *log_push_file_bytes(u32 size)
+{
+    if (logFile.bufferLength + size > LOG_FILE_BUFFER_SIZE)
+    {
+        log_flush_file();
+    }
+
+    u8 *at = logFile.buffer + logFile.bufferLength;
+    logFile.bufferLength += size;
+    return at;
+}
+
+/**
+ * Writes a Format record the first time a format is used.
+ * @return The id of the format or LOG_MAX_FORMATS if there are too many
+ */
+internal u32 log_get_format_id(LogEntry *entry)
+{
+    // Mixes the pointers, their low bits are the same for every aligned string
+    u64 hash = ((u64)entry->message ^ ((u64)entry->argTypes << 16) ^ entry->level) * 0x9E3779B97F4A7C15ull;
+
+    // The table is at most half full, there is always an empty slot, those have no message
+    u32 slot = (u32)(hash >> 32) % LOG_FORMAT_TABLE_SIZE;
+    while (logFile.formatKeys[slot].message)
+    {
+        LogFormatKey *key = &logFile.formatKeys[slot];
+        if (key->message == entry->message && key->argTypes == entry->argTypes && key->level == entry->level)
+        {
+            return logFile.formatIds[slot];
+        }
+        slot = (slot + 1) % LOG_FORMAT_TABLE_SIZE;
+    }
+
+    if (logFile.formatCount == LOG_MAX_FORMATS)
+    {
+        return LOG_MAX_FORMATS;
+    }
+
+    u16 formatId = (u16)logFile.formatCount++;
+    logFile.formatKeys[slot] = {entry->message, entry->argTypes, entry->level};
+    logFile.formatIds[slot] = formatId;
+
+    // Both strings including their terminators
+    u32 argTypesLength = (u32)strlen(entry->argTypes) + 1;
+    u32 formatLength = (u32)strlen(entry->message) + 1;
+    u8 *at = log_push_file_bytes(4 + argTypesLength + formatLength);
+    at[0] = LOG_RECORD_FORMAT;
+    memcpy(at + 1, &formatId, sizeof(u16));
+    at[3] = (u8)entry->level;
+    memcpy(at + 4, entry->argTypes, argTypesLength);
+    memcpy(at + 4 + argTypesLength, entry->message, formatLength);
+    return formatId;
+}
+
+/**
+ * Writes the entry as a Message record, the arguments are copied as they are.
+ * @return false if it has to be written as text
+ */
+internal bool log_write_file_entry(LogEntry *entry)
+{
+    u32 formatId = log_get_format_id(entry);
+    if (formatId == LOG_MAX_FORMATS)
+    {
+        return false;
+    }
+
+    u16 id = (u16)formatId;
+    u16 argsSize = (u16)entry->payloadSize;
+    u8 *at = log_push_file_bytes(5 + argsSize);
+    at[0] = LOG_RECORD_MESSAGE;
+    memcpy(at + 1, &id, sizeof(u16));
+    memcpy(at + 3, &argsSize, sizeof(u16));
+    memcpy(at + 5, entry->payload, argsSize);
+    return true;
+}
+
+// Only called by the thread that claimed isWriting
+internal void log_write_entry(LogEntry *entry)
+{
+    bool isInFile = logFile.isOpen && log_write_file_entry(entry);
+    if (!isInFile || entry->level >= LOG_LEVEL_ERROR)
+    {
+        // Keep room for the line break and the terminator
+        char *buffer = logRing.messageBuffer;
+        u32 length = snprintf(buffer, LOG_MAX_MESSAGE_LENGTH, "%s: ", logLevelNames[entry->level]);
+        length += entry->format(entry, buffer + length, LOG_MAX_MESSAGE_LENGTH - length - 1);
+        buffer[length++] = '\n';
+        buffer[length] = 0;
+        platform_log(buffer, logLevelColors[entry->level]);
+    }
+}
+
+/**
+ * Takes the entries that are done out of the ring and writes them, stops at
+ * the first one that is still being written. Only one thread writes at a time,
+ * the others return right away instead of waiting for the console or the file.
+ * @return false if there was nothing to write or another thread writes
+ */
+internal bool log_write_pending_entries()
+{
+    if (platform_atomic_compare_exchange(&logRing.isWriting, 1, 0) != 0)
+    {
+        return false;
+    }
+
+    bool hasWritten = false;
+    for (;;)
+    {
+        u32 batchCount = 0;
+        while (batchCount < LOG_BATCH_SIZE && log_has_pending_entries())
+        {
+            u32 readIdx = logRing.readIdx;
+            LogEntry *entry = &logRing.entries[readIdx % LOG_RING_SIZE];
+            memcpy(&logRing.batch[batchCount++], entry, sizeof(LogEntry) - LOG_PAYLOAD_SIZE + entry->payloadSize);
+
+            // Free for the next lap
+            platform_atomic_exchange(&entry->sequence, (readIdx & ~(LOG_RING_SIZE - 1)) + LOG_RING_SIZE);
+            platform_atomic_exchange(&logRing.readIdx, readIdx + 1);
+        }
+
+        if (!batchCount)
+        {
+            break;
+        }
+
+        for (u32 batchIdx = 0; batchIdx < batchCount; batchIdx++)
+        {
+            log_write_entry(&logRing.batch[batchIdx]);
+        }
+        hasWritten = true;
+    }
+
+    if (hasWritten)
+    {
+        log_flush_file();
+        platform_atomic_exchange(&logRing.writtenIdx, logRing.readIdx);
+    }
+
+    platform_atomic_exchange(&logRing.isWriting, 0);
+    return hasWritten;
+}
+
+/*
+ * An entry at writeIdx is free if its sequence is the lap of writeIdx,
+ * the sequence becomes lap + 1 once the entry is written and lap + LOG_RING_SIZE,
+ * the next lap, once it was read. A zeroed ring starts out free.
+ */
+internal LogEntry *log_begin_entry(u32 *writeIdx)
+{
+    u32 idx = logRing.writeIdx;
+    for (;;)
+    {
+        LogEntry *entry = &logRing.entries[idx % LOG_RING_SIZE];
+        u32 lap = idx & ~(LOG_RING_SIZE - 1);
+        u32 sequence = entry->sequence;
+        if (sequence == lap)
+        {
+            u32 originalIdx = platform_atomic_compare_exchange(&logRing.writeIdx, idx + 1, idx);
+            if (originalIdx == idx)
+            {
+                *writeIdx = idx;
+                return entry;
+            }
+            idx = originalIdx;
+        }
+        else
+        {
+            // The entry from the last lap was not read yet, the ring is full, help writing it
+            if ((s32)(sequence - lap) < 0 && !log_write_pending_entries())
+            {
+                platform_yield_thread();
+            }
+            idx = logRing.writeIdx;
+        }
+    }
+}
+
+internal void log_end_entry(LogEntry *entry, u32 writeIdx)
+{
+    platform_atomic_exchange(&entry->sequence, (writeIdx & ~(LOG_RING_SIZE - 1)) + 1);
+
+    if (!logRing.hasThread)
+    {
+        log_write_pending_entries();
+    }
+    else if (logRing.isThreadWaiting && platform_atomic_exchange(&logRing.isThreadWaiting, 0))
+    {
+        platform_wake_log_thread();
+    }
+}
+
+/**
+ * Blocks until every entry that was added before the call is written,
+ * the calling thread writes them itself unless another thread is at it.
+ */
+void log_flush()
+{
+    u32 writeIdx = logRing.writeIdx;
+    while ((s32)(logRing.writtenIdx - writeIdx) < 0)
+    {
+        if (!log_write_pending_entries())
+        {
+            platform_yield_thread();
+        }
+    }
+}
+
+/**
+ * Called in a loop by the log thread.
+ * @return true if the thread should sleep until platform_wake_log_thread is called
+ */
+bool log_thread_update()
+{
+    if (log_write_pending_entries())
+    {
+        return false;
+    }
+
+    // Log calls only wake the thread once it says that it waits, look again after saying so
+    platform_atomic_exchange(&logRing.isThreadWaiting, 1);
+    if (log_has_pending_entries())
+    {
+        platform_atomic_exchange(&logRing.isThreadWaiting, 0);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Moves writing the log to its own thread, call it before other threads
+ * start to log. Entries that are left when the program exits are flushed.
+ */
+void log_start_thread()
+{
+    if (platform_start_log_thread())
+    {
+        logRing.hasThread = true;
+        atexit(log_flush);
+    }
+}
+
+template <typename... Args>
+void _log(u32 level, u8 *msg, Args... args)
+{
+    static_assert(log_reserved_size<Args...>() < LOG_PAYLOAD_SIZE / 2, "Too many Arguments for a Log Entry");
+
+    u32 writeIdx;
+    LogEntry *entry = log_begin_entry(&writeIdx);
+    entry->level = level;
+    entry->message = (char *)msg;
+    entry->format = log_format_entry<Args...>;
+    entry->argTypes = (char *)LogArgTypes<Args...>::types;
+    entry->payloadSize = log_write_args(entry->payload, 0, args...);
+
+    log_end_entry(entry, writeIdx);
+}
+
+// The program usually ends after a fatal error, so the message is written before returning
 template <typename... Args>
-void _log(u8 *prefix, TextColor color, u8 *msg, Args... args)
+void _log_and_flush(u32 level, u8 *msg, Args... args)
 {
-    char fmtBuffer[32000] = {};
-    char msgBuffer[32000] = {};
-    sprintf(fmtBuffer, "%s: %s\n", prefix, msg);
-    sprintf(msgBuffer, fmtBuffer, args...);
-    platform_log(msgBuffer, color);
+    _log(level, msg, args...);
+    log_flush();
+}
+
+/**
+ * Sends the log to a binary file from now on, it is a lot smaller than
+ * the text and nothing gets formatted. tools/log_decoder turns it back into text.
+ * @return false if the file could not be created
+ */
+bool log_open_binary_file(char *path)
+{
+    u32 header[2] = {LOG_FILE_MAGIC, LOG_FILE_VERSION};
+    void *file = platform_open_file(path, true);
+    if (!file || platform_append_file(file, (char *)header, sizeof(header)) != sizeof(header))
+    {
+        if (file)
+        {
+            platform_close_file(file);
+        }
+        _log(LOG_LEVEL_WARN, (u8 *)"Failed to create the Log File %s", path);
+        return false;
+    }
+
+    // The file stays open for the thread that writes, hand it over between two batches
+    while (platform_atomic_compare_exchange(&logRing.isWriting, 1, 0) != 0)
+    {
+        platform_yield_thread();
+    }
+    logFile.file = file;
+    logFile.isOpen = true;
+    platform_atomic_exchange(&logRing.isWriting, 0);
+
+    return true;
 }
 
-#define CAKEZ_TRACE(msg, ...) _log((u8*)"TRACE", TEXT_COLOR_GREEN, (u8*)msg, __VA_ARGS__)
-#define CAKEZ_WARN(msg, ...) _log((u8*)"WARN", TEXT_COLOR_YELLOW, (u8*)msg, __VA_ARGS__)
-#define CAKEZ_ERROR(msg, ...) _log((u8*)"ERROR", TEXT_COLOR_RED, (u8*)msg, __VA_ARGS__)
-#define CAKEZ_FATAL(msg, ...) _log((u8*)"FATAL", TEXT_COLOR_LIGHT_RED, (u8*)msg, __VA_ARGS__)
+// Set LOG_MIN_LEVEL to leave out the calls below it, their arguments are not evaluated
+#if LOG_MIN_LEVEL <= LOG_LEVEL_TRACE
+#define CAKEZ_TRACE(msg, ...) _log(LOG_LEVEL_TRACE, (u8*)msg, __VA_ARGS__)
+#else
+#define CAKEZ_TRACE(msg, ...)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_WARN
+#define CAKEZ_WARN(msg, ...) _log(LOG_LEVEL_WARN, (u8*)msg, __VA_ARGS__)
+#else
+#define CAKEZ_WARN(msg, ...)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_ERROR
+#define CAKEZ_ERROR(msg, ...) _log(LOG_LEVEL_ERROR, (u8*)msg, __VA_ARGS__)
+#else
+#define CAKEZ_ERROR(msg, ...)
+#endif
+
+#define CAKEZ_FATAL(msg, ...) _log_and_flush(LOG_LEVEL_FATAL, (u8*)msg, __VA_ARGS__)
 
 #ifdef DEBUG
-#define CAKEZ_ASSERT(x, message, ...)          \
-{                                          \
-    if (!(x))                              \
-    {                                      \
-        CAKEZ_ERROR(message, __VA_ARGS__); \
-        __debugbreak();                    \
-    }                                      \
+#define CAKEZ_ASSERT(x, message, ...)                         \
+{                                                         \
+    if (!(x))                                             \
+    {                                                     \
+        _log(LOG_LEVEL_ERROR, (u8*)message, __VA_ARGS__); \
+        log_flush();                                      \
+        __debugbreak();                                   \
+    }                                                     \
 }
 #else
 #define CAKEZ_ASSERT(x, ...)
@@ -2,21 +2,209 @@
 
 #include "defines.h"
 #include "logger.h"
+#include "platform.h"
+
+#ifdef ALLOC_GUARD
+#include "alloc_guard.h"
+#endif
+
+// Every allocation is counted for a subsystem, so we can tell which one uses the memory
+#define MEMORY_TAG_LIST(TAG)      \
+    TAG(MEMORY_TAG_NONE)          \
+    TAG(MEMORY_TAG_OTHER)         \
+    TAG(MEMORY_TAG_APP)           \
+    TAG(MEMORY_TAG_INPUT)         \
+    TAG(MEMORY_TAG_TRANSIENT)     \
+    TAG(MEMORY_TAG_FRAME)         \
+    TAG(MEMORY_TAG_FILE_IO)       \
+    TAG(MEMORY_TAG_RENDERER)      \
+    TAG(MEMORY_TAG_FONT)          \
+    TAG(MEMORY_TAG_TEXT)          \
+    TAG(MEMORY_TAG_SORT)          \
+    TAG(MEMORY_TAG_WORD_INDEX)    \
+    TAG(MEMORY_TAG_FILE_FINDER)   \
+    TAG(MEMORY_TAG_SYMBOL_INDEX)  \
+    TAG(MEMORY_TAG_HEAP)          \
+    TAG(MEMORY_TAG_PROFILER)
+
+enum MemoryTag : u8
+{
+    MEMORY_TAG_LIST(GENERATE_ENUM)
+    MEMORY_TAG_COUNT
+};
+
+global_variable char *memoryTagNames[] = {MEMORY_TAG_LIST(GENERATE_STRING)};
+
+struct MemoryTagStats
+{
+    // Taken from the Game Memory, this includes Arenas, Heap Regions and Pool Slabs
+    u64 budgetBytes;
+
+    // Used inside the Arenas, Heaps and Pools of the tag
+    u64 usedBytes;
+    u64 peakUsedBytes;
+
+    u64 allocationCount;
+};
+
+// Updated without locks, a tag should only allocate from one thread at a time
+global_variable MemoryTagStats memoryTagStats[MEMORY_TAG_COUNT];
+
+// Reserved pages are committed in steps of this size, to not call into the OS for every allocation
+u64 constexpr MEMORY_COMMIT_SIZE = MB(1);
 
 struct GameMemory
 {
     u8 *memory;
-    u32 allocatedBytes;
-    u32 memorySizeInBytes;
+    u64 allocatedBytes;
+    u64 memorySizeInBytes;
+
+    // Only used by memory from init_reserved_memory, the rest is committed on the first allocation
+    bool isReserved;
+    u64 committedBytes;
+    bool hasLargePages;
+
+    // Only allocations past it count for the budget of their tag, so
+    // reusing reserved memory after end_temp_memory doesn't count twice
+    u64 peakAllocatedBytes;
+
+    // Reserved memory that is meant to grow in the frame loop, the Allocation Guard doesn't check it
+    bool growsInFrameLoop;
+
+    // Memory carved out of the Game Memory counts what is used inside of it for this tag,
+    // MEMORY_TAG_NONE if it is part of memory that is already counted
+    MemoryTag tag;
 };
 
-//TODO: Atm we can only allocate and will run out of memory
-u8 *allocate_memory(GameMemory *gameMemory, u32 sizeInBytes)
+internal void memory_tag_add_used(MemoryTag tag, u64 size)
 {
-    if (gameMemory->allocatedBytes + sizeInBytes < gameMemory->memorySizeInBytes)
+    if (tag != MEMORY_TAG_NONE)
     {
-        u8 *memory = gameMemory->memory + gameMemory->allocatedBytes;
-        gameMemory->allocatedBytes += sizeInBytes;
+        MemoryTagStats *stats = &memoryTagStats[tag];
+        stats->usedBytes += size;
+        stats->peakUsedBytes = stats->usedBytes > stats->peakUsedBytes ? stats->usedBytes : stats->peakUsedBytes;
+        stats->allocationCount++;
+    }
+}
+
+internal void memory_tag_remove_used(MemoryTag tag, u64 size)
+{
+    if (tag != MEMORY_TAG_NONE)
+    {
+        memoryTagStats[tag].usedBytes -= size;
+    }
+}
+
+/**
+ * Reserves address space without using any memory yet, allocations commit
+ * pages as they need them. Allocations never move, so the reservation
+ * can be a lot larger than what is ever used.
+ * @param growsInFrameLoop For memory that grows with what the user does, like the text
+ * @return false if the address space could not be reserved
+ */
+bool init_reserved_memory(GameMemory *gameMemory, u64 reserveBytes, bool growsInFrameLoop = false)
+{
+    *gameMemory = {};
+    gameMemory->memory = (u8 *)platform_reserve_memory(reserveBytes);
+    if (!gameMemory->memory)
+    {
+        return false;
+    }
+
+    gameMemory->memorySizeInBytes = reserveBytes;
+    gameMemory->isReserved = true;
+    gameMemory->growsInFrameLoop = growsInFrameLoop;
+    return true;
+}
+
+/**
+ * Like init_reserved_memory, but backs all of the memory with large pages
+ * right away if the system allows it. Use it for big buffers that get
+ * scanned as a whole. Falls back to regular pages that are committed on
+ * demand otherwise.
+ * @return false if not even the address space could be reserved
+ */
+bool init_large_page_memory(GameMemory *gameMemory, u64 sizeInBytes)
+{
+    u64 size = sizeInBytes;
+    u8 *memory = (u8 *)platform_allocate_large_pages(&size);
+    if (!memory)
+    {
+        CAKEZ_TRACE("Large Pages are not available, using regular Pages for %llu MB", sizeInBytes / MB(1));
+        return init_reserved_memory(gameMemory, sizeInBytes);
+    }
+
+    *gameMemory = {};
+    gameMemory->memory = memory;
+    gameMemory->memorySizeInBytes = size;
+    gameMemory->isReserved = true;
+    gameMemory->committedBytes = size;
+    gameMemory->hasLargePages = true;
+    return true;
+}
+
+// Only for memory from init_reserved_memory or init_large_page_memory
+void release_memory(GameMemory *gameMemory)
+{
+    platform_release_memory(gameMemory->memory);
+    *gameMemory = {};
+}
+
+/**
+ * @param tag Who the memory is for, only used for allocations from the Game Memory
+ * itself, memory carved out of it counts for its own tag
+ * @param alignment Power of two the returned address is a multiple of
+ */
+u8 *allocate_memory(GameMemory *gameMemory, u64 sizeInBytes,
+                    MemoryTag tag = MEMORY_TAG_OTHER, u64 alignment = 1)
+{
+#ifdef ALLOC_GUARD
+    // Only the Game Memory itself, Arenas carved out of it are fine
+    if (gameMemory->isReserved && !gameMemory->growsInFrameLoop)
+    {
+        alloc_guard_on_allocation("Game Memory", sizeInBytes);
+    }
+#endif
+
+    u64 address = (u64)(gameMemory->memory + gameMemory->allocatedBytes);
+    u64 padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+    u64 startBytes = gameMemory->allocatedBytes + padding;
+
+    if (startBytes + sizeInBytes < gameMemory->memorySizeInBytes)
+    {
+        u64 endBytes = startBytes + sizeInBytes;
+        if (gameMemory->isReserved && endBytes > gameMemory->committedBytes)
+        {
+            u64 commitEnd = ((endBytes + MEMORY_COMMIT_SIZE - 1) / MEMORY_COMMIT_SIZE) * MEMORY_COMMIT_SIZE;
+            commitEnd = commitEnd < gameMemory->memorySizeInBytes ? commitEnd : gameMemory->memorySizeInBytes;
+            if (!platform_commit_memory(gameMemory->memory + gameMemory->committedBytes,
+                                        commitEnd - gameMemory->committedBytes))
+            {
+                CAKEZ_ASSERT(false, "Failed to commit %llu bytes of memory", commitEnd - gameMemory->committedBytes);
+                return 0;
+            }
+            gameMemory->committedBytes = commitEnd;
+        }
+
+        if (gameMemory->isReserved)
+        {
+            u64 countedBytes = gameMemory->allocatedBytes > gameMemory->peakAllocatedBytes
+                                   ? gameMemory->allocatedBytes
+                                   : gameMemory->peakAllocatedBytes;
+            if (endBytes > countedBytes)
+            {
+                memoryTagStats[tag].budgetBytes += endBytes - countedBytes;
+                gameMemory->peakAllocatedBytes = endBytes;
+            }
+            memoryTagStats[tag].allocationCount++;
+        }
+        else
+        {
+            memory_tag_add_used(gameMemory->tag, endBytes - gameMemory->allocatedBytes);
+        }
+
+        u8 *memory = gameMemory->memory + startBytes;
+        gameMemory->allocatedBytes = endBytes;
         return memory;
     }
     else
@@ -25,3 +213,274 @@ u8 *allocate_memory(GameMemory *gameMemory, u32 sizeInBytes)
         return 0;
     }
 }
+
+/**
+ * Carves an Arena out of parent, what is used inside of it counts for tag.
+ * @return false if parent is full
+ */
+bool init_sub_memory(GameMemory *subMemory, GameMemory *parent, u64 sizeInBytes, MemoryTag tag)
+{
+    *subMemory = {};
+    subMemory->memory = allocate_memory(parent, sizeInBytes, tag);
+    subMemory->memorySizeInBytes = sizeInBytes;
+    subMemory->tag = tag;
+    return subMemory->memory != 0;
+}
+
+// Everything allocated between begin_temp_memory and end_temp_memory is freed at the end
+struct TempMemory
+{
+    GameMemory *gameMemory;
+    u64 allocatedBytes;
+};
+
+TempMemory begin_temp_memory(GameMemory *gameMemory)
+{
+    return {gameMemory, gameMemory->allocatedBytes};
+}
+
+void end_temp_memory(TempMemory tempMemory)
+{
+    CAKEZ_ASSERT(tempMemory.gameMemory->allocatedBytes >= tempMemory.allocatedBytes,
+                 "Temp Memory was ended in the wrong order");
+    memory_tag_remove_used(tempMemory.gameMemory->tag,
+                           tempMemory.gameMemory->allocatedBytes - tempMemory.allocatedBytes);
+    tempMemory.gameMemory->allocatedBytes = tempMemory.allocatedBytes;
+}
+
+/**
+ * Frees all allocations at once, committed pages stay committed
+ * so reusing the memory costs nothing.
+ */
+void reset_memory(GameMemory *gameMemory)
+{
+    memory_tag_remove_used(gameMemory->tag, gameMemory->allocatedBytes);
+    gameMemory->allocatedBytes = 0;
+}
+
+/**
+ * Gives the committed pages after the allocations of reserved memory back to
+ * the system, for memory that needs a lot for a moment, like sorting.
+ */
+void decommit_unused_memory(GameMemory *gameMemory)
+{
+    if (!gameMemory->isReserved || gameMemory->hasLargePages)
+    {
+        return;
+    }
+
+    u64 usedBytes = ((gameMemory->allocatedBytes + MEMORY_COMMIT_SIZE - 1) / MEMORY_COMMIT_SIZE) * MEMORY_COMMIT_SIZE;
+    if (usedBytes < gameMemory->committedBytes)
+    {
+        platform_decommit_memory(gameMemory->memory + usedBytes, gameMemory->committedBytes - usedBytes);
+        gameMemory->committedBytes = usedBytes;
+    }
+}
+
+// Pool Allocator, for many small blocks of the same size that are freed one by one
+u32 constexpr POOL_ALIGNMENT = 64;
+u32 constexpr POOL_CACHE_BATCH_SIZE = 32;
+
+// Free blocks store the link to the next free block in their first bytes
+struct PoolBlock
+{
+    PoolBlock *next;
+};
+
+struct MemoryPool
+{
+    GameMemory *gameMemory;
+    u32 blockSize;
+    u32 blocksPerSlab;
+
+    PoolBlock *freeList;
+
+    // Blocks of the newest Slab are handed out in order, so fresh blocks lie next to each other
+    u8 *slabAt;
+    u8 *slabEnd;
+
+    u32 usedBlockCount;
+    MemoryTag tag;
+
+    // Only taken by Pool Caches
+    u32 volatile lock;
+};
+
+// Blocks owned by one thread, so only every POOL_CACHE_BATCH_SIZE'th call touches the Pool
+struct PoolCache
+{
+    MemoryPool *pool;
+    PoolBlock *freeList;
+    u32 freeCount;
+};
+
+/**
+ * Blocks up to 64 bytes are rounded up to a power of two, larger ones to a
+ * multiple of 64. Together with the 64 byte aligned Slabs no block spans more
+ * cache lines than it has to.
+ * @param gameMemory Slabs are allocated from it, it has to outlive the Pool
+ */
+void pool_init(MemoryPool *pool, GameMemory *gameMemory, u32 blockSize, u32 blocksPerSlab,
+               MemoryTag tag = MEMORY_TAG_OTHER)
+{
+    u32 size = sizeof(PoolBlock);
+    while (size < blockSize && size < POOL_ALIGNMENT)
+    {
+        size *= 2;
+    }
+
+    if (blockSize > POOL_ALIGNMENT)
+    {
+        size = (blockSize + POOL_ALIGNMENT - 1) & ~(POOL_ALIGNMENT - 1);
+    }
+
+    *pool = {};
+    pool->gameMemory = gameMemory;
+    pool->blockSize = size;
+    pool->blocksPerSlab = blocksPerSlab;
+    pool->tag = tag;
+}
+
+/**
+ * Not thread safe, a Pool that is used by several threads has to be
+ * used through Pool Caches only.
+ * @return A block of at least the size given to pool_init, or 0 if the Game Memory is full
+ */
+inline void *pool_alloc(MemoryPool *pool)
+{
+    PoolBlock *block = pool->freeList;
+    if (block)
+    {
+        pool->freeList = block->next;
+    }
+    else
+    {
+        if (pool->slabAt == pool->slabEnd)
+        {
+            u64 slabSize = (u64)pool->blockSize * pool->blocksPerSlab;
+            pool->slabAt = allocate_memory(pool->gameMemory, slabSize, pool->tag, POOL_ALIGNMENT);
+            if (!pool->slabAt)
+            {
+                pool->slabEnd = 0;
+                return 0;
+            }
+            pool->slabEnd = pool->slabAt + slabSize;
+        }
+
+        block = (PoolBlock *)pool->slabAt;
+        pool->slabAt += pool->blockSize;
+    }
+
+    pool->usedBlockCount++;
+    memory_tag_add_used(pool->tag, pool->blockSize);
+    return block;
+}
+
+inline void pool_free(MemoryPool *pool, void *memory)
+{
+    PoolBlock *block = (PoolBlock *)memory;
+    block->next = pool->freeList;
+    pool->freeList = block;
+    pool->usedBlockCount--;
+    memory_tag_remove_used(pool->tag, pool->blockSize);
+}
+
+void pool_cache_init(PoolCache *cache, MemoryPool *pool)
+{
+    *cache = {};
+    cache->pool = pool;
+}
+
+inline void *pool_cache_alloc(PoolCache *cache)
+{
+    if (!cache->freeList)
+    {
+        MemoryPool *pool = cache->pool;
+        begin_spin_lock(&pool->lock);
+        for (u32 blockIdx = 0; blockIdx < POOL_CACHE_BATCH_SIZE; blockIdx++)
+        {
+            PoolBlock *block = (PoolBlock *)pool_alloc(pool);
+            if (!block)
+            {
+                break;
+            }
+
+            block->next = cache->freeList;
+            cache->freeList = block;
+            cache->freeCount++;
+        }
+        end_spin_lock(&pool->lock);
+
+        if (!cache->freeList)
+        {
+            return 0;
+        }
+    }
+
+    PoolBlock *block = cache->freeList;
+    cache->freeList = block->next;
+    cache->freeCount--;
+    return block;
+}
+
+/**
+ * Gives all blocks of the cache back to the Pool, call it before the thread
+ * is done with the Pool.
+ */
+void pool_cache_flush(PoolCache *cache)
+{
+    MemoryPool *pool = cache->pool;
+    begin_spin_lock(&pool->lock);
+    while (cache->freeList)
+    {
+        PoolBlock *block = cache->freeList;
+        cache->freeList = block->next;
+        pool_free(pool, block);
+    }
+    end_spin_lock(&pool->lock);
+
+    cache->freeCount = 0;
+}
+
+inline void pool_cache_free(PoolCache *cache, void *memory)
+{
+    PoolBlock *block = (PoolBlock *)memory;
+    block->next = cache->freeList;
+    cache->freeList = block;
+
+    // A thread that only frees would otherwise hoard the blocks
+    if (++cache->freeCount > 2 * POOL_CACHE_BATCH_SIZE)
+    {
+        pool_cache_flush(cache);
+    }
+}
+
+/**
+ * Writes a table of what every tag took from gameMemory and uses of it.
+ * @param gameMemory The reserved Game Memory, for the totals
+ * @return The length of the report, without the null terminator
+ */
+u32 memory_format_report(GameMemory *gameMemory, char *out, u32 maxLength)
+{
+    float mb = (float)MB(1);
+    s32 length = snprintf(out, maxLength, "Memory: %.2f MB allocated, %.2f MB committed\n"
+                                          "%-13s %10s %10s %10s %8s\n",
+                          gameMemory->allocatedBytes / mb, gameMemory->committedBytes / mb,
+                          "Tag", "Budget MB", "Used MB", "Peak MB", "Allocs");
+
+    u32 prefixLength = sizeof("MEMORY_TAG_") - 1;
+    for (u32 tag = MEMORY_TAG_NONE + 1; tag < MEMORY_TAG_COUNT && length > 0 && (u32)length < maxLength; tag++)
+    {
+        MemoryTagStats *stats = &memoryTagStats[tag];
+        if (!stats->allocationCount)
+        {
+            continue;
+        }
+
+        length += snprintf(out + length, maxLength - length, "%-13s %10.2f %10.2f %10.2f %8llu\n",
+                           memoryTagNames[tag] + prefixLength, stats->budgetBytes / mb,
+                           stats->usedBytes / mb, stats->peakUsedBytes / mb, stats->allocationCount);
+    }
+
+    return length < 0 ? 0 : ((u32)length < maxLength ? (u32)length : maxLength - 1);
+}
@@ -13,6 +13,16 @@ enum TextColor
 
 void platform_log(char *msg, TextColor color);
 
+/**
+ * Starts the thread that writes the log, it calls log_thread_update
+ * in a loop and sleeps when that tells it to.
+ * @return false if the thread could not be created
+ */
+bool platform_start_log_thread();
+
+// Wakes the log thread if it sleeps
+void platform_wake_log_thread();
+
 /**
  * This function tests for the existence of a file in
  * a given path. This function has to be implemented 
@@ -43,16 +53,78 @@ char *platform_read_file(char *fileName, u32 *fileSize);
  */
 char *platform_read_file(char *path, u32 byteOffset, u32 size);
 
+/**
+ * This function reads up to size bytes of a file at a byteOffset
+ * into a buffer supplied by the caller. Unlike platform_read_file
+ * it does not use the File IO Buffer, so it can be used to stream
+ * files of any size.
+ * @param path The path to the file
+ * @param byteOffset The offset in bytes into the file
+ * @param buffer The buffer that receives the data
+ * @param size The size of the buffer in bytes
+ * @return The amount of bytes read, 0 if the file doesn't exist.
+ */
+u32 platform_read_file_chunk(char *path, u64 byteOffset, char *buffer, u32 size);
+
+/**
+ * This function writes size bytes of buffer to a file. If
+ * overwrite is false the data is appended to the end of the file.
+ * The file is created if it doesn't exist.
+ * @return The amount of bytes written
+ */
 unsigned long platform_write_file(
     char *path,
     char *buffer,
     u32 size,
     bool overwrite);
 
+/**
+ * Opens a file to write to it many times, without opening it for every write
+ * like platform_write_file does. The file is created if it doesn't exist.
+ * @param overwrite Empties the file, otherwise writes are appended to the end
+ * @return The file or 0 if it could not be opened
+ */
+void *platform_open_file(char *path, bool overwrite);
+
+/**
+ * Appends size bytes of buffer to a file from platform_open_file. It doesn't
+ * log on failure, so the logger can use it.
+ * @return The amount of bytes written
+ */
+u32 platform_append_file(void *file, char *buffer, u32 size);
+
+/**
+ * Opens a file to read it once from start to end, without opening it for every
+ * chunk like platform_read_file_chunk does. Close it with platform_close_file.
+ * @return The file or 0 if it could not be opened
+ */
+void *platform_open_file_for_reading(char *path);
+
+/**
+ * Reads the next up to size bytes of a file from platform_open_file_for_reading
+ * @return The amount of bytes read, 0 at the end of the file or on failure
+ */
+u32 platform_read_from_file(void *file, char *buffer, u32 size);
+
+void platform_close_file(void *file);
+
 void platform_delete_file(char *path);
 
+/**
+ * @return The time of the last write to the file, 0 if it doesn't exist
+ */
 long long platform_last_edit_timestamp(char *path);
 
+/**
+ * Maps an entire file read only into memory, the mapping stays
+ * valid until platform_unmap_file is called.
+ * @param size Receives the size of the file in bytes
+ * @return The mapped memory or 0 if the file doesn't exist or is empty
+ */
+void *platform_map_file(char *path, u64 *size);
+
+void platform_unmap_file(void *memory);
+
 u64 platform_get_file_size(char *path);
 
 void platform_get_window_size(u32 *windowWidth, u32 *windowHeight);
@@ -61,12 +133,24 @@ void platform_show_message_box(char *msg);
 
 u32 platform_get_file_count(char *path);
 
+/**
+ * Moves replaceFile to fileToReplace, fileToReplace doesn't have to exist.
+ * @param keepBackup Copies fileToReplace to fileToReplace.bak first
+ * @return false if the file could not be replaced
+ */
 bool platform_replace_file(char *fileToReplace, char *replaceFile, bool keepBackup = true);
 
 void platform_set_volume(float volume);
 
 void platform_exit_game();
 
+/**
+ * Iterates the entries of a folder, "." and ".." are skipped. Directories
+ * get a trailing '/' so they can be told apart from files. Only one folder
+ * can be iterated at a time.
+ * @param fileName Receives the name of the entry, needs to hold MAX_PATH_LENGTH bytes
+ * @return false if there are no (more) entries
+ */
 bool platform_get_first_filename(char *fileName, char *folderPath);
 
 bool platform_get_next_filename(char *fileName, char *folderPath);
@@ -74,44 +158,159 @@ bool platform_get_next_filename(char *fileName, char *folderPath);
 u64 platform_get_performance_tick_count();
 u64 platform_get_performance_tick_frequency();
 
+/**
+ * Writes the path to the folder for temporary files, including
+ * a trailing separator, into path.
+ * @return false if the path does not fit into maxLength
+ */
+bool platform_get_temp_folder(char *path, u32 maxLength);
+
+// Id of the running process, to keep temp files of two instances apart
+u32 platform_get_process_id();
+
+/**
+ * Writes the absolute version of path, which can be relative
+ * to the working directory, into fullPath.
+ * @return false if the path does not fit into maxLength
+ */
+bool platform_get_full_path(char *path, char *fullPath, u32 maxLength);
+
+// Virtual Memory
+/**
+ * Reserves address space, it can't be used before it is committed.
+ * @return The start of the reserved range or 0 on failure
+ */
+void *platform_reserve_memory(u64 size);
+
+/**
+ * Backs a part of a reserved range with memory, the memory is zeroed.
+ * @return false if the system is out of memory
+ */
+bool platform_commit_memory(void *memory, u64 size);
+
+// Gives committed memory back to the system, the range stays reserved
+void platform_decommit_memory(void *memory, u64 size);
 
-struct Instrumentor
+/**
+ * Allocates committed memory backed by large pages, 2 MB instead of 4 KB on
+ * x64, so scanning it needs a lot fewer TLB entries. The system has to
+ * allow it, on Windows the user needs the "Lock pages in memory" right.
+ * @param size Rounded up to a multiple of the large page size
+ * @return The memory or 0 if large pages are not available
+ */
+void *platform_allocate_large_pages(u64 *size);
+
+// Frees memory from platform_reserve_memory or platform_allocate_large_pages
+void platform_release_memory(void *memory);
+
+// Multithreading
+struct WorkQueue;
+typedef void WorkQueueCallback(WorkQueue *queue, void *data);
+
+/**
+ * Adds an entry to the queue, it will be picked up by the next
+ * free worker thread. Entries should only be added from the main thread.
+ */
+void platform_add_work_entry(WorkQueue *queue, WorkQueueCallback *callback, void *data);
+
+/**
+ * Blocks until all entries added to the queue are done, the calling
+ * thread helps working on the queue while waiting.
+ */
+void platform_complete_all_work(WorkQueue *queue);
+
+/**
+ * @return The amount of threads that work on the queues, this includes
+ * the main thread because it helps in platform_complete_all_work
+ */
+u32 platform_get_thread_count();
+
+// Event Loop
+u32 constexpr WAIT_FOREVER = UINT32_MAX;
+
+enum WaitResult : u32
 {
-    u64 start, stop;
-    float *outDT;
+    WAIT_RESULT_TIMEOUT,
+    WAIT_RESULT_INPUT,
+    WAIT_RESULT_FOLDER_CHANGED,
+    WAIT_RESULT_WORK_DONE,
+};
 
-    Instrumentor(float *outDT)
-        : outDT(outDT)
-    {
-        start = platform_get_performance_tick_count();
-    }
+/**
+ * Decides if a change to a file in the watched folder matters
+ * @param path Relative to the watched folder, with '/' as separator
+ */
+typedef bool PlatformWatchFilter(char *path, u32 length, void *data);
 
-    ~Instrumentor()
-    {
-        stop = platform_get_performance_tick_count();
-        u64 frequency = platform_get_performance_tick_frequency();
-        u64 elapsedTicks = stop - start;
+/**
+ * Watches a folder and its subfolders, writes, new, renamed and deleted
+ * files wake platform_wait_for_events. Only one folder can be watched.
+ * A burst of changes, like from a checkout, wakes it once after the
+ * folder was quiet for a moment.
+ * @param filter Changes it returns false for are ignored, 0 to report all of them
+ */
+bool platform_watch_folder(char *path, PlatformWatchFilter *filter, void *filterData);
 
-        // Convert to Microseconds to not loose precision,
-        // by deviding a small numbner by a large one
-        u64 elapsedTimeInMicroseconds =
-            (elapsedTicks * 1000000) / frequency;
+/**
+ * Blocks until there is input for the window, the watched folder changed,
+ * a work queue entry finished or timeoutMs passed. Use it instead of
+ * drawing frames when nothing changed.
+ * @param timeoutMs WAIT_FOREVER to wait without a timeout
+ */
+WaitResult platform_wait_for_events(u32 timeoutMs);
+
+// Atomics, all of them act as a full memory barrier
+/**
+ * Writes newValue to value if value is equal to expected
+ * @return The value before the exchange
+ */
+u32 platform_atomic_compare_exchange(u32 volatile *value, u32 newValue, u32 expected);
+u32 platform_atomic_exchange(u32 volatile *value, u32 newValue);
+
+/**
+ * @return The value before the addition
+ */
+u32 platform_atomic_add(u32 volatile *value, u32 addend);
+
+// Gives the rest of the time slice to another thread that is ready to run
+void platform_yield_thread();
 
-        // Time in milliseconds
-        *outDT = (float)elapsedTimeInMicroseconds / 1000.0f;
+// Only use these for short critical sections
+inline void begin_spin_lock(u32 volatile *lock)
+{
+    while (platform_atomic_compare_exchange(lock, 1, 0) != 0)
+    {
     }
-};
+}
 
-// void start_thread(params...);
+inline void end_spin_lock(u32 volatile *lock)
+{
+    platform_atomic_exchange(lock, 0);
+}
 
+// Allocation Guard, only implemented with ALLOC_GUARD
+typedef void PlatformAllocationHook(u64 size);
 
-Instrumentor _measure_scope_time(char *text, char *unit, bool log = false);
+/**
+ * Calls hook for every malloc, realloc and new of the program, from the
+ * thread that allocates. Libraries with their own runtime, like the
+ * Vulkan driver, are not hooked.
+ * @return false if the runtime can't be hooked, it has to be the debug one
+ */
+bool platform_hook_allocations(PlatformAllocationHook *hook);
 
-#ifdef MEASURE_PERF 
-#define MEASURE_SCOPE(text, unit) Instrumentor i = _measure_scope_time(text, unit);
-#define MEASURE_SCOPE_LOG(text, unit) Instrumentor i = _measure_scope_time(text, unit, true);
+/**
+ * Writes the return addresses of the calling function and its callers,
+ * without allocating.
+ * @param skipCount Callers to skip, not counting platform_capture_call_stack
+ * @return The amount of addresses written
+ */
+u32 platform_capture_call_stack(void **addresses, u32 maxCount, u32 skipCount);
 
-#else
-#define MEASURE_SCOPE(text, unit)
-#define MEASURE_SCOPE_LOG(text, unit)
-#endif
\ No newline at end of file
+/**
+ * Writes "function file:line" of a code address, this needs debug info (/Z7).
+ */
+void platform_describe_address(void *address, char *buffer, u32 length);
+
+
+// void start_thread(params...);
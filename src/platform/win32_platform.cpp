@@ -12,6 +12,10 @@
 
 // Memory
 #include "memory.h"
+#include "heap.h"
+
+// Profiler
+#include "profiler.h"
 
 // Input
 #include "input.cpp"
@@ -19,6 +23,7 @@
 // Platform layer
 #include <windows.h>
 #include <windowsx.h>
+#include "win32_services.cpp"
 
 // Renderer
 #include "renderer/vulkan/vk_renderer.cpp"
@@ -28,6 +33,52 @@ global_variable InputState* input;
 global_variable HWND window;
 global_variable WINDOWPLACEMENT prevWindowPlacment = {};
 
+// Set when the window has to be drawn again, even if the app didn't change
+global_variable bool windowDirty = true;
+
+u32 constexpr FOLDER_CHANGE_BUFFER_SIZE = KB(64);
+
+// A checkout or a build touches lots of files in a row, they are reported
+// once the folder was quiet for this long
+u32 constexpr FOLDER_CHANGE_DEBOUNCE_MS = 250;
+
+struct FolderWatch
+{
+    HANDLE folder;
+    OVERLAPPED overlapped;
+    PlatformWatchFilter *filter;
+    void *filterData;
+
+    bool isChangePending;
+    u64 lastChangeMs;
+
+    // ReadDirectoryChangesW needs it DWORD aligned
+    DWORD buffer[FOLDER_CHANGE_BUFFER_SIZE / sizeof(DWORD)];
+};
+
+global_variable FolderWatch folderWatch = {INVALID_HANDLE_VALUE};
+
+// WM_CHAR delivers UTF-16, characters outside of the BMP arrive in two messages
+global_variable WCHAR highSurrogate;
+
+internal void push_input_event(InputEventType type, u8 key, u32 codepoint = 0, s32 wheelDelta = 0)
+{
+    InputEvent event = {};
+    event.timestamp = platform_get_performance_tick_count();
+    event.type = type;
+    event.key = key;
+    event.codepoint = codepoint;
+    event.wheelDelta = wheelDelta;
+    event.mousePos = input->mousePos;
+
+    // High bit is set if the key is down
+    event.modifiers = ((GetKeyState(VK_CONTROL) & 0x8000) ? INPUT_MODIFIER_CONTROL : 0) |
+                      ((GetKeyState(VK_SHIFT) & 0x8000) ? INPUT_MODIFIER_SHIFT : 0) |
+                      ((GetKeyState(VK_MENU) & 0x8000) ? INPUT_MODIFIER_ALT : 0);
+
+    input_push_event(input, &event);
+}
+
 LRESULT CALLBACK window_callback(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
     switch (msg)
@@ -56,9 +107,18 @@ LRESULT CALLBACK window_callback(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPar
         u32 width, height;
         platform_get_window_size(&width, &height);
         input->screenSize = {(float)width, (float)height};
+        windowDirty = true;
         break;
     }
 
+    case WM_PAINT:
+    {
+        // Drawing happens in the main loop, this just marks the window as drawn
+        ValidateRect(hwnd, 0);
+        windowDirty = true;
+        return 0;
+    }
+
     case WM_KEYDOWN:
     case WM_KEYUP:
     case WM_SYSKEYDOWN:
@@ -100,23 +160,68 @@ LRESULT CALLBACK window_callback(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPar
         }
 
         KeyState newKeyState = (msg == WM_SYSKEYUP || msg == WM_KEYUP) ? KEY_STATE_UP : KEY_STATE_DOWN;
+        Key *key = &input->keys[wParam];
 
-        if (newKeyState == KEY_STATE_UP && input->keys[wParam].keyState == KEY_STATE_DOWN ||
-            newKeyState == KEY_STATE_DOWN && input->keys[wParam].keyState == KEY_STATE_UP)
+        if (newKeyState == KEY_STATE_UP && key->keyState == KEY_STATE_DOWN ||
+            newKeyState == KEY_STATE_DOWN && key->keyState == KEY_STATE_UP)
         {
-            input->keys[wParam].halfTransitionCount++;
+            if (key->halfTransitionCount++ == 0)
+            {
+                input->changedKeys[input->changedKeyCount++] = (u8)wParam;
+            }
         }
 
-        input->keys[wParam].keyState = newKeyState;
+        key->keyState = newKeyState;
+
+        // Key repeats are pushed as well
+        push_input_event(newKeyState == KEY_STATE_DOWN ? INPUT_EVENT_KEY_DOWN : INPUT_EVENT_KEY_UP, (u8)wParam);
         break;
     }
 
+    case WM_CHAR:
+    {
+        WCHAR unit = (WCHAR)wParam;
+        if (unit >= 0xD800 && unit <= 0xDBFF)
+        {
+            highSurrogate = unit;
+        }
+        else if (unit >= 0xDC00 && unit <= 0xDFFF)
+        {
+            // Lone low surrogates are dropped
+            if (highSurrogate)
+            {
+                u32 codepoint = 0x10000 + (((u32)highSurrogate - 0xD800) << 10) + (unit - 0xDC00);
+                push_input_event(INPUT_EVENT_CHAR, 0, codepoint);
+            }
+            highSurrogate = 0;
+        }
+        else
+        {
+            highSurrogate = 0;
+            push_input_event(INPUT_EVENT_CHAR, 0, unit);
+        }
+        return 0;
+    }
+
+    // Sent by some IMEs, carries UTF-32
+    case WM_UNICHAR:
+    {
+        if (wParam == UNICODE_NOCHAR)
+        {
+            return TRUE;
+        }
+
+        push_input_event(INPUT_EVENT_CHAR, 0, (u32)wParam);
+        return 0;
+    }
+
     case WM_MOUSEMOVE:
     {
         input->oldMousePos = input->mousePos;
         input->mousePos.x = (float)GET_X_LPARAM(lParam);
         input->mousePos.y = (float)GET_Y_LPARAM(lParam);
         input->relMouse += input->mousePos - input->oldMousePos;
+        push_input_event(INPUT_EVENT_MOUSE_MOVE, 0);
         return 1;
     }
 
@@ -128,6 +233,7 @@ LRESULT CALLBACK window_callback(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPar
             delta = (delta < 0) ? -1 : 1;
         }
         input->wheelDelta = delta;
+        push_input_event(INPUT_EVENT_MOUSE_WHEEL, 0, 0, delta);
         break;
     }
 
@@ -138,33 +244,27 @@ LRESULT CALLBACK window_callback(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPar
     case WM_RBUTTONUP:
     case WM_MBUTTONUP:
     {
-        // KeyType mouseKey =
-        //     (msg == WM_RBUTTONDOWN || (msg == WM_RBUTTONUP)
-        //          ? KEY_RIGHT_MOUSE
-        //      : (msg == WM_LBUTTONDOWN) || (msg == WM_LBUTTONUP)
-        //          ? KEY_LEFT_MOUSE
-        //          : KEY_MIDDLE_MOUSE);
-
-        // KeyState newKeyState = (msg == WM_RBUTTONDOWN || msg == WM_LBUTTONDOWN || msg == WM_MBUTTONDOWN)
-        //                            ? KEY_STATE_DOWN
-        //                            : KEY_STATE_UP;
-
-        // input->clickMousePos.x = (float)GET_X_LPARAM(lParam);
-        // input->clickMousePos.y = (float)GET_Y_LPARAM(lParam);
-
-        // if (newKeyState == KEY_STATE_UP && input->keys[mouseKey].keyState == KEY_STATE_DOWN ||
-        //     newKeyState == KEY_STATE_DOWN && input->keys[mouseKey].keyState == KEY_STATE_UP)
-        // {
-        //     input->keys[mouseKey].halfTransitionCount++;
-        // }
-
-        // input->keys[mouseKey].keyState = newKeyState;
+        MouseButton mouseButton =
+            (msg == WM_RBUTTONDOWN || (msg == WM_RBUTTONUP)
+                 ? MOUSE_BUTTON_RIGHT
+             : (msg == WM_LBUTTONDOWN) || (msg == WM_LBUTTONUP)
+                 ? MOUSE_BUTTON_LEFT
+                 : MOUSE_BUTTON_MIDDLE);
+
+        KeyState newKeyState = (msg == WM_RBUTTONDOWN || msg == WM_LBUTTONDOWN || msg == WM_MBUTTONDOWN)
+                                   ? KEY_STATE_DOWN
+                                   : KEY_STATE_UP;
+
+        input->clickMousePos.x = (float)GET_X_LPARAM(lParam);
+        input->clickMousePos.y = (float)GET_Y_LPARAM(lParam);
+        push_input_event(newKeyState == KEY_STATE_DOWN ? INPUT_EVENT_MOUSE_BUTTON_DOWN : INPUT_EVENT_MOUSE_BUTTON_UP,
+                         mouseButton);
 
         return 1;
     }
     }
 
-    return DefWindowProcA(hwnd, msg, wParam, lParam);
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
 }
 
 internal bool platform_create_window(s32 width, s32 height, char *title)
@@ -172,15 +272,16 @@ internal bool platform_create_window(s32 width, s32 height, char *title)
     HINSTANCE instance = GetModuleHandleA(0);
 
     // Setup and register window class
+    // The window is a Unicode window, so WM_CHAR carries UTF-16 instead of the ANSI Code Page
     HICON icon = LoadIcon(instance, IDI_APPLICATION);
-    WNDCLASS wc = {};
+    WNDCLASSW wc = {};
     wc.lpfnWndProc = window_callback;
     wc.hInstance = instance;
     wc.hIcon = icon;
     wc.hCursor = LoadCursor(NULL, IDC_ARROW); // NULL; => Manage the cursor manually
-    wc.lpszClassName = "cakez_window_class";
+    wc.lpszClassName = L"cakez_window_class";
 
-    if (!RegisterClassA(&wc))
+    if (!RegisterClassW(&wc))
     {
         MessageBoxA(0, "Window registration failed", "Error", MB_ICONEXCLAMATION | MB_OK);
         return false;
@@ -222,8 +323,11 @@ internal bool platform_create_window(s32 width, s32 height, char *title)
     window_width += border_rect.right - border_rect.left;
     window_height += border_rect.bottom - border_rect.top;
 
-    window = CreateWindowExA(
-        (DWORD)window_ex_style, "cakez_window_class", title,
+    WCHAR wideTitle[256] = {};
+    MultiByteToWideChar(CP_UTF8, 0, title, -1, wideTitle, ArraySize(wideTitle) - 1);
+
+    window = CreateWindowExW(
+        (DWORD)window_ex_style, L"cakez_window_class", wideTitle,
         (DWORD)window_style, window_x, window_y, window_width, window_height,
         0, 0, instance, 0);
 
@@ -243,12 +347,13 @@ internal bool platform_create_window(s32 width, s32 height, char *title)
 
 internal void platform_update_window()
 {
-    // Clear the transitionCount for every key
+    // Clear the transitionCount of the keys that changed last frame
     {
-        for (u32 keyIdx = 0; keyIdx < 255; keyIdx++)
+        for (u32 changedIdx = 0; changedIdx < input->changedKeyCount; changedIdx++)
         {
-            input->keys[keyIdx].halfTransitionCount = 0;
+            input->keys[input->changedKeys[changedIdx]].halfTransitionCount = 0;
         }
+        input->changedKeyCount = 0;
     }
 
     // Reset relative Mouse Movement
@@ -260,120 +365,290 @@ internal void platform_update_window()
 
     MSG msg;
 
-    while (PeekMessageA(&msg, window, 0, 0, PM_REMOVE))
+    // Thread messages have to be removed as well, otherwise platform_wait_for_events never blocks
+    while (PeekMessageW(&msg, 0, 0, 0, PM_REMOVE))
     {
         TranslateMessage(&msg);
-        DispatchMessage(&msg);
+        DispatchMessageW(&msg);
     }
 }
 
-
 global_variable LARGE_INTEGER ticksPerSecond;
-u32 constexpr FILE_IO_BUFFER_SIZE = MB(1);
-global_variable char *fileIOBuffer;
 global_variable char *fontAtlasBuffer;
+global_variable Heap generalHeap;
 
-s32 main (){
+s32 main(s32 argc, char **argv)
+{
     running = true;
 
+    // Writing to the console is slow, keep it off the threads that log
+    log_start_thread();
+
+    // --record <path> writes the input to a file, --replay <path> runs it headless as a benchmark
+    // --binary-log <path> writes the log to a binary file, tools/log_decoder turns it into text
+    // --trace <path> captures a Chrome Trace of the whole session, for chrome://tracing or ui.perfetto.dev
+    // --large-pages loads large files into Large Pages, this needs the Lock Pages in Memory privilege
+    char *recordPath = 0;
+    char *replayPath = 0;
+    char *binaryLogPath = 0;
+    char *tracePath = 0;
+    bool useLargePages = false;
+    for (s32 argIdx = 1; argIdx < argc; argIdx++)
+    {
+        if (!strcmp(argv[argIdx], "--record") && argIdx + 1 < argc)
+        {
+            recordPath = argv[++argIdx];
+        }
+        else if (!strcmp(argv[argIdx], "--replay") && argIdx + 1 < argc)
+        {
+            replayPath = argv[++argIdx];
+        }
+        else if (!strcmp(argv[argIdx], "--binary-log") && argIdx + 1 < argc)
+        {
+            binaryLogPath = argv[++argIdx];
+        }
+        else if (!strcmp(argv[argIdx], "--trace") && argIdx + 1 < argc)
+        {
+            tracePath = argv[++argIdx];
+        }
+        else if (!strcmp(argv[argIdx], "--large-pages"))
+        {
+            useLargePages = true;
+        }
+    }
+
+    if (binaryLogPath)
+    {
+        log_open_binary_file(binaryLogPath);
+    }
+
     LARGE_INTEGER lastTickCount, currentTickCount;
     QueryPerformanceFrequency(&ticksPerSecond);
     QueryPerformanceCounter(&lastTickCount);
     float dt = 0;
 
-    GameMemory gameMemory = {};
-    gameMemory.memory = (u8 *)malloc(MB(10));
-    gameMemory.memorySizeInBytes = MB(10);
+    // Only the pages that get used are committed, so this is no limit for the size of files
+    GameMemory gameMemory;
+    if (!init_reserved_memory(&gameMemory, GB(16)))
+    {
+        CAKEZ_FATAL("Failed to reserve Address Space for the Game Memory");
+        return -1;
+    }
 
-    input = (InputState*)allocate_memory(&gameMemory, sizeof(InputState));
+    // Worker Threads and the File IO Buffer
+    if (!win32_init_services(&gameMemory))
+    {
+        CAKEZ_FATAL("Failed to allocate memory to handle File I/O");
+        return -1;
+    }
+
+    // Every worker and the main thread get a ring for their events
+    if (!profiler_init(&gameMemory, workerThreadCount + 1))
+    {
+        CAKEZ_WARN("Failed to allocate memory for the Profiler");
+    }
+    else if (tracePath)
+    {
+        profiler_begin_trace(tracePath, &workQueue);
+    }
+
+    input = (InputState*)allocate_memory(&gameMemory, sizeof(InputState), MEMORY_TAG_INPUT);
     if(!input)
     {
         CAKEZ_FATAL("Failed to allocate Memory for Input");
         return -1;
     }
 
-    // Window
-    IVec2 windowSize = {1720, 900};
-    platform_create_window(windowSize.x, windowSize.y, "Cakeztor");
+    // Variable sized blocks that are freed one by one
+    heap_init(&generalHeap, &gameMemory, MB(1));
 
-    // Allocate File I/O Memory
-    fileIOBuffer = (char *)allocate_memory(&gameMemory, FILE_IO_BUFFER_SIZE);
-    if (!fileIOBuffer)
+    // Replays run headless, without a Window or Renderer
+    VkContext *vkcontext = 0;
+    if (!replayPath)
     {
-        CAKEZ_FATAL("Failed to allocate memory to handle File I/O");
+        IVec2 windowSize = {1720, 900};
+        platform_create_window(windowSize.x, windowSize.y, "Cakeztor");
+
+        vkcontext = (VkContext *)allocate_memory(&gameMemory, sizeof(VkContext), MEMORY_TAG_RENDERER);
+        if (!vkcontext || !vk_init(vkcontext, window, true))
+        {
+            CAKEZ_FATAL("Failed to allocate memory for the Vulkan Context");
+            return -1;
+        }
+
+        fontAtlasBuffer = (char *)allocate_memory(&gameMemory, MB(1), MEMORY_TAG_FONT);
+        if (!fontAtlasBuffer)
+        {
+            CAKEZ_FATAL("Failed to allocate memory to Upload the font Atlas");
+            return -1;
+        }
+        vk_init_font(vkcontext, &generalHeap, fontAtlasBuffer, 512, 42);
+    }
+
+    AppState* app = (AppState*)allocate_memory(&gameMemory, sizeof(AppState), MEMORY_TAG_APP);
+    if (!app)
+    {
+        CAKEZ_FATAL("Failed to allocate memory for the AppState");
+        return -1;
+    }
+    if (!app_init_text(app))
+    {
+        CAKEZ_FATAL("Failed to reserve memory for the Text");
+        return -1;
+    }
+    app->useLargePages = useLargePages;
+    app->workQueue = &workQueue;
+    app->gameMemory = &gameMemory;
+    if (!init_sub_memory(&app->transientMemory, &gameMemory, MB(4), MEMORY_TAG_TRANSIENT))
+    {
+        CAKEZ_FATAL("Failed to allocate Transient Memory for the AppState");
         return -1;
     }
 
-    // Renderer
-    VkContext* vkcontext = (VkContext*)allocate_memory(&gameMemory, sizeof(VkContext));
-    if (!vkcontext || !vk_init(vkcontext, window, true))
+    if (!init_sub_memory(&app->frameMemory, &gameMemory, MB(1), MEMORY_TAG_FRAME))
     {
-        CAKEZ_FATAL("Failed to allocate memory for the Vulkan Context");
+        CAKEZ_FATAL("Failed to allocate Frame Memory for the AppState");
         return -1;
     }
 
-    fontAtlasBuffer = (char *)allocate_memory(&gameMemory, MB(1));
-    if (!fontAtlasBuffer)
+    if (!init_reserved_memory(&app->sortMemory, MAX_SORT_MEMORY, true))
     {
-        CAKEZ_FATAL("Failed to allocate memory to Upload the font Atlas");
+        CAKEZ_FATAL("Failed to reserve Sort Memory for the AppState");
         return -1;
     }
-    vk_init_font(vkcontext, fontAtlasBuffer, 512, 42);
 
-    AppState* app = (AppState*)allocate_memory(&gameMemory, sizeof(AppState));
-    if (!app)
+    if (!word_index_init(&app->wordIndex, MAX_WORD_INDEX_NODES, MAX_WORD_INDEX_LABEL_BYTES, MAX_TEXT_LENGTH))
     {
-        CAKEZ_FATAL("Failed to allocate memory for the AppState");
+        CAKEZ_FATAL("Failed to allocate memory for the Word Index");
         return -1;
     }
-    memset(app->buffer, 0, 1000);
 
-    while(running)
+    if (!file_finder_init(&app->fileFinder, &workQueue, ".", MAX_FINDER_PATHS, MAX_FINDER_PATH_BYTES))
     {
-        platform_update_window();
-        update_app(app, input);
-        vk_render(vkcontext, input, app);
+        CAKEZ_FATAL("Failed to allocate memory for the File Finder");
+        return -1;
     }
 
-    return 0;
-}
+    // A refresh merges and sorts through all of the work memory of the Symbol Index,
+    // Large Pages save TLB misses there. Without them it gets regular pages
+    GameMemory symbolIndexMemory;
+    char symbolIndexPath[MAX_PATH_LENGTH];
+    if (!init_large_page_memory(&symbolIndexMemory, MB(12) + MEMORY_COMMIT_SIZE) ||
+        !symbol_index_get_path(symbolIndexPath, app->fileFinder.rootFolder) ||
+        !symbol_index_init(&app->symbolIndex, &symbolIndexMemory, MB(12), symbolIndexPath))
+    {
+        CAKEZ_FATAL("Failed to allocate memory for the Symbol Index");
+        return -1;
+    }
 
-void platform_log(char *msg, TextColor color)
-{
-    HANDLE consoleHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+    app_load_keybindings(app, "keybindings.txt");
 
-    u32 colorBits = 0;
+    if (replayPath)
+    {
+        bool isReplayed = app_run_replay(app, input, replayPath);
+        profiler_end_trace();
+        return isReplayed ? 0 : -1;
+    }
 
-    switch (color)
+    InputRecorder *recorder = 0;
+    if (recordPath)
     {
-    case TEXT_COLOR_WHITE:
-        colorBits = FOREGROUND_BLUE | FOREGROUND_GREEN | FOREGROUND_RED;
-        break;
+        recorder = (InputRecorder *)allocate_memory(&gameMemory, sizeof(InputRecorder), MEMORY_TAG_INPUT);
+        if (!recorder || !input_recorder_begin(recorder, recordPath))
+        {
+            CAKEZ_WARN("Input is not recorded");
+            recorder = 0;
+        }
+    }
 
-    case TEXT_COLOR_GREEN:
-        colorBits = FOREGROUND_GREEN;
-        break;
+    if (recordPath)
+    {
+        app_add_output_file(app, recordPath);
+    }
+    if (binaryLogPath)
+    {
+        app_add_output_file(app, binaryLogPath);
+    }
+    if (tracePath)
+    {
+        app_add_output_file(app, tracePath);
+    }
 
-    case TEXT_COLOR_YELLOW:
-        colorBits = FOREGROUND_GREEN | FOREGROUND_RED;
-        break;
+    if (!platform_watch_folder(app->fileFinder.rootFolder, app_is_watched_path, app))
+    {
+        CAKEZ_WARN("Failed to watch %s for changes", app->fileFinder.rootFolder);
+    }
 
-    case TEXT_COLOR_RED:
-        colorBits = FOREGROUND_RED;
-        break;
+#ifdef ALLOC_GUARD
+    // The first frame still sets things up, every frame after it has to stay inside the Arenas
+    alloc_guard_init();
+    bool isSteadyState = false;
+#endif
 
-    case TEXT_COLOR_LIGHT_RED:
-        colorBits = FOREGROUND_RED | FOREGROUND_INTENSITY;
-        break;
+    // Only draw when something changed, otherwise sleep until the OS wakes us up
+    bool shouldRender = true;
+    while(running)
+    {
+        reset_memory(&app->frameMemory);
+
+        if (!shouldRender)
+        {
+            MEASURE_SCOPE("wait_for_events");
+            WaitResult waitResult = platform_wait_for_events(WAIT_FOREVER);
+            if (waitResult == WAIT_RESULT_FOLDER_CHANGED)
+            {
+                app_on_folder_changed(app);
+            }
+        }
+
+        profiler_begin_frame();
+#ifdef ALLOC_GUARD
+        if (isSteadyState)
+        {
+            alloc_guard_arm();
+        }
+#endif
+        {
+            MEASURE_SCOPE("input");
+            platform_update_window();
+        }
+
+        if (recorder)
+        {
+            input_recorder_capture(recorder, input);
+        }
+
+        shouldRender = update_app(app, input) || windowDirty;
+        windowDirty = false;
+
+        if (shouldRender)
+        {
+            vk_render(vkcontext, input, app);
+        }
+
+        profiler_end_frame();
+
+#ifdef ALLOC_GUARD
+        alloc_guard_disarm();
+        alloc_guard_report();
+        isSteadyState = true;
+#endif
     }
 
-    SetConsoleTextAttribute(consoleHandle, (WORD)colorBits);
+    app_execute_command(app, COMMAND_REPORT_LATENCY);
+    profiler_end_trace();
+    profiler_log_report();
 
-#ifdef DEBUG
-    OutputDebugStringA(msg);
+#ifdef ALLOC_GUARD
+    CAKEZ_TRACE("%u Allocations outside of the Arenas in the frame loop", allocGuard.violationCount);
 #endif
 
-    WriteConsoleA(consoleHandle, msg, strlen(msg), 0, 0);
+    if (recorder)
+    {
+        input_recorder_end(recorder);
+    }
+
+    return 0;
 }
 
 void platform_get_window_size(u32 *windowWidth, u32 *windowHeight)
@@ -385,74 +660,156 @@ void platform_get_window_size(u32 *windowWidth, u32 *windowHeight)
     *windowHeight = r.bottom - r.top;
 }
 
-char *platform_read_file(char *path, u32 *fileSize)
+internal bool read_folder_changes()
+{
+    // Completes when something changed, that signals the event of the OVERLAPPED
+    return ReadDirectoryChangesW(
+        folderWatch.folder, folderWatch.buffer, sizeof(folderWatch.buffer), TRUE,
+        FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE,
+        0, &folderWatch.overlapped, 0);
+}
+
+/**
+ * Reads the changes that arrived and starts waiting for the next ones.
+ * @return true if one of the changes passes the filter
+ */
+internal bool process_folder_changes()
 {
-    char *buffer = 0;
+    bool isWatched = false;
+
+    // No bytes means the buffer overflowed, so we don't know what changed
+    DWORD byteCount = 0;
+    if (!GetOverlappedResult(folderWatch.folder, &folderWatch.overlapped, &byteCount, FALSE) ||
+        !byteCount || !folderWatch.filter)
+    {
+        isWatched = true;
+    }
 
-    if (fileSize)
+    FILE_NOTIFY_INFORMATION *info = (FILE_NOTIFY_INFORMATION *)folderWatch.buffer;
+    while (!isWatched)
     {
-        if (fileIOBuffer)
+        char path[MAX_PATH_LENGTH];
+        s32 length = WideCharToMultiByte(CP_UTF8, 0, info->FileName, info->FileNameLength / sizeof(WCHAR),
+                                         path, MAX_PATH_LENGTH - 1, 0, 0);
+        for (s32 idx = 0; idx < length; idx++)
         {
-            HANDLE file = CreateFile(
-                path,
-                GENERIC_READ,
-                FILE_SHARE_READ,
-                0,
-                OPEN_EXISTING,
-                0, 0);
-
-            if (file != INVALID_HANDLE_VALUE)
-            {
-                LARGE_INTEGER fSize;
-                if (GetFileSizeEx(file, &fSize))
-                {
-                    *fileSize = (u32)fSize.QuadPart;
-
-                    if (*fileSize < FILE_IO_BUFFER_SIZE)
-                    {
-                        // Use File IO Buffer
-                        buffer = fileIOBuffer;
-
-                        DWORD bytesRead;
-                        if (ReadFile(file, buffer, *fileSize, &bytesRead, 0) &&
-                            *fileSize == bytesRead)
-                        {
-                        }
-                        else
-                        {
-                            CAKEZ_WARN("Failed reading file %s", path);
-                            buffer = 0;
-                        }
-                    }
-                    else
-                    {
-                        CAKEZ_ASSERT(0, "File size: %d, too large for File IO Buffer", *fileSize);
-                        CAKEZ_WARN("File size: %d, too large for File IO Buffer", *fileSize);
-                    }
-                }
-                else
-                {
-                    CAKEZ_WARN("Failed getting size of file %s", path);
-                }
+            path[idx] = path[idx] == '\\' ? '/' : path[idx];
+        }
+        path[length] = 0;
 
-                CloseHandle(file);
+        isWatched = folderWatch.filter(path, length, folderWatch.filterData);
+
+        if (!info->NextEntryOffset)
+        {
+            break;
+        }
+        info = (FILE_NOTIFY_INFORMATION *)((u8 *)info + info->NextEntryOffset);
+    }
+
+    if (!read_folder_changes())
+    {
+        CAKEZ_WARN("Stopped watching the folder for changes");
+        CloseHandle(folderWatch.folder);
+        folderWatch.folder = INVALID_HANDLE_VALUE;
+    }
+
+    return isWatched;
+}
+
+bool platform_watch_folder(char *path, PlatformWatchFilter *filter, void *filterData)
+{
+    if (folderWatch.folder != INVALID_HANDLE_VALUE)
+    {
+        CancelIo(folderWatch.folder);
+        CloseHandle(folderWatch.folder);
+    }
+
+    if (!folderWatch.overlapped.hEvent)
+    {
+        folderWatch.overlapped.hEvent = CreateEventA(0, TRUE, FALSE, 0);
+    }
+
+    folderWatch.filter = filter;
+    folderWatch.filterData = filterData;
+    folderWatch.isChangePending = false;
+    folderWatch.folder = CreateFileA(
+        path, FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        0, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, 0);
+
+    if (folderWatch.folder == INVALID_HANDLE_VALUE || !folderWatch.overlapped.hEvent)
+    {
+        return false;
+    }
+
+    if (!read_folder_changes())
+    {
+        CloseHandle(folderWatch.folder);
+        folderWatch.folder = INVALID_HANDLE_VALUE;
+        return false;
+    }
+
+    return true;
+}
+
+WaitResult platform_wait_for_events(u32 timeoutMs)
+{
+    u64 startMs = GetTickCount64();
+    while (true)
+    {
+        u64 nowMs = GetTickCount64();
+        u32 waitMs = timeoutMs;
+        if (timeoutMs != WAIT_FOREVER)
+        {
+            waitMs = nowMs - startMs < timeoutMs ? timeoutMs - (u32)(nowMs - startMs) : 0;
+        }
+
+        // The folder was quiet long enough
+        if (folderWatch.isChangePending)
+        {
+            u32 quietMs = (u32)(nowMs - folderWatch.lastChangeMs);
+            if (quietMs >= FOLDER_CHANGE_DEBOUNCE_MS)
+            {
+                folderWatch.isChangePending = false;
+                return WAIT_RESULT_FOLDER_CHANGED;
             }
-            else
+            waitMs = waitMs < FOLDER_CHANGE_DEBOUNCE_MS - quietMs ? waitMs : FOLDER_CHANGE_DEBOUNCE_MS - quietMs;
+        }
+
+        HANDLE handles[2] = {workQueue.workDoneEvent};
+        DWORD handleCount = 1;
+        if (folderWatch.folder != INVALID_HANDLE_VALUE)
+        {
+            handles[handleCount++] = folderWatch.overlapped.hEvent;
+        }
+
+        // MWMO_INPUTAVAILABLE also returns for input that was seen but not removed yet
+        DWORD result = MsgWaitForMultipleObjectsEx(handleCount, handles, waitMs,
+                                                   QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+
+        if (result == WAIT_OBJECT_0)
+        {
+            return WAIT_RESULT_WORK_DONE;
+        }
+        if (result == WAIT_OBJECT_0 + 1 && handleCount == 2)
+        {
+            // Every change restarts the quiet period
+            if (process_folder_changes())
             {
-                CAKEZ_WARN("Failed opening file %s", path);
+                folderWatch.isChangePending = true;
+                folderWatch.lastChangeMs = GetTickCount64();
             }
+            continue;
         }
-        else
+        if (result == WAIT_OBJECT_0 + handleCount)
         {
-            CAKEZ_ASSERT(0, "No File IO Buffer");
-            CAKEZ_WARN("No File IO Buffer");
+            return WAIT_RESULT_INPUT;
         }
-    }
-    else
-    {
-        CAKEZ_ASSERT(0, "No Length supplied!");
-        CAKEZ_WARN("No Length supplied!");
-    }
 
-    return buffer;
-}
\ No newline at end of file
+        // Timed out, either for the caller or for the quiet period
+        if (!folderWatch.isChangePending || (timeoutMs != WAIT_FOREVER && GetTickCount64() - startMs >= timeoutMs))
+        {
+            return WAIT_RESULT_TIMEOUT;
+        }
+    }
+}
@@ -0,0 +1,754 @@
+#include "defines.h"
+#include "logger.h"
+#include "memory.h"
+#include "platform.h"
+
+#include <windows.h>
+
+#ifdef ALLOC_GUARD
+#include <crtdbg.h>
+#include <dbghelp.h>
+#endif
+
+/*
+ * The parts of the Win32 Platform Layer that work without a window:
+ * threads, files, memory and timers. The editor and the headless
+ * benchmark both use it, win32_platform.cpp adds the window and the
+ * event loop on top.
+ */
+
+// Multithreading
+u32 constexpr MAX_WORK_QUEUE_ENTRIES = 256;
+
+struct WorkQueueEntry
+{
+    WorkQueueCallback *callback;
+    void *data;
+};
+
+struct WorkQueue
+{
+    u32 volatile completionGoal;
+    u32 volatile completionCount;
+
+    u32 volatile nextEntryToWrite;
+    u32 volatile nextEntryToRead;
+    HANDLE semaphoreHandle;
+
+    // Wakes the main thread when it is idle in platform_wait_for_events
+    HANDLE workDoneEvent;
+
+    WorkQueueEntry entries[MAX_WORK_QUEUE_ENTRIES];
+};
+
+internal bool do_next_work_queue_entry(WorkQueue *queue)
+{
+    bool shouldSleep = false;
+
+    u32 originalNextEntryToRead = queue->nextEntryToRead;
+    u32 newNextEntryToRead = (originalNextEntryToRead + 1) % MAX_WORK_QUEUE_ENTRIES;
+    if (originalNextEntryToRead != queue->nextEntryToWrite)
+    {
+        u32 idx = InterlockedCompareExchange((LONG volatile *)&queue->nextEntryToRead,
+                                             newNextEntryToRead, originalNextEntryToRead);
+
+        // Only one thread gets the entry
+        if (idx == originalNextEntryToRead)
+        {
+            WorkQueueEntry entry = queue->entries[idx];
+            entry.callback(queue, entry.data);
+            InterlockedIncrement((LONG volatile *)&queue->completionCount);
+            SetEvent(queue->workDoneEvent);
+        }
+    }
+    else
+    {
+        shouldSleep = true;
+    }
+
+    return shouldSleep;
+}
+
+internal DWORD WINAPI worker_thread_proc(LPVOID param)
+{
+    WorkQueue *queue = (WorkQueue *)param;
+
+    for (;;)
+    {
+        if (do_next_work_queue_entry(queue))
+        {
+            WaitForSingleObjectEx(queue->semaphoreHandle, INFINITE, FALSE);
+        }
+    }
+}
+
+internal void init_work_queue(WorkQueue *queue, u32 workerCount)
+{
+    queue->semaphoreHandle = CreateSemaphoreEx(0, 0, workerCount ? workerCount : 1,
+                                               0, 0, SEMAPHORE_ALL_ACCESS);
+    queue->workDoneEvent = CreateEventA(0, FALSE, FALSE, 0);
+
+    for (u32 i = 0; i < workerCount; i++)
+    {
+        HANDLE thread = CreateThread(0, 0, worker_thread_proc, queue, 0, 0);
+        CloseHandle(thread);
+    }
+}
+
+// Logger
+global_variable HANDLE logWakeEvent;
+
+internal DWORD WINAPI log_thread_proc(LPVOID param)
+{
+    for (;;)
+    {
+        if (log_thread_update())
+        {
+            WaitForSingleObjectEx(logWakeEvent, INFINITE, FALSE);
+
+            // Log calls come in bursts, let the rest of it arrive so it only wakes the thread once
+            Sleep(1);
+        }
+    }
+}
+
+u32 constexpr FILE_IO_BUFFER_SIZE = MB(1);
+global_variable char *fileIOBuffer;
+global_variable u32 workerThreadCount;
+global_variable WorkQueue workQueue;
+
+/**
+ * Starts a worker thread for every core but one and allocates the
+ * File IO Buffer, call it before anything else in here is used.
+ * @return false if the File IO Buffer doesn't fit into gameMemory
+ */
+internal bool win32_init_services(GameMemory *gameMemory)
+{
+    // Worker Threads, the main thread works on the queue as well
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    workerThreadCount = systemInfo.dwNumberOfProcessors - 1;
+    init_work_queue(&workQueue, workerThreadCount);
+
+    fileIOBuffer = (char *)allocate_memory(gameMemory, FILE_IO_BUFFER_SIZE, MEMORY_TAG_FILE_IO);
+    return fileIOBuffer != 0;
+}
+
+void platform_log(char *msg, TextColor color)
+{
+    HANDLE consoleHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+
+    u32 colorBits = 0;
+
+    switch (color)
+    {
+    case TEXT_COLOR_WHITE:
+        colorBits = FOREGROUND_BLUE | FOREGROUND_GREEN | FOREGROUND_RED;
+        break;
+
+    case TEXT_COLOR_GREEN:
+        colorBits = FOREGROUND_GREEN;
+        break;
+
+    case TEXT_COLOR_YELLOW:
+        colorBits = FOREGROUND_GREEN | FOREGROUND_RED;
+        break;
+
+    case TEXT_COLOR_RED:
+        colorBits = FOREGROUND_RED;
+        break;
+
+    case TEXT_COLOR_LIGHT_RED:
+        colorBits = FOREGROUND_RED | FOREGROUND_INTENSITY;
+        break;
+    }
+
+    SetConsoleTextAttribute(consoleHandle, (WORD)colorBits);
+
+#ifdef DEBUG
+    OutputDebugStringA(msg);
+#endif
+
+    WriteConsoleA(consoleHandle, msg, strlen(msg), 0, 0);
+}
+
+bool platform_start_log_thread()
+{
+    logWakeEvent = CreateEventA(0, FALSE, FALSE, 0);
+    if (!logWakeEvent)
+    {
+        return false;
+    }
+
+    HANDLE thread = CreateThread(0, 0, log_thread_proc, 0, 0, 0);
+    if (!thread)
+    {
+        return false;
+    }
+
+    CloseHandle(thread);
+    return true;
+}
+
+void platform_wake_log_thread()
+{
+    SetEvent(logWakeEvent);
+}
+
+char *platform_read_file(char *path, u32 *fileSize)
+{
+    char *buffer = 0;
+
+    if (fileSize)
+    {
+        if (fileIOBuffer)
+        {
+            HANDLE file = CreateFile(
+                path,
+                GENERIC_READ,
+                FILE_SHARE_READ,
+                0,
+                OPEN_EXISTING,
+                0, 0);
+
+            if (file != INVALID_HANDLE_VALUE)
+            {
+                LARGE_INTEGER fSize;
+                if (GetFileSizeEx(file, &fSize))
+                {
+                    *fileSize = (u32)fSize.QuadPart;
+
+                    if (*fileSize < FILE_IO_BUFFER_SIZE)
+                    {
+                        // Use File IO Buffer
+                        buffer = fileIOBuffer;
+
+                        DWORD bytesRead;
+                        if (ReadFile(file, buffer, *fileSize, &bytesRead, 0) &&
+                            *fileSize == bytesRead)
+                        {
+                        }
+                        else
+                        {
+                            CAKEZ_WARN("Failed reading file %s", path);
+                            buffer = 0;
+                        }
+                    }
+                    else
+                    {
+                        CAKEZ_ASSERT(0, "File size: %d, too large for File IO Buffer", *fileSize);
+                        CAKEZ_WARN("File size: %d, too large for File IO Buffer", *fileSize);
+                    }
+                }
+                else
+                {
+                    CAKEZ_WARN("Failed getting size of file %s", path);
+                }
+
+                CloseHandle(file);
+            }
+            else
+            {
+                CAKEZ_WARN("Failed opening file %s", path);
+            }
+        }
+        else
+        {
+            CAKEZ_ASSERT(0, "No File IO Buffer");
+            CAKEZ_WARN("No File IO Buffer");
+        }
+    }
+    else
+    {
+        CAKEZ_ASSERT(0, "No Length supplied!");
+        CAKEZ_WARN("No Length supplied!");
+    }
+
+    return buffer;
+}
+
+u32 platform_read_file_chunk(char *path, u64 byteOffset, char *buffer, u32 size)
+{
+    DWORD bytesRead = 0;
+
+    HANDLE file = CreateFile(
+        path,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        0,
+        OPEN_EXISTING,
+        0, 0);
+
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        LARGE_INTEGER offset;
+        offset.QuadPart = byteOffset;
+
+        if (!SetFilePointerEx(file, offset, 0, FILE_BEGIN) ||
+            !ReadFile(file, buffer, size, &bytesRead, 0))
+        {
+            CAKEZ_WARN("Failed reading %d bytes at offset %llu of file %s", size, byteOffset, path);
+            bytesRead = 0;
+        }
+
+        CloseHandle(file);
+    }
+    else
+    {
+        CAKEZ_WARN("Failed opening file %s", path);
+    }
+
+    return bytesRead;
+}
+
+unsigned long platform_write_file(char *path, char *buffer, u32 size, bool overwrite)
+{
+    DWORD bytesWritten = 0;
+
+    HANDLE file = CreateFile(
+        path,
+        overwrite ? GENERIC_WRITE : FILE_APPEND_DATA,
+        FILE_SHARE_READ,
+        0,
+        overwrite ? CREATE_ALWAYS : OPEN_ALWAYS,
+        0, 0);
+
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        if (!WriteFile(file, buffer, size, &bytesWritten, 0))
+        {
+            CAKEZ_WARN("Failed writing to file %s", path);
+        }
+
+        CloseHandle(file);
+    }
+    else
+    {
+        CAKEZ_WARN("Failed opening file %s", path);
+    }
+
+    return bytesWritten;
+}
+
+void *platform_open_file(char *path, bool overwrite)
+{
+    HANDLE file = CreateFile(
+        path,
+        overwrite ? GENERIC_WRITE : FILE_APPEND_DATA,
+        FILE_SHARE_READ,
+        0,
+        overwrite ? CREATE_ALWAYS : OPEN_ALWAYS,
+        0, 0);
+
+    return file != INVALID_HANDLE_VALUE ? file : 0;
+}
+
+u32 platform_append_file(void *file, char *buffer, u32 size)
+{
+    DWORD bytesWritten = 0;
+    if (!WriteFile((HANDLE)file, buffer, size, &bytesWritten, 0))
+    {
+        bytesWritten = 0;
+    }
+
+    return bytesWritten;
+}
+
+void *platform_open_file_for_reading(char *path)
+{
+    HANDLE file = CreateFile(
+        path,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        0,
+        OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN, 0);
+
+    return file != INVALID_HANDLE_VALUE ? file : 0;
+}
+
+u32 platform_read_from_file(void *file, char *buffer, u32 size)
+{
+    DWORD bytesRead = 0;
+    if (!ReadFile((HANDLE)file, buffer, size, &bytesRead, 0))
+    {
+        bytesRead = 0;
+    }
+
+    return bytesRead;
+}
+
+void platform_close_file(void *file)
+{
+    CloseHandle((HANDLE)file);
+}
+
+void platform_delete_file(char *path)
+{
+    if (!DeleteFileA(path))
+    {
+        CAKEZ_WARN("Failed deleting file %s", path);
+    }
+}
+
+bool platform_replace_file(char *fileToReplace, char *replaceFile, bool keepBackup)
+{
+    if (keepBackup && platform_file_exists(fileToReplace))
+    {
+        char backupPath[MAX_PATH_LENGTH];
+        snprintf(backupPath, MAX_PATH_LENGTH, "%s.bak", fileToReplace);
+        if (!CopyFileA(fileToReplace, backupPath, false))
+        {
+            CAKEZ_WARN("Failed creating backup %s", backupPath);
+            return false;
+        }
+    }
+
+    // Unlike ReplaceFile this also works if there is nothing to replace yet
+    if (!MoveFileExA(replaceFile, fileToReplace, MOVEFILE_REPLACE_EXISTING))
+    {
+        CAKEZ_WARN("Failed replacing file %s with %s", fileToReplace, replaceFile);
+        return false;
+    }
+
+    return true;
+}
+
+bool platform_file_exists(char *path)
+{
+    DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+}
+
+global_variable HANDLE findHandle = INVALID_HANDLE_VALUE;
+
+// Returns false for entries that should be skipped
+internal bool write_found_filename(WIN32_FIND_DATAA *findData, char *fileName)
+{
+    char *name = findData->cFileName;
+    if ((name[0] == '.' && name[1] == 0) ||
+        (name[0] == '.' && name[1] == '.' && name[2] == 0))
+    {
+        return false;
+    }
+
+    bool isDirectory = findData->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY;
+    s32 length = snprintf(fileName, MAX_PATH_LENGTH, isDirectory ? "%s/" : "%s", name);
+    return length > 0 && length < MAX_PATH_LENGTH;
+}
+
+bool platform_get_first_filename(char *fileName, char *folderPath)
+{
+    if (findHandle != INVALID_HANDLE_VALUE)
+    {
+        FindClose(findHandle);
+        findHandle = INVALID_HANDLE_VALUE;
+    }
+
+    char searchPath[MAX_PATH_LENGTH];
+    s32 length = snprintf(searchPath, MAX_PATH_LENGTH, "%s/*", folderPath);
+    if (length <= 0 || length >= MAX_PATH_LENGTH)
+    {
+        CAKEZ_WARN("Folder path too long: %s", folderPath);
+        return false;
+    }
+
+    WIN32_FIND_DATAA findData;
+    findHandle = FindFirstFileA(searchPath, &findData);
+    if (findHandle == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    return write_found_filename(&findData, fileName) ||
+           platform_get_next_filename(fileName, folderPath);
+}
+
+bool platform_get_next_filename(char *fileName, char *folderPath)
+{
+    if (findHandle == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    WIN32_FIND_DATAA findData;
+    while (FindNextFileA(findHandle, &findData))
+    {
+        if (write_found_filename(&findData, fileName))
+        {
+            return true;
+        }
+    }
+
+    FindClose(findHandle);
+    findHandle = INVALID_HANDLE_VALUE;
+    return false;
+}
+
+u64 platform_get_file_size(char *path)
+{
+    u64 fileSize = 0;
+
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (GetFileAttributesExA(path, GetFileExInfoStandard, &attributes))
+    {
+        fileSize = ((u64)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+    }
+    else
+    {
+        CAKEZ_WARN("Failed getting size of file %s", path);
+    }
+
+    return fileSize;
+}
+
+long long platform_last_edit_timestamp(char *path)
+{
+    long long timestamp = 0;
+
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (GetFileAttributesExA(path, GetFileExInfoStandard, &attributes))
+    {
+        timestamp = ((long long)attributes.ftLastWriteTime.dwHighDateTime << 32) |
+                    attributes.ftLastWriteTime.dwLowDateTime;
+    }
+
+    return timestamp;
+}
+
+void *platform_map_file(char *path, u64 *size)
+{
+    void *memory = 0;
+    *size = 0;
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return 0;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart)
+    {
+        HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+        if (mapping)
+        {
+            memory = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+            // The view keeps the mapping alive
+            CloseHandle(mapping);
+        }
+
+        if (memory)
+        {
+            *size = fileSize.QuadPart;
+        }
+        else
+        {
+            CAKEZ_WARN("Failed mapping file %s", path);
+        }
+    }
+
+    CloseHandle(file);
+    return memory;
+}
+
+void platform_unmap_file(void *memory)
+{
+    UnmapViewOfFile(memory);
+}
+
+bool platform_get_temp_folder(char *path, u32 maxLength)
+{
+    // Returns the length without the null terminator, or the required size
+    DWORD length = GetTempPathA(maxLength, path);
+    return length && length < maxLength;
+}
+
+u32 platform_get_process_id()
+{
+    return GetCurrentProcessId();
+}
+
+bool platform_get_full_path(char *path, char *fullPath, u32 maxLength)
+{
+    // Returns the length without the null terminator, or the required size
+    DWORD length = GetFullPathNameA(path, maxLength, fullPath, 0);
+    return length && length < maxLength;
+}
+
+void *platform_reserve_memory(u64 size)
+{
+    return VirtualAlloc(0, size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+bool platform_commit_memory(void *memory, u64 size)
+{
+    return VirtualAlloc(memory, size, MEM_COMMIT, PAGE_READWRITE) != 0;
+}
+
+void platform_decommit_memory(void *memory, u64 size)
+{
+    VirtualFree(memory, size, MEM_DECOMMIT);
+}
+
+// Large Pages need SeLockMemoryPrivilege, it has to be enabled for the process once
+internal bool enable_lock_memory_privilege()
+{
+    HANDLE token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+    {
+        return false;
+    }
+
+    TOKEN_PRIVILEGES privileges = {};
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    bool success = LookupPrivilegeValueA(0, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) &&
+                   AdjustTokenPrivileges(token, FALSE, &privileges, 0, 0, 0) &&
+                   GetLastError() == ERROR_SUCCESS;
+    CloseHandle(token);
+    return success;
+}
+
+void *platform_allocate_large_pages(u64 *size)
+{
+    u64 largePageSize = GetLargePageMinimum();
+    if (!largePageSize || !enable_lock_memory_privilege())
+    {
+        return 0;
+    }
+
+    // Large Pages can't be committed on demand, they are reserved and committed at once
+    *size = ((*size + largePageSize - 1) / largePageSize) * largePageSize;
+    return VirtualAlloc(0, *size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+}
+
+void platform_release_memory(void *memory)
+{
+    VirtualFree(memory, 0, MEM_RELEASE);
+}
+
+void platform_add_work_entry(WorkQueue *queue, WorkQueueCallback *callback, void *data)
+{
+    u32 newNextEntryToWrite = (queue->nextEntryToWrite + 1) % MAX_WORK_QUEUE_ENTRIES;
+    CAKEZ_ASSERT(newNextEntryToWrite != queue->nextEntryToRead, "Work Queue is full");
+
+    WorkQueueEntry *entry = &queue->entries[queue->nextEntryToWrite];
+    entry->callback = callback;
+    entry->data = data;
+    queue->completionGoal++;
+
+    // Make sure the entry is written before other threads can see it
+    _WriteBarrier();
+    queue->nextEntryToWrite = newNextEntryToWrite;
+    ReleaseSemaphore(queue->semaphoreHandle, 1, 0);
+}
+
+void platform_complete_all_work(WorkQueue *queue)
+{
+    while (queue->completionGoal != queue->completionCount)
+    {
+        do_next_work_queue_entry(queue);
+    }
+
+    queue->completionGoal = 0;
+    queue->completionCount = 0;
+}
+
+u32 platform_get_thread_count()
+{
+    return workerThreadCount + 1;
+}
+
+u32 platform_atomic_compare_exchange(u32 volatile *value, u32 newValue, u32 expected)
+{
+    return InterlockedCompareExchange((LONG volatile *)value, newValue, expected);
+}
+
+u32 platform_atomic_exchange(u32 volatile *value, u32 newValue)
+{
+    return InterlockedExchange((LONG volatile *)value, newValue);
+}
+
+u32 platform_atomic_add(u32 volatile *value, u32 addend)
+{
+    return InterlockedExchangeAdd((LONG volatile *)value, addend);
+}
+
+void platform_yield_thread()
+{
+    // Nothing else is ready on this core, at least tell the CPU we spin
+    if (!SwitchToThread())
+    {
+        YieldProcessor();
+    }
+}
+
+u64 platform_get_performance_tick_count()
+{
+    LARGE_INTEGER tickCount;
+    QueryPerformanceCounter(&tickCount);
+    return tickCount.QuadPart;
+}
+
+u64 platform_get_performance_tick_frequency()
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return frequency.QuadPart;
+}
+
+#ifdef ALLOC_GUARD
+// Allocation Guard
+global_variable PlatformAllocationHook *allocationHook;
+
+internal int __cdecl win32_crt_alloc_hook(int allocType, void *userData, size_t size, int blockType,
+                                          long requestNumber, const unsigned char *fileName, int lineNumber)
+{
+    // Frees are fine, _CRT_BLOCKs are what the runtime allocates for itself
+    if (allocType != _HOOK_FREE && blockType != _CRT_BLOCK)
+    {
+        allocationHook(size);
+    }
+
+    return TRUE;
+}
+
+bool platform_hook_allocations(PlatformAllocationHook *hook)
+{
+#ifdef _DEBUG
+    allocationHook = hook;
+    _CrtSetAllocHook(win32_crt_alloc_hook);
+    return true;
+#else
+    return false;
+#endif
+}
+
+u32 platform_capture_call_stack(void **addresses, u32 maxCount, u32 skipCount)
+{
+    return CaptureStackBackTrace(skipCount + 1, maxCount, addresses, 0);
+}
+
+void platform_describe_address(void *address, char *buffer, u32 length)
+{
+    HANDLE process = GetCurrentProcess();
+    local_persist bool isInitialized = SymInitialize(process, 0, TRUE);
+
+    char symbolMemory[sizeof(SYMBOL_INFO) + MAX_PATH_LENGTH];
+    SYMBOL_INFO *symbol = (SYMBOL_INFO *)symbolMemory;
+    symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+    symbol->MaxNameLen = MAX_PATH_LENGTH;
+    DWORD64 displacement = 0;
+    bool hasSymbol = isInitialized && SymFromAddr(process, (DWORD64)address, &displacement, symbol);
+
+    IMAGEHLP_LINE64 line = {};
+    line.SizeOfStruct = sizeof(IMAGEHLP_LINE64);
+    DWORD lineDisplacement = 0;
+    bool hasLine = isInitialized && SymGetLineFromAddr64(process, (DWORD64)address, &lineDisplacement, &line);
+
+    snprintf(buffer, length, "%p %s %s:%u", address, hasSymbol ? symbol->Name : "?",
+             hasLine ? line.FileName : "?", hasLine ? (u32)line.LineNumber : 0);
+}
+#endif
@@ -0,0 +1,638 @@
+#pragma once
+
+#include "defines.h"
+#include "logger.h"
+#include "memory.h"
+#include "platform.h"
+
+#include <intrin.h>
+
+/*
+ * Instrumentation Profiler. MEASURE_SCOPE records a begin and an end event
+ * with the time stamp counter into the ring of the calling thread. A ring
+ * has only one writer, so recording an event is two stores and no atomics.
+ *
+ * Once per frame profiler_end_frame reads the events of all threads on the
+ * main thread and sums them up per Zone. A Zone is a name together with
+ * the Zone it is nested in, so the same function called from two places
+ * shows up twice. Zones on worker threads start their own trees.
+ *
+ * While a trace is captured every Zone is also written as a Chrome Trace
+ * Event, which chrome://tracing and ui.perfetto.dev can open. Full buffers
+ * are written to disk by a worker thread.
+ */
+
+u32 constexpr PROFILER_EVENTS_PER_THREAD = 16384;
+u32 constexpr PROFILER_MAX_ZONES = 256;
+u32 constexpr PROFILER_ZONE_TABLE_SIZE = 2 * PROFILER_MAX_ZONES;
+u32 constexpr PROFILER_MAX_DEPTH = 32;
+u32 constexpr PROFILER_NO_ZONE = INVALID_IDX;
+u32 constexpr PROFILER_TRACE_BUFFER_SIZE = MB(1);
+u32 constexpr PROFILER_FRAME_HISTORY = 128;
+
+// Longer Zone names are cut off in the trace
+u32 constexpr PROFILER_MAX_TRACE_EVENT_LENGTH = 256;
+
+struct ProfilerEvent
+{
+    u64 ticks;
+
+    // 0 for the end of the innermost Zone
+    char *name;
+};
+
+struct ProfilerThread
+{
+    // Only written by the thread that owns the ring
+    u32 volatile writeIdx;
+
+    // Only used by profiler_end_frame, Zones can stay open over many frames
+    u32 readIdx;
+    u32 depth;
+    u32 openZones[PROFILER_MAX_DEPTH];
+    char *openNames[PROFILER_MAX_DEPTH];
+    u64 openTicks[PROFILER_MAX_DEPTH];
+    u64 childTicks[PROFILER_MAX_DEPTH];
+
+    ProfilerEvent events[PROFILER_EVENTS_PER_THREAD];
+};
+
+struct ProfilerZone
+{
+    char *name;
+    u32 parent;
+    u32 depth;
+
+    // Summed up during the frame, moved to the last frame by profiler_end_frame
+    u64 inclusiveTicks;
+    u64 exclusiveTicks;
+    u32 count;
+
+    u64 lastInclusiveTicks;
+    u64 lastExclusiveTicks;
+    u32 lastCount;
+
+    u64 totalInclusiveTicks;
+    u64 totalExclusiveTicks;
+    u64 totalCount;
+    u64 maxInclusiveTicks;
+};
+
+struct ProfilerTraceBuffer
+{
+    u32 length;
+    u32 eventCount;
+    char data[PROFILER_TRACE_BUFFER_SIZE];
+};
+
+struct ProfilerTrace
+{
+    bool isCapturing;
+    char path[MAX_PATH_LENGTH];
+    WorkQueue *workQueue;
+    u32 eventCount;
+
+    // Events go into the active buffer while the other one is written. If that
+    // write isn't done when the active buffer is full, the active buffer is dropped
+    u32 activeBuffer;
+    ProfilerTraceBuffer *buffers[2];
+    u32 volatile isWriting;
+    u32 droppedEventCount;
+};
+
+struct Profiler
+{
+    u32 threadCount;
+    u32 volatile registeredThreadCount;
+    ProfilerThread *threads;
+
+    // Open addressing, keyed by the name and the parent of the Zone
+    u32 zoneCount;
+    ProfilerZone zones[PROFILER_MAX_ZONES];
+    u16 zoneTable[PROFILER_ZONE_TABLE_SIZE];
+
+    u32 frameCount;
+    u64 lastFrameTicks;
+    u64 totalFrameTicks;
+    u64 frameStartTicks;
+
+    // Ticks of the last frames, the one of frame n is at n % PROFILER_FRAME_HISTORY
+    u64 frameHistory[PROFILER_FRAME_HISTORY];
+
+    // Events overwritten before they were read, their frames are incomplete
+    u32 droppedFrameCount;
+
+    // Time stamp counter ticks per second, measured against the performance counter
+    u64 startTicks;
+    u64 startPerformanceTicks;
+    double ticksPerSecond;
+
+    ProfilerTrace trace;
+};
+
+global_variable Profiler profiler;
+global_variable thread_local ProfilerThread *profilerThread;
+global_variable thread_local bool isProfilerThreadRegistered;
+
+internal ProfilerThread *profiler_register_thread()
+{
+    if (!profiler.threadCount)
+    {
+        return 0;
+    }
+
+    isProfilerThreadRegistered = true;
+    u32 threadIdx = platform_atomic_add(&profiler.registeredThreadCount, 1);
+    if (threadIdx < profiler.threadCount)
+    {
+        profilerThread = &profiler.threads[threadIdx];
+    }
+
+    return profilerThread;
+}
+
+/**
+ * @param threadCount Threads that can record events, the ones
+ * after that are ignored
+ * @return false if the rings don't fit into gameMemory
+ */
+bool profiler_init(GameMemory *gameMemory, u32 threadCount)
+{
+    profiler.threads = (ProfilerThread *)allocate_memory(gameMemory, threadCount * sizeof(ProfilerThread),
+                                                         MEMORY_TAG_PROFILER);
+    profiler.trace.buffers[0] = (ProfilerTraceBuffer *)allocate_memory(gameMemory, sizeof(ProfilerTraceBuffer),
+                                                                       MEMORY_TAG_PROFILER);
+    profiler.trace.buffers[1] = (ProfilerTraceBuffer *)allocate_memory(gameMemory, sizeof(ProfilerTraceBuffer),
+                                                                       MEMORY_TAG_PROFILER);
+    if (!profiler.threads || !profiler.trace.buffers[0] || !profiler.trace.buffers[1])
+    {
+        return false;
+    }
+
+    memset(profiler.zoneTable, 0xFF, sizeof(profiler.zoneTable));
+    profiler.startTicks = __rdtsc();
+    profiler.startPerformanceTicks = platform_get_performance_tick_count();
+    profiler.frameStartTicks = profiler.startTicks;
+    profiler.ticksPerSecond = 1.0;
+
+    // Threads may record as soon as this is set, the first ring is the one of the main thread
+    platform_atomic_exchange(&profiler.threadCount, threadCount);
+    profiler_register_thread();
+    return true;
+}
+
+inline void profiler_record_event(char *name)
+{
+    ProfilerThread *thread = profilerThread;
+    if (!thread)
+    {
+        if (isProfilerThreadRegistered || !(thread = profiler_register_thread()))
+        {
+            return;
+        }
+    }
+
+    u32 writeIdx = thread->writeIdx;
+    ProfilerEvent *event = &thread->events[writeIdx % PROFILER_EVENTS_PER_THREAD];
+    event->name = name;
+    event->ticks = __rdtsc();
+
+    // x64 doesn't reorder stores, the compiler must not either
+    _WriteBarrier();
+    thread->writeIdx = writeIdx + 1;
+}
+
+struct ProfilerScope
+{
+    ProfilerScope(char *name)
+    {
+        profiler_record_event(name);
+    }
+
+    ~ProfilerScope()
+    {
+        profiler_record_event(0);
+    }
+};
+
+internal u32 profiler_get_zone(char *name, u32 parent)
+{
+    u32 slot = (u32)((((u_ptr)name >> 3) * 31 + parent) % PROFILER_ZONE_TABLE_SIZE);
+    for (;;)
+    {
+        u32 zoneIdx = profiler.zoneTable[slot];
+        if (zoneIdx == 0xFFFF)
+        {
+            break;
+        }
+
+        ProfilerZone *zone = &profiler.zones[zoneIdx];
+        if (zone->name == name && zone->parent == parent)
+        {
+            return zoneIdx;
+        }
+        slot = (slot + 1) % PROFILER_ZONE_TABLE_SIZE;
+    }
+
+    if (profiler.zoneCount == PROFILER_MAX_ZONES)
+    {
+        return PROFILER_NO_ZONE;
+    }
+
+    u32 zoneIdx = profiler.zoneCount++;
+    profiler.zoneTable[slot] = (u16)zoneIdx;
+
+    ProfilerZone *zone = &profiler.zones[zoneIdx];
+    *zone = {};
+    zone->name = name;
+    zone->parent = parent;
+    zone->depth = parent == PROFILER_NO_ZONE ? 0 : profiler.zones[parent].depth + 1;
+    return zoneIdx;
+}
+
+internal void profiler_write_trace_work(WorkQueue *queue, void *data)
+{
+    ProfilerTraceBuffer *buffer = (ProfilerTraceBuffer *)data;
+    if (platform_write_file(profiler.trace.path, buffer->data, buffer->length, false) != buffer->length)
+    {
+        CAKEZ_WARN("Failed to write the Trace to %s", profiler.trace.path);
+    }
+
+    buffer->length = 0;
+    buffer->eventCount = 0;
+    platform_atomic_exchange(&profiler.trace.isWriting, false);
+}
+
+// Waits for the write of the other buffer only, not for the rest of the queue
+internal void profiler_wait_for_trace_write()
+{
+    while (profiler.trace.isWriting)
+    {
+        platform_yield_thread();
+    }
+}
+
+/**
+ * Hands the active buffer to a worker to write it.
+ * @param isLast The last buffer is never dropped, this waits for the other write instead
+ */
+internal void profiler_submit_trace_buffer(bool isLast = false)
+{
+    ProfilerTrace *trace = &profiler.trace;
+    ProfilerTraceBuffer *buffer = trace->buffers[trace->activeBuffer];
+
+    // Every event starts with a comma, so the Trace stays valid without the buffer
+    if (trace->isWriting && !isLast)
+    {
+        trace->droppedEventCount += buffer->eventCount;
+        buffer->length = 0;
+        buffer->eventCount = 0;
+        return;
+    }
+    profiler_wait_for_trace_write();
+
+    trace->isWriting = true;
+    trace->activeBuffer ^= 1;
+
+    // Without workers nobody else would write it
+    if (platform_get_thread_count() > 1)
+    {
+        platform_add_work_entry(trace->workQueue, profiler_write_trace_work, buffer);
+    }
+    else
+    {
+        profiler_write_trace_work(trace->workQueue, buffer);
+    }
+}
+
+template <typename... Args>
+void profiler_write_trace_event(char *format, Args... args)
+{
+    ProfilerTraceBuffer *buffer = profiler.trace.buffers[profiler.trace.activeBuffer];
+    if (buffer->length + PROFILER_MAX_TRACE_EVENT_LENGTH > PROFILER_TRACE_BUFFER_SIZE)
+    {
+        profiler_submit_trace_buffer();
+        buffer = profiler.trace.buffers[profiler.trace.activeBuffer];
+    }
+
+    s32 length = snprintf(buffer->data + buffer->length, PROFILER_MAX_TRACE_EVENT_LENGTH, format, args...);
+    buffer->length += length < 0 ? 0 : ((u32)length < PROFILER_MAX_TRACE_EVENT_LENGTH ? length : PROFILER_MAX_TRACE_EVENT_LENGTH - 1);
+    buffer->eventCount++;
+    profiler.trace.eventCount++;
+}
+
+// Trace Events use microseconds since the start of the Profiler
+internal double profiler_ticks_to_trace_time(u64 ticks)
+{
+    return (double)(ticks - profiler.startTicks) * 1000000.0 / profiler.ticksPerSecond;
+}
+
+internal void profiler_read_events(ProfilerThread *thread, u32 threadIdx)
+{
+    u32 writeIdx = thread->writeIdx;
+    _ReadWriteBarrier();
+
+    // The writer lapped us, the open Zones can't be matched anymore
+    if (writeIdx - thread->readIdx > PROFILER_EVENTS_PER_THREAD)
+    {
+        thread->readIdx = writeIdx - PROFILER_EVENTS_PER_THREAD;
+        thread->depth = 0;
+        profiler.droppedFrameCount++;
+    }
+
+    for (; thread->readIdx != writeIdx; thread->readIdx++)
+    {
+        ProfilerEvent *event = &thread->events[thread->readIdx % PROFILER_EVENTS_PER_THREAD];
+        if (event->name)
+        {
+            if (thread->depth == PROFILER_MAX_DEPTH)
+            {
+                thread->depth = 0;
+                profiler.droppedFrameCount++;
+                continue;
+            }
+
+            u32 parent = thread->depth ? thread->openZones[thread->depth - 1] : PROFILER_NO_ZONE;
+            thread->openZones[thread->depth] = parent == PROFILER_NO_ZONE && thread->depth
+                                                   ? PROFILER_NO_ZONE
+                                                   : profiler_get_zone(event->name, parent);
+            thread->openNames[thread->depth] = event->name;
+            thread->openTicks[thread->depth] = event->ticks;
+            thread->childTicks[thread->depth] = 0;
+            thread->depth++;
+        }
+        else if (thread->depth)
+        {
+            thread->depth--;
+            u64 elapsedTicks = event->ticks - thread->openTicks[thread->depth];
+            if (thread->depth)
+            {
+                thread->childTicks[thread->depth - 1] += elapsedTicks;
+            }
+
+            u32 zoneIdx = thread->openZones[thread->depth];
+            if (zoneIdx != PROFILER_NO_ZONE)
+            {
+                ProfilerZone *zone = &profiler.zones[zoneIdx];
+                zone->inclusiveTicks += elapsedTicks;
+                zone->exclusiveTicks += elapsedTicks - thread->childTicks[thread->depth];
+                zone->count++;
+            }
+
+            // Zone names are identifiers, they don't need to be escaped
+            if (profiler.trace.isCapturing)
+            {
+                profiler_write_trace_event(",\n{\"name\":\"%.128s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                                           thread->openNames[thread->depth],
+                                           profiler_ticks_to_trace_time(thread->openTicks[thread->depth]),
+                                           elapsedTicks * 1000000.0 / profiler.ticksPerSecond, threadIdx);
+            }
+        }
+    }
+}
+
+/**
+ * Starts the time of the next frame, call it once the main thread stops
+ * waiting for events so idle time doesn't count as frame time.
+ */
+void profiler_begin_frame()
+{
+    profiler.frameStartTicks = __rdtsc();
+}
+
+/**
+ * Sums up the events of all threads, call it once per frame on the main thread.
+ * Zones that are still open count for the frame they end in.
+ */
+void profiler_end_frame()
+{
+    if (!profiler.threadCount)
+    {
+        return;
+    }
+
+    // Gets more exact the longer the program runs
+    u64 ticks = __rdtsc();
+    u64 elapsedPerformanceTicks = platform_get_performance_tick_count() - profiler.startPerformanceTicks;
+    if (elapsedPerformanceTicks)
+    {
+        profiler.ticksPerSecond = (double)(ticks - profiler.startTicks) * platform_get_performance_tick_frequency() /
+                                  elapsedPerformanceTicks;
+    }
+
+    u32 threadCount = profiler.registeredThreadCount < profiler.threadCount
+                          ? profiler.registeredThreadCount
+                          : profiler.threadCount;
+    for (u32 threadIdx = 0; threadIdx < threadCount; threadIdx++)
+    {
+        profiler_read_events(&profiler.threads[threadIdx], threadIdx);
+    }
+
+    for (u32 zoneIdx = 0; zoneIdx < profiler.zoneCount; zoneIdx++)
+    {
+        ProfilerZone *zone = &profiler.zones[zoneIdx];
+        zone->lastInclusiveTicks = zone->inclusiveTicks;
+        zone->lastExclusiveTicks = zone->exclusiveTicks;
+        zone->lastCount = zone->count;
+        zone->totalInclusiveTicks += zone->inclusiveTicks;
+        zone->totalExclusiveTicks += zone->exclusiveTicks;
+        zone->totalCount += zone->count;
+        zone->maxInclusiveTicks = zone->inclusiveTicks > zone->maxInclusiveTicks ? zone->inclusiveTicks
+                                                                                 : zone->maxInclusiveTicks;
+        zone->inclusiveTicks = 0;
+        zone->exclusiveTicks = 0;
+        zone->count = 0;
+    }
+
+    profiler.lastFrameTicks = ticks - profiler.frameStartTicks;
+    profiler.totalFrameTicks += profiler.lastFrameTicks;
+    profiler.frameHistory[profiler.frameCount % PROFILER_FRAME_HISTORY] = profiler.lastFrameTicks;
+    profiler.frameStartTicks = ticks;
+    profiler.frameCount++;
+
+    if (profiler.trace.isCapturing)
+    {
+        profiler_write_trace_event(",\n{\"name\":\"Frame %u\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":0}",
+                                   profiler.frameCount, profiler_ticks_to_trace_time(ticks));
+    }
+}
+
+/**
+ * Starts writing every Zone that ends from now on to a Chrome Trace
+ * Event file, an existing file is overwritten.
+ * @param workQueue Full buffers are written to disk by its workers
+ * @return false if the file could not be created
+ */
+bool profiler_begin_trace(char *path, WorkQueue *workQueue)
+{
+    ProfilerTrace *trace = &profiler.trace;
+    if (!profiler.threadCount || trace->isCapturing || strlen(path) >= MAX_PATH_LENGTH)
+    {
+        return false;
+    }
+
+    profiler_wait_for_trace_write();
+
+    // The threads are named by their ring, the first one belongs to the main thread
+    char *header = "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Cakeztor\"}}";
+    if (platform_write_file(path, header, (u32)strlen(header), true) != strlen(header))
+    {
+        CAKEZ_WARN("Failed to create the Trace %s", path);
+        return false;
+    }
+
+    strcpy(trace->path, path);
+    trace->workQueue = workQueue;
+    trace->eventCount = 0;
+    trace->droppedEventCount = 0;
+    trace->isCapturing = true;
+
+    for (u32 threadIdx = 0; threadIdx < profiler.threadCount; threadIdx++)
+    {
+        char threadName[32];
+        snprintf(threadName, sizeof(threadName), threadIdx ? "Worker %u" : "Main Thread", threadIdx);
+        profiler_write_trace_event(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                                   threadIdx, threadName);
+    }
+
+    CAKEZ_TRACE("Capturing a Trace to %s", path);
+    return true;
+}
+
+/**
+ * Writes the rest of the trace and closes the file, blocks until the
+ * write is done.
+ */
+void profiler_end_trace()
+{
+    ProfilerTrace *trace = &profiler.trace;
+    if (!trace->isCapturing)
+    {
+        return;
+    }
+
+    profiler_write_trace_event("\n]\n");
+    trace->isCapturing = false;
+    profiler_submit_trace_buffer(true);
+    profiler_wait_for_trace_write();
+
+    CAKEZ_TRACE("Wrote %u Trace Events to %s", trace->eventCount - trace->droppedEventCount, trace->path);
+    if (trace->droppedEventCount)
+    {
+        CAKEZ_WARN("Dropped %u Trace Events, the disk could not keep up", trace->droppedEventCount);
+    }
+}
+
+/**
+ * @return Milliseconds of the time stamp counter ticks
+ */
+float profiler_ticks_to_ms(u64 ticks)
+{
+    return (float)(ticks * 1000.0 / profiler.ticksPerSecond);
+}
+
+/**
+ * @return Milliseconds spent in the Zones with this name during the last
+ * frame, on all threads and wherever they are nested
+ */
+float profiler_get_last_frame_ms(char *name)
+{
+    u64 ticks = 0;
+    for (u32 zoneIdx = 0; zoneIdx < profiler.zoneCount; zoneIdx++)
+    {
+        ProfilerZone *zone = &profiler.zones[zoneIdx];
+        if (!strcmp(zone->name, name))
+        {
+            ticks += zone->lastInclusiveTicks;
+        }
+    }
+
+    return profiler_ticks_to_ms(ticks);
+}
+
+/**
+ * Adds time that was measured somewhere else, like on the GPU, to a Zone
+ * of the current frame. Main thread only.
+ * @param parent Zone returned by an earlier call, or PROFILER_NO_ZONE for a
+ * tree of its own. Add the parent before its children.
+ * @return The Zone, to nest others in it
+ */
+u32 profiler_add_zone_ms(char *name, u32 parent, double milliseconds)
+{
+    if (!profiler.threadCount)
+    {
+        return PROFILER_NO_ZONE;
+    }
+
+    u32 zoneIdx = profiler_get_zone(name, parent);
+    if (zoneIdx != PROFILER_NO_ZONE)
+    {
+        u64 ticks = (u64)(milliseconds * profiler.ticksPerSecond / 1000.0);
+        ProfilerZone *zone = &profiler.zones[zoneIdx];
+        zone->inclusiveTicks += ticks;
+        zone->exclusiveTicks += ticks;
+        zone->count++;
+
+        if (parent != PROFILER_NO_ZONE)
+        {
+            ProfilerZone *parentZone = &profiler.zones[parent];
+            parentZone->exclusiveTicks -= ticks < parentZone->exclusiveTicks ? ticks : parentZone->exclusiveTicks;
+        }
+    }
+
+    return zoneIdx;
+}
+
+internal void profiler_log_zone(u32 parent)
+{
+    for (u32 zoneIdx = 0; zoneIdx < profiler.zoneCount; zoneIdx++)
+    {
+        ProfilerZone *zone = &profiler.zones[zoneIdx];
+        if (zone->parent != parent || !zone->totalCount)
+        {
+            continue;
+        }
+
+        CAKEZ_TRACE("  %*s%-*s %9.3f %9.3f %9.3f %9.2f", zone->depth * 2, "",
+                    32 - zone->depth * 2, zone->name,
+                    profiler_ticks_to_ms(zone->totalInclusiveTicks) / profiler.frameCount,
+                    profiler_ticks_to_ms(zone->totalExclusiveTicks) / profiler.frameCount,
+                    profiler_ticks_to_ms(zone->maxInclusiveTicks),
+                    (float)zone->totalCount / profiler.frameCount);
+        profiler_log_zone(zoneIdx);
+    }
+}
+
+/**
+ * Logs the tree of Zones with their average time per frame.
+ */
+void profiler_log_report()
+{
+    if (!profiler.frameCount)
+    {
+        CAKEZ_TRACE("Profiler: no frames measured");
+        return;
+    }
+
+    CAKEZ_TRACE("Profiler over %u Frames, %.3f ms per Frame, %u Frames dropped Events", profiler.frameCount,
+                profiler_ticks_to_ms(profiler.totalFrameTicks) / profiler.frameCount, profiler.droppedFrameCount);
+    CAKEZ_TRACE("  %-32s %9s %9s %9s %9s", "Zone, ms per Frame", "Total", "Self", "Max", "Calls");
+    profiler_log_zone(PROFILER_NO_ZONE);
+}
+
+#define PROFILER_CONCAT_(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_(a, b)
+
+#ifdef MEASURE_PERF
+#define MEASURE_SCOPE(name) ProfilerScope PROFILER_CONCAT(profilerScope, __LINE__)((char *)name)
+#define MEASURE_FUNCTION() MEASURE_SCOPE(__FUNCTION__)
+
+// For Zones that don't match a C++ scope, every MEASURE_BEGIN needs a MEASURE_END
+#define MEASURE_BEGIN(name) profiler_record_event((char *)name)
+#define MEASURE_END() profiler_record_event(0)
+#else
+#define MEASURE_SCOPE(name)
+#define MEASURE_FUNCTION()
+#define MEASURE_BEGIN(name)
+#define MEASURE_END()
+#endif
@@ -0,0 +1,165 @@
+#include "defines.h"
+#include "heap.h"
+#include "logger.h"
+#include "my_math.h"
+#include "platform.h"
+
+#include <string.h>
+
+/*
+ * Rasterizes the ASCII Glyphs of a Font into a grayscale Atlas and lays
+ * out text with them. Nothing in here needs the GPU, the Renderer uploads
+ * the Atlas and the headless benchmark measures it without a window.
+ */
+
+u32 constexpr FONT_PADDING = 2;
+
+struct Glyph
+{
+    Vec2 size;
+    float topV;
+    float bottomV;
+    float leftU;
+    float rightU;
+    float xOff;
+    float yOff;
+};
+
+struct GlyphCache
+{
+    u32 fontSize;
+    u32 fontBitmapWidth;
+    u32 fontBitmapHeight;
+    Glyph glyphs[255];
+};
+
+// One Glyph placed by glyph_cache_advance
+struct GlyphQuad
+{
+    Vec2 pos;
+    Vec2 size;
+    u8 glyphIdx;
+};
+
+// stb_truetype passes the userdata of the font, that is the Heap
+#define STBTT_malloc(x, u) heap_alloc((Heap *)(u), x)
+#define STBTT_free(x, u) heap_free((Heap *)(u), x)
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "stb_truetype.h"
+
+/**
+ * Rasterizes the first 127 characters of the Font into bitmap and
+ * writes their sizes and UV Coordinates to the cache.
+ * @param bitmap Square grayscale image, imgWidth * imgWidth bytes
+ * @return false if the Font could not be loaded
+ */
+bool glyph_cache_build(GlyphCache *cache, Heap *heap, char *fontPath,
+                       char *bitmap, u32 imgWidth, u32 fontSize)
+{
+    cache->fontSize = fontSize;
+    cache->fontBitmapWidth = imgWidth;
+    cache->fontBitmapHeight = imgWidth;
+
+    u32 fileSize;
+    char* buffer = platform_read_file(fontPath, &fileSize);
+
+    stbtt_fontinfo font;
+    if (!buffer || !stbtt_InitFont(&font, (unsigned char*)buffer, 0))
+    {
+        return false;
+    }
+    font.userdata = heap;
+
+    memset(bitmap, 0, imgWidth * imgWidth);
+
+    float scaleY;
+    scaleY = stbtt_ScaleForPixelHeight(&font, fontSize);
+
+    u32 glyphRowCount = 0;
+    u32 bitmapColIdx = FONT_PADDING;
+    s32 width, height, xOff, yOff;
+
+    for(unsigned char c = 0; c < 127; c++)
+    {
+        unsigned char* glyphBitmap = 0;
+
+        // This allocates on the Heap, freed once it is copied into the Atlas
+        glyphBitmap = stbtt_GetCodepointBitmap(&font, 0, scaleY, c, &width, &height, &xOff, &yOff);
+
+        Glyph* glyph = &cache->glyphs[c];
+        glyph->size = {(float)width + FONT_PADDING, (float)height + FONT_PADDING};
+        glyph->xOff = xOff;
+        glyph->yOff = yOff;
+
+
+        if(bitmapColIdx + FONT_PADDING + width >= imgWidth)
+        {
+            glyphRowCount++;
+            bitmapColIdx = 0;
+        }
+
+        u32 bitmapRowIdx = (glyphRowCount * fontSize + FONT_PADDING);
+
+        // Write the glyph to the grayscale image
+        u32 startBitmapIdx = bitmapRowIdx * imgWidth + bitmapColIdx;
+        for (u32 y = 0; y < height; y++)
+        {
+            for (u32 x = 0; x < width; x++)
+            {
+                unsigned char glyphC = glyphBitmap[y * width + x];
+
+                u32 subIdx = startBitmapIdx + y * imgWidth + x;
+                bitmap[subIdx] = glyphC;
+            }
+        }
+
+        // Calculate the UV Coordinates of the Glyph
+        {
+            int bitmapRowIdxGlyph = bitmapRowIdx - FONT_PADDING / 2;
+            int glyphHeight = height + FONT_PADDING; // 2 * FONT_PADDING / 2
+            int bitmapColIdxGlyph = bitmapColIdx - FONT_PADDING / 2;
+            int glyphWidth = width + FONT_PADDING; // 2 * FONT_PADDING / 2
+            glyph->topV = (float)bitmapRowIdxGlyph / (float)imgWidth;
+            glyph->bottomV = float(bitmapRowIdxGlyph + glyphHeight) / (float)imgWidth;
+            glyph->leftU = (float)bitmapColIdxGlyph / (float)imgWidth;
+            glyph->rightU = float(bitmapColIdxGlyph + glyphWidth) / (float)imgWidth;
+        }
+
+        bitmapColIdx += FONT_PADDING + width;
+        stbtt_FreeBitmap(glyphBitmap, heap);
+    }
+
+    return true;
+}
+
+/**
+ * Moves the pen past one character of a text, new lines go back to lineStartX.
+ * @return true if the character has a Glyph to draw, it is written to quad
+ */
+internal bool glyph_cache_advance(GlyphCache *cache, u32 codepoint, float lineStartX,
+                                  Vec2 *pen, GlyphQuad *quad)
+{
+    // The Glyph Cache only has ASCII
+    unsigned char c = codepoint < 127 ? (unsigned char)codepoint : '?';
+    Glyph g = cache->glyphs[c];
+    switch(c)
+    {
+        case ' ':
+        pen->x += cache->fontSize / 2;
+        return false;
+
+        case '\n':
+        case '\r':
+        pen->y += cache->fontSize;
+        pen->x = lineStartX;
+        return false;
+
+        default:
+            quad->pos = *pen + Vec2{g.xOff, g.yOff};
+            quad->size = g.size;
+            quad->glyphIdx = c;
+
+            pen->x += g.size.x;
+            return true;
+    }
+}
@@ -9,6 +9,8 @@
 #include "logger.h"
 #include "platform.h"
 #include "my_math.h"
+#include "heap.h"
+#include "profiler.h"
 
 // Renderer
 #include "shared_render_types.h"
@@ -16,13 +18,21 @@
 #include "vk_init.cpp"
 #include "vk_util.cpp"
 #include "vk_shader_util.cpp"
+#include "glyph_atlas.cpp"
 
 u32 constexpr MAX_IMAGES = 10;
 u32 constexpr MAX_DESCRIPTORS = 10;
 u32 constexpr MAX_RENDER_COMMANDS = 10;
 u32 constexpr MAX_TRANSFORMS = 5000;
 u32 constexpr MAX_MATERIALS = 100;
-u32 constexpr FONT_PADDING = 2;
+u32 constexpr MAX_PERF_HUD_LENGTH = KB(1);
+
+// One Timestamp before the Render Pass, one after every draw and one after the Render Pass
+u32 constexpr MAX_GPU_TIMESTAMPS = MAX_RENDER_COMMANDS + 2;
+
+// Frames that take longer fill the whole Frame Time Graph
+float constexpr PERF_HUD_GRAPH_MS = 33.3f;
+float constexpr PERF_HUD_TARGET_MS = 16.6f;
 
 static VKAPI_ATTR VkBool32 VKAPI_CALL vk_debug_callback(
     VkDebugUtilsMessageSeverityFlagBitsEXT msgSeverity,
@@ -31,29 +41,10 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL vk_debug_callback(
     void *pUserData)
 {
     // CAKEZ_ERROR(pCallbackData->pMessage);
-    CAKEZ_ASSERT(0, pCallbackData->pMessage);
+    CAKEZ_ASSERT(0, "%s", pCallbackData->pMessage);
     return false;
 }
 
-struct Glyph
-{
-    Vec2 size;
-    float topV;
-    float bottomV;
-    float leftU;
-    float rightU;
-    float xOff;
-    float yOff;
-};
-
-struct GlyphCache
-{
-    u32 fontSize;
-    u32 fontBitmapWidth;
-    u32 fontBitmapHeight;
-    Glyph glyphs[255];
-};
-
 struct VkContext
 {
     bool vSync;
@@ -82,8 +73,19 @@ struct VkContext
     u32 renderCommandCount;
     RenderCommand renderCommands[MAX_RENDER_COMMANDS];
 
+    // Lives in the Frame Memory of the App, only valid during vk_render
     u32 transformCount;
-    Transform transforms[MAX_TRANSFORMS];
+    Transform *transforms;
+
+    // Instances drawn in the last frame, for the Performance HUD
+    u32 lastTransformCount;
+
+    // GPU Timestamps of the last submit, VK_NULL_HANDLE if the queue has none
+    VkQueryPool timestampPool;
+    u32 timestampValidBits;
+    float timestampPeriod;
+    u32 timestampCount;
+    ImageID timestampImages[MAX_RENDER_COMMANDS];
 
     u32 materialCount;
     MaterialData materials[MAX_MATERIALS];
@@ -348,7 +350,7 @@ internal RenderCommand *vk_add_render_command(VkContext *vkcontext, Descriptor *
     }
     else
     {
-        CAKEZ_ERROR(0, "Reached Maximum amount of Render Commands");
+        CAKEZ_ERROR("Reached Maximum amount of Render Commands");
         CAKEZ_ASSERT(0, "Reached Maximum amount of Render Commands");
     }
 
@@ -527,78 +529,12 @@ internal void vk_resize_swapchain(
     }
 }
 
-#define STB_TRUETYPE_IMPLEMENTATION
-#include "stb_truetype.h"
-
-internal void vk_init_font(VkContext*vkcontext, char* bitmap, 
+internal void vk_init_font(VkContext*vkcontext, Heap *heap, char* bitmap, 
                         u32 imgWidth, u32 fontSize)
 {
-    vkcontext->glyphCache.fontSize = fontSize;
-    vkcontext->glyphCache.fontBitmapWidth = imgWidth;
-    vkcontext->glyphCache.fontBitmapHeight = imgWidth;
-
-    u32 fileSize;
-    char* buffer = platform_read_file("fonts/arial.ttf", &fileSize);
-
-    stbtt_fontinfo font;
-    stbtt_InitFont(&font, (unsigned char*)buffer, 0);
-
-    memset(bitmap, 0, imgWidth * imgWidth);
-
-    float scaleY;
-    scaleY = stbtt_ScaleForPixelHeight(&font, fontSize);
-
-    u32 glyphRowCount = 0;
-    u32 bitmapColIdx = FONT_PADDING;
-    s32 width, height, xOff, yOff;
-
-    for(unsigned char c = 0; c < 127; c++)
+    if (!glyph_cache_build(&vkcontext->glyphCache, heap, "fonts/arial.ttf", bitmap, imgWidth, fontSize))
     {
-        unsigned char* glyphBitmap = 0;
-
-        // This allocates on the Heap
-        glyphBitmap = stbtt_GetCodepointBitmap(&font, 0, scaleY, c, &width, &height, &xOff, &yOff);
-
-        Glyph* glyph = &vkcontext->glyphCache.glyphs[c];
-        glyph->size = {(float)width + FONT_PADDING, (float)height + FONT_PADDING};
-        glyph->xOff = xOff;
-        glyph->yOff = yOff;
-
-
-        if(bitmapColIdx + FONT_PADDING + width >= imgWidth)
-        {
-            glyphRowCount++;
-            bitmapColIdx = 0;
-        }
-
-        u32 bitmapRowIdx = (glyphRowCount * fontSize + FONT_PADDING);
-
-        // Write the glyph to the grayscale image
-        u32 startBitmapIdx = bitmapRowIdx * imgWidth + bitmapColIdx;
-        for (u32 y = 0; y < height; y++)
-        {
-            for (u32 x = 0; x < width; x++)
-            {
-                unsigned char glyphC = glyphBitmap[y * width + x];
-
-                u32 subIdx = startBitmapIdx + y * imgWidth + x;
-                bitmap[subIdx] = glyphC;
-            }
-        }
-
-        // Calculate the UV Coordinates of the Glyph
-        {
-            int bitmapRowIdxGlyph = bitmapRowIdx - FONT_PADDING / 2;
-            int glyphHeight = height + FONT_PADDING; // 2 * FONT_PADDING / 2
-            int bitmapColIdxGlyph = bitmapColIdx - FONT_PADDING / 2;
-            int glyphWidth = width + FONT_PADDING; // 2 * FONT_PADDING / 2
-            glyph->topV = (float)bitmapRowIdxGlyph / (float)imgWidth;
-            glyph->bottomV = float(bitmapRowIdxGlyph + glyphHeight) / (float)imgWidth;
-            glyph->leftU = (float)bitmapColIdxGlyph / (float)imgWidth;
-            glyph->rightU = float(bitmapColIdxGlyph + glyphWidth) / (float)imgWidth;
-        }
-
-        bitmapColIdx += FONT_PADDING + width;
+        CAKEZ_WARN("Failed to load the Font fonts/arial.ttf");
     }
 
     vk_create_image(vkcontext, IMAGE_ID_FONT, bitmap, 
@@ -699,6 +635,7 @@ bool vk_init(VkContext *vkcontext, void *window, bool vSync)
                     {
                         vkcontext->graphicsIdx = j;
                         vkcontext->gpu = gpu;
+                        vkcontext->timestampValidBits = queueProps[j].timestampValidBits;
                         break;
                     }
                 }
@@ -807,6 +744,28 @@ bool vk_init(VkContext *vkcontext, void *window, bool vSync)
         VK_CHECK(vkAllocateCommandBuffers(vkcontext->device, &allocInfo, &vkcontext->cmd));
     }
 
+    // GPU Timestamps
+    {
+        VkPhysicalDeviceProperties gpuProps;
+        vkGetPhysicalDeviceProperties(vkcontext->gpu, &gpuProps);
+        vkcontext->timestampPeriod = gpuProps.limits.timestampPeriod;
+
+        if (vkcontext->timestampValidBits)
+        {
+            VkQueryPoolCreateInfo queryPoolInfo = {};
+            queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            queryPoolInfo.queryCount = MAX_GPU_TIMESTAMPS;
+            VK_CHECK(vkCreateQueryPool(vkcontext->device, &queryPoolInfo, 0, &vkcontext->timestampPool));
+            CAKEZ_TRACE("GPU Timestamps on %s, %u valid bits, %.2f ns per tick", gpuProps.deviceName,
+                        vkcontext->timestampValidBits, vkcontext->timestampPeriod);
+        }
+        else
+        {
+            CAKEZ_WARN("The Graphics Queue has no Timestamps, GPU time is not measured");
+        }
+    }
+
     // Sync Objects
     {
         VkSemaphoreCreateInfo semaInfo = {};
@@ -1074,40 +1033,151 @@ internal void vk_draw_rect(VkContext* vkcontext, ImageID imageID,
 internal Vec2 vk_render_text(VkContext* vkcontext, unsigned char* text, Vec2 origin)
 {
     float originalOriginX = origin.x;
-    while(unsigned char c = *(text++))
+    while(*text)
     {
-        Glyph g = vkcontext->glyphCache.glyphs[c];
-        switch(c)
+        // A sequence can't run past the null terminator, continuation bytes are never 0
+        u32 size = 1;
+        while (size < 4 && text[size])
         {
-            case ' ':
-            origin.x += vkcontext->glyphCache.fontSize / 2;
-            break;
-
-            case '\n':
-            case '\r':
-            origin.y += vkcontext->glyphCache.fontSize;
-            origin.x = originalOriginX;
-            break;
+            size++;
+        }
 
-            default:
-                vk_draw_rect(vkcontext, IMAGE_ID_FONT, 
-                            origin + Vec2{g.xOff, g.yOff}, 
-                            g.size, {1.0f, 1.0f, 1.0f, 1.0f}, c);
+        u32 codepoint;
+        text += read_utf8(text, size, &codepoint);
 
-                origin.x += g.size.x;
+        GlyphQuad quad;
+        if (glyph_cache_advance(&vkcontext->glyphCache, codepoint, originalOriginX, &origin, &quad))
+        {
+            vk_draw_rect(vkcontext, IMAGE_ID_FONT, quad.pos, quad.size,
+                         {1.0f, 1.0f, 1.0f, 1.0f}, quad.glyphIdx);
         }
     }
     return origin;
 }
 
+/**
+ * Performance HUD, in the bottom left corner. Shows the Frame Time Graph
+ * and the Stages of the last frame measured by the Profiler, so it only
+ * has numbers with MEASURE_PERF.
+ */
+internal void vk_draw_perf_hud(VkContext *vkcontext, AppState *app)
+{
+    float fontSize = (float)vkcontext->glyphCache.fontSize;
+    float barWidth = 3.0f;
+    float graphHeight = fontSize * 4.0f;
+    float width = barWidth * PROFILER_FRAME_HISTORY;
+    u32 lineCount = 10;
+
+    Vec2 hudOrigin = {40.0f, vkcontext->screenSize.height - fontSize * (lineCount + 1) - graphHeight};
+    vk_draw_rect(vkcontext, IMAGE_ID_WHITE, hudOrigin + Vec2{-8.0f, -fontSize},
+                 {width + 16.0f, fontSize * (lineCount + 1) + graphHeight},
+                 {0.1f, 0.1f, 0.1f, 0.9f});
+
+    // Frame Time Graph, the oldest frame is on the left
+    float graphBottom = hudOrigin.y + graphHeight - fontSize;
+    float maxFrameMs = 0.0f;
+    u32 historyCount = profiler.frameCount < PROFILER_FRAME_HISTORY ? profiler.frameCount : PROFILER_FRAME_HISTORY;
+    for (u32 barIdx = PROFILER_FRAME_HISTORY - historyCount; barIdx < PROFILER_FRAME_HISTORY; barIdx++)
+    {
+        u32 frameIdx = profiler.frameCount + barIdx;
+        float frameMs = profiler_ticks_to_ms(profiler.frameHistory[frameIdx % PROFILER_FRAME_HISTORY]);
+        maxFrameMs = frameMs > maxFrameMs ? frameMs : maxFrameMs;
+
+        float barHeight = frameMs < PERF_HUD_GRAPH_MS ? graphHeight * frameMs / PERF_HUD_GRAPH_MS : graphHeight;
+        Vec4 color = frameMs < PERF_HUD_TARGET_MS ? Vec4{0.2f, 0.8f, 0.2f, 1.0f}
+                     : frameMs < PERF_HUD_GRAPH_MS ? Vec4{0.9f, 0.8f, 0.2f, 1.0f}
+                                                   : Vec4{0.9f, 0.2f, 0.2f, 1.0f};
+        vk_draw_rect(vkcontext, IMAGE_ID_WHITE, {hudOrigin.x + barIdx * barWidth, graphBottom - barHeight},
+                     {barWidth - 1.0f, barHeight}, color);
+    }
+
+    // Line at the target frame time
+    vk_draw_rect(vkcontext, IMAGE_ID_WHITE,
+                 {hudOrigin.x, graphBottom - graphHeight * PERF_HUD_TARGET_MS / PERF_HUD_GRAPH_MS},
+                 {width, 1.0f}, {1.0f, 1.0f, 1.0f, 0.5f});
+
+    // Stages of the last frame, the instance build of this frame is still running.
+    // The GPU time is the one of the submit before that, it was read back in the last frame
+    char *text = (char *)allocate_memory(&app->frameMemory, MAX_PERF_HUD_LENGTH);
+    snprintf(text, MAX_PERF_HUD_LENGTH,
+             "Frame     %6.2f ms, max %.2f ms\n"
+             "Input     %6.2f ms\n"
+             "Update    %6.2f ms\n"
+             "Instances %6.2f ms\n"
+             "Upload    %6.2f ms\n"
+             "Submit    %6.2f ms\n"
+             "GPU       %6.2f ms\n"
+             "Instances %u / %u\n"
+             "Memory    %.1f / %.1f MB\n"
+             "Frame Mem %.1f / %.1f KB",
+             profiler_ticks_to_ms(profiler.lastFrameTicks), maxFrameMs,
+             profiler_get_last_frame_ms("input"),
+             profiler_get_last_frame_ms("update_app"),
+             profiler_get_last_frame_ms("build_instances"),
+             profiler_get_last_frame_ms("upload"),
+             profiler_get_last_frame_ms("queue_submit"),
+             profiler_get_last_frame_ms("gpu_render_pass"),
+             vkcontext->lastTransformCount, MAX_TRANSFORMS,
+             app->gameMemory->allocatedBytes / (1024.0f * 1024.0f),
+             app->gameMemory->committedBytes / (1024.0f * 1024.0f),
+             app->frameMemory.allocatedBytes / 1024.0f,
+             app->frameMemory.memorySizeInBytes / 1024.0f);
+    vk_render_text(vkcontext, (unsigned char *)text, hudOrigin + Vec2{0.0f, graphHeight});
+}
+
+/**
+ * Adds the GPU time of the last submit to the Profiler, as a Render Pass
+ * Zone with a Zone per Image that was drawn with. The fence of the submit
+ * was waited on already, if the results are still not there they are
+ * skipped instead of waited for.
+ */
+internal void vk_read_gpu_timestamps(VkContext *vkcontext)
+{
+    u32 timestampCount = vkcontext->timestampCount;
+    if (!timestampCount)
+    {
+        return;
+    }
+    vkcontext->timestampCount = 0;
+
+    u64 timestamps[MAX_GPU_TIMESTAMPS];
+    VkResult result = vkGetQueryPoolResults(vkcontext->device, vkcontext->timestampPool, 0, timestampCount,
+                                            sizeof(timestamps), timestamps, sizeof(u64), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS)
+    {
+        return;
+    }
+
+    // Only the valid bits count, the counter can wrap around in between
+    u64 mask = vkcontext->timestampValidBits < 64 ? (1ull << vkcontext->timestampValidBits) - 1 : ~0ull;
+    double msPerTimestamp = vkcontext->timestampPeriod / 1000000.0;
+
+    u32 renderPassZone = profiler_add_zone_ms("gpu_render_pass", PROFILER_NO_ZONE,
+                                              ((timestamps[timestampCount - 1] - timestamps[0]) & mask) * msPerTimestamp);
+
+    // The first draw includes the clear of the Render Pass
+    for (u32 drawIdx = 0; drawIdx + 2 < timestampCount; drawIdx++)
+    {
+        profiler_add_zone_ms(imageIDNames[vkcontext->timestampImages[drawIdx]], renderPassZone,
+                             ((timestamps[drawIdx + 1] - timestamps[drawIdx]) & mask) * msPerTimestamp);
+    }
+}
 
 bool vk_render(VkContext *vkcontext, InputState* input, AppState* app)
 {
+    MEASURE_FUNCTION();
     u32 imgIdx;
 
     // We wait on the GPU to be done with the work
-    VK_CHECK(vkWaitForFences(vkcontext->device, 1, &vkcontext->imgAvailableFence, 
-                                VK_TRUE, UINT64_MAX));
+    {
+        MEASURE_SCOPE("wait_for_gpu");
+        VK_CHECK(vkWaitForFences(vkcontext->device, 1, &vkcontext->imgAvailableFence,
+                                 VK_TRUE, UINT64_MAX));
+    }
+    vk_read_gpu_timestamps(vkcontext);
+
+    MEASURE_BEGIN("build_instances");
+    vkcontext->transforms = (Transform *)allocate_memory(&app->frameMemory, sizeof(Transform) * MAX_TRANSFORMS);
 
     float fontSize = (float)vkcontext->glyphCache.fontSize;
     Vec2 origin = vk_render_text(vkcontext, app->buffer, {40.0f, 40.0f});
@@ -1115,6 +1185,48 @@ bool vk_render(VkContext *vkcontext, InputState* input, AppState* app)
         {fontSize / 2.0f, fontSize},
         {1.0f, 1.0f, 1.0f, 0.5f});
 
+    // Completion Popup, below the Cursor
+    for (u32 completionIdx = 0; completionIdx < app->completionCount; completionIdx++)
+    {
+        vk_render_text(vkcontext, (unsigned char *)app->completions[completionIdx].word,
+                       origin + Vec2{0.0f, fontSize * (completionIdx + 1)});
+    }
+
+    // File Palette, on top of the Text
+    if (app->filePaletteOpen)
+    {
+        FileFinder *finder = &app->fileFinder;
+        Vec2 paletteOrigin = {40.0f, 40.0f};
+        vk_draw_rect(vkcontext, IMAGE_ID_WHITE, paletteOrigin + Vec2{-8.0f, -fontSize},
+                     {fontSize * 32.0f, fontSize * (MAX_FINDER_RESULTS + 2)},
+                     {0.1f, 0.1f, 0.1f, 0.9f});
+        vk_render_text(vkcontext, (unsigned char *)app->filePaletteQuery, paletteOrigin);
+
+        for (u32 resultIdx = 0; resultIdx < finder->resultCount; resultIdx++)
+        {
+            vk_render_text(vkcontext, (unsigned char *)file_finder_get_path(finder, finder->results[resultIdx].pathIdx),
+                           paletteOrigin + Vec2{0.0f, fontSize * (resultIdx + 1)});
+        }
+    }
+
+    // Memory Overlay, in the top right corner
+    if (app->memoryOverlayOpen)
+    {
+        char *report = (char *)allocate_memory(&app->frameMemory, MAX_MEMORY_REPORT_LENGTH);
+        memory_format_report(app->gameMemory, report, MAX_MEMORY_REPORT_LENGTH);
+
+        Vec2 overlayOrigin = {vkcontext->screenSize.width - fontSize * 30.0f, 40.0f};
+        vk_draw_rect(vkcontext, IMAGE_ID_WHITE, overlayOrigin + Vec2{-8.0f, -fontSize},
+                     {fontSize * 30.0f, fontSize * (MEMORY_TAG_COUNT + 2)},
+                     {0.1f, 0.1f, 0.1f, 0.9f});
+        vk_render_text(vkcontext, (unsigned char *)report, overlayOrigin);
+    }
+
+    if (app->perfHudOpen)
+    {
+        vk_draw_perf_hud(vkcontext, app);
+    }
+
     Descriptor *currentDesc = 0;
     RenderCommand *rc = 0;
     for(uint32_t transformIdx = 0; transformIdx < vkcontext->transformCount; transformIdx++)
@@ -1198,9 +1310,13 @@ bool vk_render(VkContext *vkcontext, InputState* input, AppState* app)
     //     }
     // }
 
+    MEASURE_END();
+
     // Copy Data to buffers
     {
-        vk_copy_to_buffer(&vkcontext->transformStorageBuffer, &vkcontext->transforms, sizeof(Transform) * vkcontext->transformCount);
+        MEASURE_SCOPE("upload");
+        vkcontext->lastTransformCount = vkcontext->transformCount;
+        vk_copy_to_buffer(&vkcontext->transformStorageBuffer, vkcontext->transforms, sizeof(Transform) * vkcontext->transformCount);
         vkcontext->transformCount = 0;
 
         vk_copy_to_buffer(&vkcontext->materialStorageBuffer, vkcontext->materials, 
@@ -1208,8 +1324,14 @@ bool vk_render(VkContext *vkcontext, InputState* input, AppState* app)
         vkcontext->materialCount = 0;
     }
 
+    latency_mark_stage(&app->latency, LATENCY_STAGE_INSTANCES);
+
     // This waits on the timeout until the image is ready, if timeout reached -> VK_TIMEOUT
-    VkResult result = vkAcquireNextImageKHR(vkcontext->device, vkcontext->swapchain, UINT64_MAX, vkcontext->aquireSemaphore, 0, &imgIdx);
+    VkResult result;
+    {
+        MEASURE_SCOPE("acquire_image");
+        result = vkAcquireNextImageKHR(vkcontext->device, vkcontext->swapchain, UINT64_MAX, vkcontext->aquireSemaphore, 0, &imgIdx);
+    }
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) // i.e. we changed the window size
     {
         CAKEZ_WARN("Acquire next Image resulted in VK_ERROR_OUT_OF_DATE_KHR, recreating the Swapchain!");
@@ -1229,6 +1351,13 @@ bool vk_render(VkContext *vkcontext, InputState* input, AppState* app)
     VkCommandBufferBeginInfo beginInfo = cmd_begin_info();
     VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
 
+    VkQueryPool timestampPool = vkcontext->timestampPool;
+    if (timestampPool)
+    {
+        vkCmdResetQueryPool(cmd, timestampPool, 0, MAX_GPU_TIMESTAMPS);
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, 0);
+    }
+
     // Clear Color to Yellow
     VkClearValue clearValue = {};
     clearValue.color = {0, 0, 0, 1};
@@ -1257,6 +1386,7 @@ bool vk_render(VkContext *vkcontext, InputState* input, AppState* app)
     vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, vkcontext->pipeline);
 
     // Render Loop
+    u32 drawCount = 0;
     {
         for (u32 i = 0; i < vkcontext->renderCommandCount; i++)
         {
@@ -1268,14 +1398,26 @@ bool vk_render(VkContext *vkcontext, InputState* input, AppState* app)
             vkCmdPushConstants(cmd, vkcontext->pipeLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushData), &rc->pushData);
 
             vkCmdDrawIndexed(cmd, 6, rc->instanceCount, 0, 0, 0);
+
+            if (timestampPool)
+            {
+                vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, i + 1);
+                vkcontext->timestampImages[i] = rc->desc->imageID;
+            }
         }
 
         // Reset the Render Commands for next Frame
+        drawCount = vkcontext->renderCommandCount;
         vkcontext->renderCommandCount = 0;
     }
 
     vkCmdEndRenderPass(cmd);
 
+    if (timestampPool)
+    {
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, drawCount + 1);
+    }
+
     VK_CHECK(vkEndCommandBuffer(cmd));
 
     VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
@@ -1287,7 +1429,12 @@ bool vk_render(VkContext *vkcontext, InputState* input, AppState* app)
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pWaitSemaphores = &vkcontext->aquireSemaphore;
     submitInfo.waitSemaphoreCount = 1;
-    VK_CHECK(vkQueueSubmit(vkcontext->graphicsQueue, 1, &submitInfo, vkcontext->imgAvailableFence));
+    {
+        MEASURE_SCOPE("queue_submit");
+        VK_CHECK(vkQueueSubmit(vkcontext->graphicsQueue, 1, &submitInfo, vkcontext->imgAvailableFence));
+    }
+    vkcontext->timestampCount = timestampPool ? drawCount + 2 : 0;
+    latency_mark_stage(&app->latency, LATENCY_STAGE_SUBMIT);
 
     VkPresentInfoKHR presentInfo = {};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1296,7 +1443,11 @@ bool vk_render(VkContext *vkcontext, InputState* input, AppState* app)
     presentInfo.pImageIndices = &imgIdx;
     presentInfo.pWaitSemaphores = &vkcontext->submitSemaphore;
     presentInfo.waitSemaphoreCount = 1;
-    vkQueuePresentKHR(vkcontext->graphicsQueue, &presentInfo);
+    {
+        MEASURE_SCOPE("present");
+        vkQueuePresentKHR(vkcontext->graphicsQueue, &presentInfo);
+    }
+    latency_end_frame(&app->latency);
 
     return true;
 }
\ No newline at end of file
@@ -11,12 +11,19 @@
         __debugbreak();                          \
     }
 
+#define IMAGE_ID_LIST(IMAGE_ID) \
+    IMAGE_ID(IMAGE_ID_WHITE)     \
+    IMAGE_ID(IMAGE_ID_FONT)
+
 enum ImageID : u8
 {
-    IMAGE_ID_WHITE,
-    IMAGE_ID_FONT,
+    IMAGE_ID_LIST(GENERATE_ENUM)
+    IMAGE_ID_COUNT
 };
 
+// Also the names of the GPU Zones in the Profiler, one per Image that is drawn with
+global_variable char *imageIDNames[] = {IMAGE_ID_LIST(GENERATE_STRING)};
+
 struct Image
 {
     ImageID ID;
@@ -0,0 +1,372 @@
+// Defines
+#include "defines.h"
+#include "log_format.h"
+
+// Standard Library, this is a plain console program without the platform layer
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Turns a Binary Log File back into the text the console would have shown.
+ * Usage: log_decoder <log file> [text file]
+ * Without a text file the log is written to stdout.
+ */
+
+u32 constexpr MAX_LOG_ARGS = 32;
+
+struct LogFormat
+{
+    u8 level;
+    char *argTypes;
+    char *format;
+};
+
+struct LogValue
+{
+    char type;
+    u32 size;
+    u64 bits;
+    char *string;
+};
+
+internal u8 *read_log_value(u8 *at, u8 *end, char type, LogValue *value)
+{
+    *value = {};
+    value->type = type;
+
+    if (type == LOG_ARG_STRING)
+    {
+        u8 *terminator = (u8 *)memchr(at, 0, end - at);
+        if (!terminator)
+        {
+            return 0;
+        }
+
+        value->string = (char *)at;
+        return terminator + 1;
+    }
+
+    switch (type)
+    {
+    case LOG_ARG_INT8:
+        value->size = 1;
+        break;
+    case LOG_ARG_INT16:
+        value->size = 2;
+        break;
+    case LOG_ARG_INT32:
+    case LOG_ARG_FLOAT:
+        value->size = 4;
+        break;
+    case LOG_ARG_INT64:
+    case LOG_ARG_DOUBLE:
+        value->size = 8;
+        break;
+    default:
+        return 0;
+    }
+
+    if ((u64)(end - at) < value->size)
+    {
+        return 0;
+    }
+
+    // Little endian, the low bytes come first
+    memcpy(&value->bits, at, value->size);
+    return at + value->size;
+}
+
+internal s64 get_signed_value(LogValue *value)
+{
+    switch (value->size)
+    {
+    case 1:
+        return (s8)value->bits;
+    case 2:
+        return (s16)value->bits;
+    case 4:
+        return (s32)value->bits;
+    default:
+        return (s64)value->bits;
+    }
+}
+
+internal double get_real_value(LogValue *value)
+{
+    if (value->type == LOG_ARG_FLOAT)
+    {
+        float real;
+        memcpy(&real, &value->bits, sizeof(float));
+        return real;
+    }
+
+    if (value->type == LOG_ARG_DOUBLE)
+    {
+        double real;
+        memcpy(&real, &value->bits, sizeof(double));
+        return real;
+    }
+
+    return (double)get_signed_value(value);
+}
+
+// Widths and precisions given as * are passed in front of the value
+template <typename T>
+internal void print_value(FILE *out, char *spec, s32 *stars, u32 starCount, T value)
+{
+    switch (starCount)
+    {
+    case 0:
+        fprintf(out, spec, value);
+        break;
+    case 1:
+        fprintf(out, spec, stars[0], value);
+        break;
+    default:
+        fprintf(out, spec, stars[0], stars[1], value);
+        break;
+    }
+}
+
+/**
+ * Prints the format string, every conversion gets the next value converted
+ * to the type it expects. The length modifiers of the format are replaced,
+ * the values have their own size.
+ */
+internal void print_message(FILE *out, LogFormat *format, LogValue *values, u32 valueCount)
+{
+    u32 level = format->level < ArraySize(logLevelNames) ? format->level : LOG_LEVEL_FATAL;
+    fprintf(out, "%s: ", logLevelNames[level]);
+
+    u32 nextValue = 0;
+    char *c = format->format;
+    while (*c)
+    {
+        if (*c != '%')
+        {
+            fputc(*c++, out);
+            continue;
+        }
+
+        if (c[1] == '%')
+        {
+            fputc('%', out);
+            c += 2;
+            continue;
+        }
+
+        // Room for the flags, width and precision, a length modifier and the conversion
+        char spec[64] = "%";
+        u32 specLength = 1;
+        s32 stars[2];
+        u32 starCount = 0;
+        c++;
+
+        while (*c && strchr("-+ #0123456789.*", *c) && specLength < sizeof(spec) - 4)
+        {
+            if (*c == '*' && starCount < ArraySize(stars))
+            {
+                stars[starCount++] = nextValue < valueCount ? (s32)get_signed_value(&values[nextValue++]) : 0;
+            }
+            spec[specLength++] = *c++;
+        }
+
+        // h, l, ll, z, I64 and friends
+        while (*c && strchr("hljztLqI", *c))
+        {
+            c += *c == 'I' && c[1] >= '0' && c[1] <= '9' ? 3 : 1;
+        }
+
+        char conversion = *c;
+        if (!conversion)
+        {
+            break;
+        }
+        c++;
+
+        LogValue missing = {LOG_ARG_INT32, 4};
+        LogValue *value = nextValue < valueCount ? &values[nextValue++] : &missing;
+
+        switch (conversion)
+        {
+        case 'd':
+        case 'i':
+            memcpy(spec + specLength, "ll", 2);
+            spec[specLength + 2] = conversion;
+            print_value(out, spec, stars, starCount, (long long)get_signed_value(value));
+            break;
+
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            memcpy(spec + specLength, "ll", 2);
+            spec[specLength + 2] = conversion;
+            print_value(out, spec, stars, starCount, (unsigned long long)value->bits);
+            break;
+
+        case 'c':
+            spec[specLength] = conversion;
+            print_value(out, spec, stars, starCount, (s32)value->bits);
+            break;
+
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            spec[specLength] = conversion;
+            print_value(out, spec, stars, starCount, get_real_value(value));
+            break;
+
+        case 's':
+            spec[specLength] = conversion;
+            print_value(out, spec, stars, starCount, value->string ? value->string : "(null)");
+            break;
+
+        case 'p':
+            spec[specLength] = conversion;
+            print_value(out, spec, stars, starCount, (void *)value->bits);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    fputc('\n', out);
+}
+
+s32 main(s32 argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: log_decoder <log file> [text file]\n");
+        return -1;
+    }
+
+    FILE *file = fopen(argv[1], "rb");
+    if (!file)
+    {
+        fprintf(stderr, "Failed to open %s\n", argv[1]);
+        return -1;
+    }
+
+    fseek(file, 0, SEEK_END);
+    u64 fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    u8 *data = (u8 *)malloc(fileSize ? fileSize : 1);
+    u64 bytesRead = fread(data, 1, fileSize, file);
+    fclose(file);
+
+    u32 header[2] = {};
+    if (bytesRead != fileSize || fileSize < sizeof(header))
+    {
+        fprintf(stderr, "Failed to read %s\n", argv[1]);
+        return -1;
+    }
+
+    memcpy(header, data, sizeof(header));
+    if (header[0] != LOG_FILE_MAGIC || header[1] != LOG_FILE_VERSION)
+    {
+        fprintf(stderr, "%s is not a Log File of version %u\n", argv[1], LOG_FILE_VERSION);
+        return -1;
+    }
+
+    FILE *out = argc > 2 ? fopen(argv[2], "wb") : stdout;
+    if (!out)
+    {
+        fprintf(stderr, "Failed to create %s\n", argv[2]);
+        return -1;
+    }
+
+    LogFormat *formats = (LogFormat *)calloc(LOG_MAX_FORMATS, sizeof(LogFormat));
+    u32 messageCount = 0;
+
+    u8 *at = data + sizeof(header);
+    u8 *end = data + fileSize;
+    while (at < end)
+    {
+        u64 offset = at - data;
+        u16 formatId = 0;
+        if (end - at < 5)
+        {
+            fprintf(stderr, "Log File is truncated at %llu\n", offset);
+            break;
+        }
+        memcpy(&formatId, at + 1, sizeof(u16));
+
+        if (formatId >= LOG_MAX_FORMATS)
+        {
+            fprintf(stderr, "Invalid Format %u at %llu\n", formatId, offset);
+            break;
+        }
+
+        if (at[0] == LOG_RECORD_FORMAT)
+        {
+            LogFormat *format = &formats[formatId];
+            format->level = at[3];
+            format->argTypes = (char *)at + 4;
+
+            u8 *argTypesEnd = (u8 *)memchr(at + 4, 0, end - (at + 4));
+            u8 *formatEnd = argTypesEnd ? (u8 *)memchr(argTypesEnd + 1, 0, end - (argTypesEnd + 1)) : 0;
+            if (!formatEnd)
+            {
+                fprintf(stderr, "Log File is truncated at %llu\n", offset);
+                break;
+            }
+
+            format->format = (char *)argTypesEnd + 1;
+            at = formatEnd + 1;
+        }
+        else if (at[0] == LOG_RECORD_MESSAGE)
+        {
+            u16 argsSize;
+            memcpy(&argsSize, at + 3, sizeof(u16));
+            u8 *args = at + 5;
+            if ((u64)(end - args) < argsSize)
+            {
+                fprintf(stderr, "Log File is truncated at %llu\n", offset);
+                break;
+            }
+            at = args + argsSize;
+
+            LogFormat *format = &formats[formatId];
+            if (!format->format)
+            {
+                fprintf(stderr, "Message at %llu uses the unknown Format %u\n", offset, formatId);
+                continue;
+            }
+
+            LogValue values[MAX_LOG_ARGS];
+            u32 valueCount = 0;
+            u8 *argsEnd = args + argsSize;
+            for (char *type = format->argTypes; *type && valueCount < MAX_LOG_ARGS && args; type++)
+            {
+                args = read_log_value(args, argsEnd, *type, &values[valueCount]);
+                valueCount += args ? 1 : 0;
+            }
+
+            print_message(out, format, values, valueCount);
+            messageCount++;
+        }
+        else
+        {
+            fprintf(stderr, "Invalid Record %u at %llu\n", at[0], offset);
+            break;
+        }
+    }
+
+    if (out != stdout)
+    {
+        fclose(out);
+        printf("Decoded %u Messages from %s to %s\n", messageCount, argv[1], argv[2]);
+    }
+
+    return 0;
+}